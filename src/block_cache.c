@@ -0,0 +1,270 @@
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "block_cache.h"
+#include "cpu_instructions.h"
+#include "memory.h"
+
+
+// Once this many blocks have been decoded the whole cache starts over
+#define MAX_BLOCKS  16384
+
+#define ROM_REGION_END  (MEMORY_ROM_BANKN_END + 1)
+
+// DIV, TIMA, TMA and TAC
+#define TIMER_REGISTERS_START  0xff04
+#define TIMER_REGISTERS_END    0xff07
+
+// Register operand 6 in an opcode means (HL)
+#define OPERAND_MEM_HL  6
+
+
+struct BlockCache
+{
+    struct DecodedBlock *blockPool;
+    size_t numBlocksUsed;
+
+    // Blocks indexed by ROM offset, allocated one bank at a time
+    struct DecodedBlock **blocks[MEMORY_MAX_ROM_BANKS];
+};
+
+
+struct BlockCache* block_cache_create(void)
+{
+    struct BlockCache *cache = calloc(1, sizeof(struct BlockCache));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    cache->blockPool = malloc(MAX_BLOCKS * sizeof(struct DecodedBlock));
+    if (cache->blockPool == NULL)
+    {
+        free(cache);
+        return NULL;
+    }
+    cache->numBlocksUsed = 0;
+    return cache;
+}
+
+
+void block_cache_destroy(struct BlockCache *cache)
+{
+    if (cache != NULL)
+    {
+        block_cache_flush(cache);
+        free(cache->blockPool);
+        free(cache);
+    }
+}
+
+
+void block_cache_flush(struct BlockCache *cache)
+{
+    for (size_t i = 0; i < MEMORY_MAX_ROM_BANKS; i++)
+    {
+        free(cache->blocks[i]);
+        cache->blocks[i] = NULL;
+    }
+    cache->numBlocksUsed = 0;
+}
+
+
+// True for instructions that only read registers, constants, or memory at a
+// fixed address, and only write registers. Reads through a register pointer
+// aren't accepted, since the pointer might be aimed at the timer.
+static bool is_pure_instruction(const struct DecodedInstruction *decoded)
+{
+    if (decoded->opcode & BLOCK_CACHE_CB_OPCODE)
+    {
+        // BIT n, r
+        uint8_t cbOpcode = decoded->opcode & 0xff;
+        return cbOpcode >= 0x40 && cbOpcode <= 0x7f && (cbOpcode & 0x07) != OPERAND_MEM_HL;
+    }
+
+    uint8_t opcode = (uint8_t)decoded->opcode;
+    int dst = (opcode >> 3) & 0x07;
+    int src = opcode & 0x07;
+    if (opcode >= 0x40 && opcode <= 0xbf)
+    {
+        // LD r, r and ALU A, r (this also rules out HALT)
+        return dst != OPERAND_MEM_HL && src != OPERAND_MEM_HL;
+    }
+    if (opcode < 0x40 && (src == 0x04 || src == 0x05 || src == 0x06))
+    {
+        // INC r, DEC r, LD r, d8
+        return dst != OPERAND_MEM_HL;
+    }
+
+    uint16_t address;
+    switch (opcode)
+    {
+    case 0x00:  // NOP
+    case 0x2f:  // CPL
+    case 0x37:  // SCF
+    case 0x3f:  // CCF
+    case 0xc6: case 0xce: case 0xd6: case 0xde: case 0xe6: case 0xee: case 0xf6: case 0xfe:  // ALU A, d8
+        return true;
+    case 0xf0:  // LDH A, (a8)
+        address = 0xff00 | decoded->immediate;
+        break;
+    case 0xfa:  // LD A, (a16)
+        address = decoded->immediate;
+        break;
+    default:
+        return false;
+    }
+
+    // DIV and TIMA change with time rather than through scheduled events
+    return address < TIMER_REGISTERS_START || address > TIMER_REGISTERS_END;
+}
+
+
+static bool is_idle_loop(const struct DecodedBlock *block, uint16_t startAddress)
+{
+    const struct DecodedInstruction *jump = &block->instructions[block->numInstructions - 1];
+    uint16_t target;
+    switch (jump->opcode)
+    {
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:  // JR
+        target = jump->nextPc + (int8_t)jump->immediate;
+        break;
+    case 0xc2: case 0xc3: case 0xca: case 0xd2: case 0xda:  // JP
+        target = jump->immediate;
+        break;
+    default:
+        return false;
+    }
+    if (target != startAddress)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < block->numInstructions - 1; i++)
+    {
+        if ( ! is_pure_instruction(&block->instructions[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static void decode_block(struct DecodedBlock *block, struct Memory *memory, uint16_t startAddress)
+{
+    uint16_t regionEnd = (startAddress >= MEMORY_ROM_BANKN_START) ? ROM_REGION_END : MEMORY_ROM_BANKN_START;
+
+    block->numInstructions = 0;
+    uint16_t address = startAddress;
+    while (block->numInstructions < BLOCK_CACHE_MAX_BLOCK_INSTRUCTIONS)
+    {
+        uint8_t opcode = memory_read_word(memory, address);
+        const struct Instruction *instruction;
+        struct DecodedInstruction decoded;
+        decoded.immediate = 0;
+        if (opcode == 0xcb)
+        {
+            uint8_t cbOpcode = memory_read_word(memory, address + 1);
+            instruction = &cbInstructions[cbOpcode];
+            decoded.opcode = BLOCK_CACHE_CB_OPCODE | cbOpcode;
+            decoded.nextPc = address + 2;
+        }
+        else
+        {
+            instruction = &instructions[opcode];
+            decoded.opcode = opcode;
+            decoded.nextPc = address + 1 + instruction->numImmediateBytes;
+            if (instruction->numImmediateBytes == 1)
+            {
+                decoded.immediate = memory_read_word(memory, address + 1);
+            }
+            else if (instruction->numImmediateBytes == 2)
+            {
+                decoded.immediate = memory_read_dword(memory, address + 1);
+            }
+        }
+
+        // Leave unimplemented instructions for the interpreter to report,
+        // and don't decode past the end of the region (the next region
+        // isn't necessarily ROM).
+        if (instruction->impl == NULL || decoded.nextPc > regionEnd)
+        {
+            break;
+        }
+
+        block->instructions[block->numInstructions++] = decoded;
+        address = decoded.nextPc;
+        if (opcode != 0xcb && cpu_instruction_ends_block(opcode))
+        {
+            break;
+        }
+        if (address == regionEnd)
+        {
+            break;
+        }
+    }
+
+    block->isIdleLoop = (block->numInstructions > 0) && is_idle_loop(block, startAddress);
+}
+
+
+const struct DecodedBlock* block_cache_lookup(struct BlockCache *cache, struct Memory *memory, uint16_t address)
+{
+    if (address >= ROM_REGION_END)
+    {
+        return NULL;
+    }
+
+    // Bank numbers wrap around the ROM size, so bank 0 can also appear in
+    // the switchable region. Blocks hold the addresses they were decoded
+    // at, so code there can't share them with the same code at the start
+    // of the ROM. Real games don't run from there; leave it to the
+    // interpreter.
+    if (address >= MEMORY_ROM_BANKN_START && memory->selectedRomBank == 0)
+    {
+        return NULL;
+    }
+
+    size_t romOffset = address;
+    if (address >= MEMORY_ROM_BANKN_START)
+    {
+        romOffset += (memory->selectedRomBank - 1) * MEMORY_ROM_BANK_SIZE;
+    }
+    size_t bank = romOffset / MEMORY_ROM_BANK_SIZE;
+    size_t offsetInBank = romOffset % MEMORY_ROM_BANK_SIZE;
+    if (bank >= MEMORY_MAX_ROM_BANKS)
+    {
+        return NULL;
+    }
+
+    if (cache->blocks[bank] == NULL)
+    {
+        cache->blocks[bank] = calloc(MEMORY_ROM_BANK_SIZE, sizeof(struct DecodedBlock*));
+        if (cache->blocks[bank] == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    struct DecodedBlock *block = cache->blocks[bank][offsetInBank];
+    if (block == NULL)
+    {
+        if (cache->numBlocksUsed == MAX_BLOCKS)
+        {
+            block_cache_flush(cache);
+            return block_cache_lookup(cache, memory, address);
+        }
+
+        block = &cache->blockPool[cache->numBlocksUsed];
+        decode_block(block, memory, address);
+        if (block->numInstructions == 0)
+        {
+            return NULL;
+        }
+        cache->numBlocksUsed += 1;
+        cache->blocks[bank][offsetInBank] = block;
+    }
+    return block;
+}
@@ -0,0 +1,59 @@
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+struct Memory;
+
+
+// Basic blocks of ROM code are decoded once and kept here, so the
+// interpreter doesn't have to fetch and decode opcodes and immediates every
+// time it runs the same loop.
+//
+// Blocks are keyed by their offset in the ROM image, which takes the
+// selected bank into account, so they stay valid across bank switches.
+// Only the block being executed becomes stale when an MBC write switches
+// banks; the interpreter checks for that between instructions.
+
+#define BLOCK_CACHE_MAX_BLOCK_INSTRUCTIONS  32
+
+// Opcodes after a 0xcb prefix are stored with this bit set
+#define BLOCK_CACHE_CB_OPCODE  0x100
+
+struct DecodedInstruction
+{
+    uint16_t opcode;
+    uint16_t immediate;
+    uint16_t nextPc;
+};
+
+// Ends after a jump, call, return, HALT or STOP, at the end of a memory
+// region, or before an instruction that isn't implemented.
+struct DecodedBlock
+{
+    // The block jumps back to its own start, and repeating it has no effect
+    // other than on CPU registers. Unless an event changes the memory it
+    // polls, it will spin the same way until the next event is due.
+    bool isIdleLoop;
+
+    size_t numInstructions;
+    struct DecodedInstruction instructions[BLOCK_CACHE_MAX_BLOCK_INSTRUCTIONS];
+};
+
+
+struct BlockCache;
+
+struct BlockCache* block_cache_create(void);
+void block_cache_destroy(struct BlockCache *cache);
+void block_cache_flush(struct BlockCache *cache);
+
+// Returns the block starting at address in the currently mapped ROM bank,
+// decoding it if necessary, or NULL if the address isn't in ROM or the
+// first instruction can't be decoded.
+const struct DecodedBlock* block_cache_lookup(struct BlockCache *cache, struct Memory *memory, uint16_t address);
+
+
+#endif
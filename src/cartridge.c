@@ -1,4 +1,7 @@
 
+// Needed for mmap, open and fstat
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -6,7 +9,69 @@
 #include "cartridge.h"
 
 
-bool cartridge_load(struct Cartridge *cartridge, const char *romPath)
+// Elsewhere ROM files are always read into memory
+#if defined(__unix__) || defined(__APPLE__)
+#define CARTRIDGE_MMAP_SUPPORTED  1
+#else
+#define CARTRIDGE_MMAP_SUPPORTED  0
+#endif
+
+#if CARTRIDGE_MMAP_SUPPORTED
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+static void cartridge_clear(struct Cartridge *cartridge)
+{
+    cartridge->data = NULL;
+    cartridge->dataSize = 0;
+    cartridge->ownedData = NULL;
+    cartridge->mappedData = NULL;
+}
+
+
+// Fails for anything that can't be mapped (e.g. a pipe or an empty file),
+// which is left for read_rom_file to deal with.
+static bool map_rom_file(struct Cartridge *cartridge, const char *romPath)
+{
+#if CARTRIDGE_MMAP_SUPPORTED
+    int fd = open(romPath, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || ! S_ISREG(fileStat.st_mode) || fileStat.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t dataSize = (size_t)fileStat.st_size;
+    void *mapping = mmap(NULL, dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    cartridge->mappedData = mapping;
+    cartridge->data = mapping;
+    cartridge->dataSize = dataSize;
+    return true;
+#else
+    (void)cartridge;
+    (void)romPath;
+    return false;
+#endif
+}
+
+
+static bool read_rom_file(struct Cartridge *cartridge, const char *romPath)
 {
     FILE *file = fopen(romPath, "rb");
     if (file == NULL)
@@ -14,53 +79,158 @@ bool cartridge_load(struct Cartridge *cartridge, const char *romPath)
         return false;
     }
 
-    fseek(file, 0, SEEK_END);
-    cartridge->dataSize = ftell(file);
-    cartridge->data = malloc(cartridge->dataSize);
-    if (cartridge->data == NULL)
+    // Read in chunks rather than asking for the size, so that this also
+    // works for pipes and other files that can't be mapped
+    size_t capacity = 0;
+    size_t dataSize = 0;
+    while (true)
     {
-        return false;
+        if (dataSize == capacity)
+        {
+            capacity = (capacity == 0) ? 0x8000 : capacity * 2;
+            uint8_t *newData = realloc(cartridge->ownedData, capacity);
+            if (newData == NULL)
+            {
+                fclose(file);
+                return false;
+            }
+            cartridge->ownedData = newData;
+        }
+
+        size_t bytesRead = fread(cartridge->ownedData + dataSize, 1, capacity - dataSize, file);
+        dataSize += bytesRead;
+        if (bytesRead == 0)
+        {
+            break;
+        }
     }
 
-    rewind(file);
-    size_t bytesRead = fread(cartridge->data, 1, cartridge->dataSize, file);
-    assert(bytesRead == cartridge->dataSize);
+    bool success = ! ferror(file);
     fclose(file);
+
+    cartridge->data = cartridge->ownedData;
+    cartridge->dataSize = dataSize;
+    return success;
+}
+
+
+bool cartridge_load(struct Cartridge *cartridge, const char *romPath)
+{
+    cartridge_clear(cartridge);
+    if ( ! map_rom_file(cartridge, romPath) && ! read_rom_file(cartridge, romPath))
+    {
+        cartridge_teardown(cartridge);
+        return false;
+    }
+
+    if (cartridge->dataSize < CARTRIDGE_MIN_DATA_SIZE)
+    {
+        cartridge_teardown(cartridge);
+        return false;
+    }
+    return true;
+}
+
+
+// The data is copied, so the caller's buffer can be freed afterwards
+bool cartridge_load_from_memory(struct Cartridge *cartridge, const uint8_t *data, size_t dataSize)
+{
+    cartridge_clear(cartridge);
+    if (dataSize < CARTRIDGE_MIN_DATA_SIZE)
+    {
+        return false;
+    }
+
+    cartridge->ownedData = malloc(dataSize);
+    if (cartridge->ownedData == NULL)
+    {
+        return false;
+    }
+    memcpy(cartridge->ownedData, data, dataSize);
+    cartridge->data = cartridge->ownedData;
+    cartridge->dataSize = dataSize;
+    return true;
+}
+
+
+// The data is used in place, so any number of cartridges (and the
+// emulators using them) can share one copy of the ROM. It must outlive
+// all of them.
+bool cartridge_load_shared(struct Cartridge *cartridge, const uint8_t *data, size_t dataSize)
+{
+    cartridge_clear(cartridge);
+    if (dataSize < CARTRIDGE_MIN_DATA_SIZE)
+    {
+        return false;
+    }
+
+    cartridge->data = data;
+    cartridge->dataSize = dataSize;
     return true;
 }
 
 
 void cartridge_teardown(struct Cartridge *cartridge)
 {
-    if (cartridge->data != NULL)
+    if (cartridge->ownedData != NULL)
+    {
+        free(cartridge->ownedData);
+    }
+#if CARTRIDGE_MMAP_SUPPORTED
+    if (cartridge->mappedData != NULL)
     {
-        free(cartridge->data);
+        munmap(cartridge->mappedData, cartridge->dataSize);
     }
+#endif
+    cartridge_clear(cartridge);
 }
 
 
 
-static uint16_t cartridge_get_type(uint8_t cartridgeTypeCode)
+// Returns false for types the emulator doesn't support
+static bool cartridge_get_type(uint8_t cartridgeTypeCode, uint16_t *type)
 {
-    uint16_t result;
     switch (cartridgeTypeCode)
     {
     case 0x00:
-        result = CARTRIDGE_TYPE_ROM;
-        break;
+        *type = CARTRIDGE_TYPE_ROM;
+        return true;
     case 0x01:
-        result = CARTRIDGE_TYPE_ROM | CARTRIDGE_TYPE_MBC1;
-        break;
+        *type = CARTRIDGE_TYPE_ROM | CARTRIDGE_TYPE_MBC1;
+        return true;
+    case 0x02:
+        *type = CARTRIDGE_TYPE_ROM | CARTRIDGE_TYPE_MBC1 | CARTRIDGE_TYPE_RAM;
+        return true;
+    case 0x03:
+        *type = CARTRIDGE_TYPE_ROM | CARTRIDGE_TYPE_MBC1 | CARTRIDGE_TYPE_RAM | CARTRIDGE_TYPE_BATTERY;
+        return true;
     // case 0x13:
-    //     result = CARTRIDGE_TYPE_ROM | CARTRIDGE_TYPE_MBC3 | CARTRIDGE_TYPE_RAM | CARTRIDGE_TYPE_BATTERY;
-    //     break;
+    //     *type = CARTRIDGE_TYPE_ROM | CARTRIDGE_TYPE_MBC3 | CARTRIDGE_TYPE_RAM | CARTRIDGE_TYPE_BATTERY;
+    //     return true;
+    default:
+        *type = 0;
+        return false;
+    }
+}
+
+
+static size_t cartridge_get_external_ram_size(uint8_t ramSizeCode)
+{
+    switch (ramSizeCode)
+    {
+    case 0x01:
+        return 0x800;
+    case 0x02:
+        return 0x2000;
+    case 0x03:
+        return 0x8000;
+    case 0x04:
+        return 0x20000;
+    case 0x05:
+        return 0x10000;
     default:
-        // TODO: Better error handling for unsupported cartridge types
-        fprintf(stderr, "Unsupported cartridge type code 0x%02x \n", cartridgeTypeCode);
-        assert(false);
+        return 0;
     }
-    assert(result & CARTRIDGE_TYPE_ROM);
-    return result;
 }
 
 
@@ -104,14 +274,14 @@ void cartridge_get_type_string(const struct CartridgeHeader *header, char *buffe
     }
 }
 
-void cartridge_get_header(const struct Cartridge *cartridge, struct CartridgeHeader *header)
+bool cartridge_get_header(const struct Cartridge *cartridge, struct CartridgeHeader *header)
 {
     memcpy(header->title, &cartridge->data[0x0134], CARTRIDGE_HEADER_TITLE_LENGTH);
     header->title[CARTRIDGE_HEADER_TITLE_LENGTH] = '\0';
     memcpy(header->manufacturerCode, &cartridge->data[0x013f], CARTRIDGE_HEADER_MANUFACTURER_CODE_LENGTH);
     header->manufacturerCode[CARTRIDGE_HEADER_MANUFACTURER_CODE_LENGTH] = '\0';
     header->cgbFlag = cartridge->data[0x0143];
-    header->type = cartridge_get_type(cartridge->data[0x0147]);
-
-    // TODO
+    header->typeCode = cartridge->data[0x0147];
+    header->externalRamSize = cartridge_get_external_ram_size(cartridge->data[0x0149]);
+    return cartridge_get_type(header->typeCode, &header->type);
 }
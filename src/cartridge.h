@@ -19,11 +19,22 @@
 
 struct Cartridge
 {
-    uint8_t *data;
+    const uint8_t *data;
     size_t dataSize;
+
+    // NULL if the data belongs to someone else (see cartridge_load_shared)
+    uint8_t *ownedData;
+
+    // Set instead of ownedData when the data is a read-only mapping of the
+    // ROM file. Its pages are loaded on demand and come straight from the
+    // page cache, so every process running the same ROM shares them.
+    void *mappedData;
 };
 
 
+// Anything shorter can't hold a complete header
+#define CARTRIDGE_MIN_DATA_SIZE  0x0150
+
 #define CARTRIDGE_HEADER_TITLE_LENGTH  11
 #define CARTRIDGE_HEADER_MANUFACTURER_CODE_LENGTH  4
 
@@ -32,12 +43,21 @@ struct CartridgeHeader
     char title[CARTRIDGE_HEADER_TITLE_LENGTH + 1];
     char manufacturerCode[CARTRIDGE_HEADER_MANUFACTURER_CODE_LENGTH + 1];
     uint8_t cgbFlag;
+
+    // As stored in the header, then as CARTRIDGE_TYPE_* flags
+    uint8_t typeCode;
     uint16_t type;
+
+    size_t externalRamSize;
 };
 
 
-void cartridge_get_header(const struct Cartridge *cartridge, struct CartridgeHeader *header);
+// Fills in the whole header, but returns false if the cartridge type isn't
+// one the emulator supports (type is then 0)
+bool cartridge_get_header(const struct Cartridge *cartridge, struct CartridgeHeader *header);
 bool cartridge_load(struct Cartridge *cartridge, const char *romPath);
+bool cartridge_load_from_memory(struct Cartridge *cartridge, const uint8_t *data, size_t dataSize);
+bool cartridge_load_shared(struct Cartridge *cartridge, const uint8_t *data, size_t dataSize);
 void cartridge_teardown(struct Cartridge *cartridge);
 
 void cartridge_get_type_string(const struct CartridgeHeader *header, char *buffer, size_t buflen);
@@ -4,26 +4,29 @@
 #include <assert.h>
 
 #include "cpu.h"
+#include "cpu_flags.h"
 #include "cpu_instructions.h"
+#include "block_cache.h"
 #include "memory.h"
+#include "scheduler.h"
 
 
-static uint8_t read_flags_byte(struct Cpu *cpu)
+static uint8_t read_flags_byte(const struct Cpu *cpu)
 {
     uint8_t value = 0;
-    if (cpu->flags.zero) { value |= (1 << 7); }
-    if (cpu->flags.negative) { value |= (1 << 6); }
-    if (cpu->flags.halfCarry) { value |= (1 << 5); }
-    if (cpu->flags.carry) { value |= (1 << 4); }
+    if (cpu_flag_zero(cpu)) { value |= (1 << 7); }
+    if (cpu_flag_negative(cpu)) { value |= (1 << 6); }
+    if (cpu_flag_half_carry(cpu)) { value |= (1 << 5); }
+    if (cpu_flag_carry(cpu)) { value |= (1 << 4); }
     return value;
 }
 
 static void write_flags_byte(struct Cpu *cpu, uint8_t value)
 {
-    cpu->flags.zero = (value & (1 << 7)) != 0;
-    cpu->flags.negative = (value & (1 << 6)) != 0;
-    cpu->flags.halfCarry = (value & (1 << 5)) != 0;
-    cpu->flags.carry = (value & (1 << 4)) != 0;
+    cpu_set_flag_zero(cpu, (value & (1 << 7)) != 0);
+    cpu_set_flag_negative(cpu, (value & (1 << 6)) != 0);
+    cpu_set_flag_half_carry(cpu, (value & (1 << 5)) != 0);
+    cpu_set_flag_carry(cpu, (value & (1 << 4)) != 0);
 }
 
 
@@ -74,11 +77,14 @@ void cpu_init(struct Cpu *cpu, struct Memory *memory)
     cpu->sp = 0xfffe;
     cpu->ime = true;
     cpu->halted = false;
+    cpu->branchTaken = false;
+    cpu->immediate = 0;
 
     cpu->interruptFlags = 0x00;  // TODO
     cpu->interruptEnable = 0x00;  // TODO
 
     cpu->memory = memory;
+    cpu->blockCache = NULL;
     memory_register_io_handler(
         cpu->memory,
         IO_REGISTER_INTERRUPT_FLAGS,
@@ -98,55 +104,39 @@ void cpu_init(struct Cpu *cpu, struct Memory *memory)
 
 uint16_t cpu_read_double_reg(struct Cpu *cpu, enum CpuDoubleRegister reg)
 {
-    uint16_t lowByte;
-    uint16_t highByte;
     switch (reg)
     {
     case CPU_DOUBLE_REG_AF:
-        highByte = cpu->registers.a;
-        lowByte = read_flags_byte(cpu);
-        break;
+        return ((uint16_t)cpu->registers.a << 8) | read_flags_byte(cpu);
     case CPU_DOUBLE_REG_BC:
-        highByte = cpu->registers.b;
-        lowByte = cpu->registers.c;
-        break;
+        return cpu->registers.bc;
     case CPU_DOUBLE_REG_DE:
-        highByte = cpu->registers.d;
-        lowByte = cpu->registers.e;
-        break;
+        return cpu->registers.de;
     case CPU_DOUBLE_REG_HL:
-        highByte = cpu->registers.h;
-        lowByte = cpu->registers.l;
-        break;
+        return cpu->registers.hl;
     default:
         assert(false);
         return 0;
     }
-    return (highByte << 8) | lowByte;
 }
 
 
 void cpu_write_double_reg(struct Cpu *cpu, enum CpuDoubleRegister reg, uint16_t value)
 {
-    uint8_t lowByte = value & 0xff;
-    uint8_t highByte = value >> 8;
     switch (reg)
     {
     case CPU_DOUBLE_REG_AF:
-        cpu->registers.a = highByte;
-        write_flags_byte(cpu, lowByte);
+        cpu->registers.a = value >> 8;
+        write_flags_byte(cpu, value & 0xff);
         break;
     case CPU_DOUBLE_REG_BC:
-        cpu->registers.b = highByte;
-        cpu->registers.c = lowByte;
+        cpu->registers.bc = value;
         break;
     case CPU_DOUBLE_REG_DE:
-        cpu->registers.d = highByte;
-        cpu->registers.e = lowByte;
+        cpu->registers.de = value;
         break;
     case CPU_DOUBLE_REG_HL:
-        cpu->registers.h = highByte;
-        cpu->registers.l = lowByte;
+        cpu->registers.hl = value;
         break;
     default:
         assert(false);
@@ -217,20 +207,30 @@ void cpu_request_interrupt(struct Cpu *cpu, enum Interrupt interrupt)
 
 
 
-static bool handle_interrupt(struct Cpu *cpu, enum Interrupt interrupt)
+#define INTERRUPT_DISPATCH_CYCLES  5
+#define HALTED_CYCLES              1
+
+static int instruction_cycles(struct Cpu *cpu, const struct Instruction *instruction)
+{
+    return (cpu->branchTaken && instruction->cyclesBranchTaken != instruction->cycles)
+        ? instruction->cyclesBranchTaken
+        : instruction->cycles;
+}
+
+static int handle_interrupt(struct Cpu *cpu, enum Interrupt interrupt)
 {
     cpu->interruptFlags &= ~(1 << (uint8_t)interrupt);
     cpu->ime = false;
     cpu_push_dword(cpu, cpu->pc);
     cpu->pc = 0x0040 + 0x0008 * (uint16_t)interrupt;
-    return true;
+    return INTERRUPT_DISPATCH_CYCLES;
 }
 
 
-bool cpu_execute_next(struct Cpu *cpu)
+// Dispatch the highest priority pending interrupt, if any.
+// Returns the number of cycles taken (zero if no interrupt was dispatched).
+int cpu_handle_interrupts(struct Cpu *cpu)
 {
-    // TODO: Clean this up
-
     if (cpu->ime)
     {
         const enum Interrupt interrupts[] =
@@ -253,9 +253,23 @@ bool cpu_execute_next(struct Cpu *cpu)
             }
         }
     }
+    return 0;
+}
+
+
+bool cpu_execute_next(struct Cpu *cpu, int *cycles)
+{
+    // TODO: Clean this up
+
+    *cycles = cpu_handle_interrupts(cpu);
+    if (*cycles > 0)
+    {
+        return true;
+    }
 
     if (cpu->halted)
     {
+        *cycles = HALTED_CYCLES;
         return true;
     }
 
@@ -300,10 +314,10 @@ bool cpu_execute_next(struct Cpu *cpu)
             instrBytesBuffer,
             instrNameBuffer,
             cpu_read_double_reg(cpu, CPU_DOUBLE_REG_AF),
-            cpu->flags.zero ? 'Z' : 'z',
-            cpu->flags.negative ? 'N': 'n',
-            cpu->flags.halfCarry ? 'H' : 'h',
-            cpu->flags.carry ? 'C' : 'c',
+            cpu_flag_zero(cpu) ? 'Z' : 'z',
+            cpu_flag_negative(cpu) ? 'N': 'n',
+            cpu_flag_half_carry(cpu) ? 'H' : 'h',
+            cpu_flag_carry(cpu) ? 'C' : 'c',
             cpu_read_double_reg(cpu, CPU_DOUBLE_REG_BC),
             cpu_read_double_reg(cpu, CPU_DOUBLE_REG_DE),
             cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL),
@@ -322,9 +336,180 @@ bool cpu_execute_next(struct Cpu *cpu)
         write_instruction_bytes_text(cpu, instruction, instrBytesBuffer, sizeof(instrBytesBuffer));
 
         fprintf(stderr, "Unimplemented instruction ([%s] = \"%s\")! Stopping. \n", instrBytesBuffer, instrNameBuffer);
+        *cycles = 0;
         return false;
     }
 
+    if (instruction->numImmediateBytes == 1)
+    {
+        cpu->immediate = memory_read_word(cpu->memory, cpu->pc);
+    }
+    else if (instruction->numImmediateBytes == 2)
+    {
+        cpu->immediate = memory_read_dword(cpu->memory, cpu->pc);
+    }
+    cpu->pc += instruction->numImmediateBytes;
+
     instruction->impl(cpu);
+    *cycles = instruction_cycles(cpu, instruction);
     return true;
 }
+
+
+#if CPU_SKIP_IDLE_LOOPS
+
+// Called with every block the dispatcher is about to run (NULL if it's
+// about to run an instruction that isn't from the block cache). The caller
+// must clear the state whenever anything else happens in between, such as
+// an interrupt or an event.
+void cpu_skip_idle_loop(struct IdleLoopState *state, struct Cpu *cpu, struct Scheduler *scheduler, const struct DecodedBlock *block)
+{
+    if (block == NULL || ! block->isIdleLoop)
+    {
+        state->block = NULL;
+        return;
+    }
+
+    uint16_t af = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_AF);
+    bool isRepeat =
+        state->block == block &&
+        state->af == af &&
+        state->bc == cpu->registers.bc &&
+        state->de == cpu->registers.de &&
+        state->hl == cpu->registers.hl;
+    if (isRepeat)
+    {
+        // The last time around the loop left the registers unchanged, and
+        // the memory it reads can't change before the next event, so every
+        // iteration until then will be the same. Skip all of them that
+        // would complete before the event is due; the interpreter runs the
+        // rest of the loop as normal.
+        uint64_t iterationCycles = scheduler->now - state->entryTime;
+        uint64_t numIterations = (scheduler->nextEventTime - 1 - scheduler->now) / iterationCycles;
+        scheduler->now += numIterations * iterationCycles;
+    }
+
+    state->block = block;
+    state->entryTime = scheduler->now;
+    state->af = af;
+    state->bc = cpu->registers.bc;
+    state->de = cpu->registers.de;
+    state->hl = cpu->registers.hl;
+}
+
+#endif
+
+
+#if ! CPU_THREADED_DISPATCH
+
+// Run instructions from a decoded block until it ends, a scheduled event is
+// due, an interrupt needs servicing or an MBC write makes the rest of the
+// block stale.
+static void execute_decoded_block(struct Cpu *cpu, struct Scheduler *scheduler, const struct DecodedBlock *block)
+{
+    size_t romBank = cpu->memory->selectedRomBank;
+    for (size_t i = 0; i < block->numInstructions; i++)
+    {
+        const struct DecodedInstruction *decoded = &block->instructions[i];
+        const struct Instruction *instruction = (decoded->opcode & BLOCK_CACHE_CB_OPCODE)
+            ? &cbInstructions[decoded->opcode & 0xff]
+            : &instructions[decoded->opcode];
+
+        cpu->immediate = decoded->immediate;
+        cpu->pc = decoded->nextPc;
+        instruction->impl(cpu);
+        scheduler->now += instruction_cycles(cpu, instruction);
+
+        bool interruptPending = cpu->ime && (cpu->interruptFlags & cpu->interruptEnable & 0x1f);
+        if (scheduler->now >= scheduler->nextEventTime || interruptPending || cpu->memory->selectedRomBank != romBank)
+        {
+            break;
+        }
+    }
+}
+
+#endif
+
+
+// Execute instructions, advancing the scheduler's clock, until the next
+// scheduled event is due. A halted CPU skips straight to that event.
+// Returns false if an instruction could not be executed.
+bool cpu_run(struct Cpu *cpu, struct Scheduler *scheduler)
+{
+#if CPU_THREADED_DISPATCH
+    return cpu_run_threaded(cpu, scheduler);
+#else
+#if CPU_SKIP_IDLE_LOOPS
+    struct IdleLoopState idleLoop = { NULL, 0, 0, 0, 0, 0 };
+#endif
+    while (scheduler->now < scheduler->nextEventTime)
+    {
+        int instructionCycles = cpu_handle_interrupts(cpu);
+        if (instructionCycles > 0)
+        {
+            scheduler->now += instructionCycles;
+            continue;
+        }
+
+        const struct DecodedBlock *block = NULL;
+        if (cpu->blockCache != NULL && ! cpu->halted)
+        {
+            block = block_cache_lookup(cpu->blockCache, cpu->memory, cpu->pc);
+        }
+#if CPU_SKIP_IDLE_LOOPS
+        cpu_skip_idle_loop(&idleLoop, cpu, scheduler, block);
+#endif
+        if (block != NULL)
+        {
+            execute_decoded_block(cpu, scheduler, block);
+            continue;
+        }
+
+        if ( ! cpu_execute_next(cpu, &instructionCycles))
+        {
+            return false;
+        }
+        scheduler->now += instructionCycles;
+
+        if (cpu->halted && scheduler->now < scheduler->nextEventTime)
+        {
+            // Nothing can wake the CPU until the next event fires.
+            scheduler->now = scheduler->nextEventTime;
+        }
+    }
+    return true;
+#endif
+}
+
+
+void cpu_save_state(const struct Cpu *cpu, struct CpuState *state)
+{
+    state->pc = cpu->pc;
+    state->sp = cpu->sp;
+    state->af = ((uint16_t)cpu->registers.a << 8) | read_flags_byte(cpu);
+    state->bc = cpu->registers.bc;
+    state->de = cpu->registers.de;
+    state->hl = cpu->registers.hl;
+    state->ime = cpu->ime;
+    state->halted = cpu->halted;
+    state->interruptFlags = cpu->interruptFlags;
+    state->interruptEnable = cpu->interruptEnable;
+}
+
+
+void cpu_load_state(struct Cpu *cpu, const struct CpuState *state)
+{
+    cpu->pc = state->pc;
+    cpu->sp = state->sp;
+    cpu->registers.a = state->af >> 8;
+    write_flags_byte(cpu, state->af & 0xff);
+    cpu->registers.bc = state->bc;
+    cpu->registers.de = state->de;
+    cpu->registers.hl = state->hl;
+    cpu->ime = state->ime != 0;
+    cpu->halted = state->halted != 0;
+    cpu->branchTaken = false;
+    cpu->immediate = 0;
+    cpu->interruptFlags = state->interruptFlags;
+    cpu->interruptEnable = state->interruptEnable;
+}
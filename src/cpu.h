@@ -6,6 +6,23 @@
 #include <stdbool.h>
 
 struct Memory;
+struct Scheduler;
+struct BlockCache;
+
+
+// Store the raw results of the last flag-setting operations and only work
+// out individual flags when something reads them (see cpu_flags.h). Most
+// flag results are overwritten before they are ever read.
+#ifndef CPU_LAZY_FLAGS
+#define CPU_LAZY_FLAGS  1
+#endif
+
+// Fast-forward through loops that poll memory waiting for something (like
+// LY reaching a given line) to happen, when nothing can change before the
+// next scheduled event. Needs the block cache.
+#ifndef CPU_SKIP_IDLE_LOOPS
+#define CPU_SKIP_IDLE_LOOPS  1
+#endif
 
 
 enum Interrupt
@@ -27,42 +44,86 @@ enum CpuDoubleRegister
 };
 
 
+// A pair of 8-bit registers overlaid on a 16-bit register, with the
+// high register in the high byte regardless of host byte order.
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define CPU_REGISTER_PAIR(pair, high, low) \
+    union { uint16_t pair; struct { uint8_t high; uint8_t low; }; }
+#else
+#define CPU_REGISTER_PAIR(pair, high, low) \
+    union { uint16_t pair; struct { uint8_t low; uint8_t high; }; }
+#endif
+
 struct Cpu
 {
     uint16_t pc;
     uint16_t sp;
 
+    // BC, DE and HL can be accessed directly as 16-bit registers
     struct
     {
         uint8_t a;
-        uint8_t b;
-        uint8_t c;
-        uint8_t d;
-        uint8_t e;
-        uint8_t h;
-        uint8_t l;
+        CPU_REGISTER_PAIR(bc, b, c);
+        CPU_REGISTER_PAIR(de, d, e);
+        CPU_REGISTER_PAIR(hl, h, l);
     } registers;
 
+    // Only access these through the functions in cpu_flags.h
     struct
     {
+#if CPU_LAZY_FLAGS
+        uint8_t zeroResult;        // Z is set if this is 0
+        bool negative;
+        uint16_t halfCarryResult;  // H is bit 4
+        uint16_t carryResult;      // C is bit 8
+#else
         bool zero;
         bool negative;
         bool halfCarry;
         bool carry;
+#endif
     } flags;
 
     bool ime;
     bool halted;
+    bool branchTaken;
+
+    // Immediate operand of the current instruction. It is fetched before
+    // the instruction's implementation runs, after the pc has already been
+    // advanced past it.
+    uint16_t immediate;
 
     uint8_t interruptFlags;
     uint8_t interruptEnable;
 
     struct Memory *memory;
+
+    // Decoded ROM code, or NULL to decode every instruction as it runs
+    struct BlockCache *blockCache;
+};
+
+
+// Register values for save states. The flags are stored as the F register
+// so the layout doesn't depend on CPU_LAZY_FLAGS.
+struct CpuState
+{
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+    uint8_t ime;
+    uint8_t halted;
+    uint8_t interruptFlags;
+    uint8_t interruptEnable;
 };
 
 
 void cpu_init(struct Cpu *cpu, struct Memory *memory);
-bool cpu_execute_next(struct Cpu *cpu);
+bool cpu_execute_next(struct Cpu *cpu, int *cycles);
+bool cpu_run(struct Cpu *cpu, struct Scheduler *scheduler);
+int cpu_handle_interrupts(struct Cpu *cpu);
 void cpu_request_interrupt(struct Cpu *cpu, enum Interrupt interrupt);
 
 uint16_t cpu_read_double_reg(struct Cpu *cpu, enum CpuDoubleRegister reg);
@@ -70,4 +131,7 @@ void cpu_write_double_reg(struct Cpu *cpu, enum CpuDoubleRegister reg, uint16_t
 void cpu_push_dword(struct Cpu *cpu, uint16_t value);
 uint16_t cpu_pop_dword(struct Cpu *cpu);
 
+void cpu_save_state(const struct Cpu *cpu, struct CpuState *state);
+void cpu_load_state(struct Cpu *cpu, const struct CpuState *state);
+
 #endif
@@ -0,0 +1,54 @@
+
+#ifndef CPU_FLAGS_H
+#define CPU_FLAGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+
+// Setters come in two flavours: one taking the flag value, and one taking
+// an intermediate result the flag can be derived from later:
+//   - zero:      the 8-bit result of the operation
+//   - halfCarry: (a ^ b ^ result) for an 8-bit add or subtract of a and b,
+//                so bit 4 holds the carry/borrow out of the low nibble
+//   - carry:     the result of an 8-bit add or subtract widened to 16 bits,
+//                so bit 8 holds the carry/borrow out of bit 7
+
+#if CPU_LAZY_FLAGS
+
+static inline bool cpu_flag_zero(const struct Cpu *cpu) { return cpu->flags.zeroResult == 0; }
+static inline bool cpu_flag_negative(const struct Cpu *cpu) { return cpu->flags.negative; }
+static inline bool cpu_flag_half_carry(const struct Cpu *cpu) { return (cpu->flags.halfCarryResult & 0x10) != 0; }
+static inline bool cpu_flag_carry(const struct Cpu *cpu) { return (cpu->flags.carryResult & 0x100) != 0; }
+
+static inline void cpu_set_flag_zero(struct Cpu *cpu, bool value) { cpu->flags.zeroResult = value ? 0 : 1; }
+static inline void cpu_set_flag_negative(struct Cpu *cpu, bool value) { cpu->flags.negative = value; }
+static inline void cpu_set_flag_half_carry(struct Cpu *cpu, bool value) { cpu->flags.halfCarryResult = value ? 0x10 : 0; }
+static inline void cpu_set_flag_carry(struct Cpu *cpu, bool value) { cpu->flags.carryResult = value ? 0x100 : 0; }
+
+static inline void cpu_set_flag_zero_result(struct Cpu *cpu, uint8_t result) { cpu->flags.zeroResult = result; }
+static inline void cpu_set_flag_half_carry_result(struct Cpu *cpu, uint16_t result) { cpu->flags.halfCarryResult = result; }
+static inline void cpu_set_flag_carry_result(struct Cpu *cpu, uint16_t result) { cpu->flags.carryResult = result; }
+
+#else
+
+static inline bool cpu_flag_zero(const struct Cpu *cpu) { return cpu->flags.zero; }
+static inline bool cpu_flag_negative(const struct Cpu *cpu) { return cpu->flags.negative; }
+static inline bool cpu_flag_half_carry(const struct Cpu *cpu) { return cpu->flags.halfCarry; }
+static inline bool cpu_flag_carry(const struct Cpu *cpu) { return cpu->flags.carry; }
+
+static inline void cpu_set_flag_zero(struct Cpu *cpu, bool value) { cpu->flags.zero = value; }
+static inline void cpu_set_flag_negative(struct Cpu *cpu, bool value) { cpu->flags.negative = value; }
+static inline void cpu_set_flag_half_carry(struct Cpu *cpu, bool value) { cpu->flags.halfCarry = value; }
+static inline void cpu_set_flag_carry(struct Cpu *cpu, bool value) { cpu->flags.carry = value; }
+
+static inline void cpu_set_flag_zero_result(struct Cpu *cpu, uint8_t result) { cpu->flags.zero = result == 0; }
+static inline void cpu_set_flag_half_carry_result(struct Cpu *cpu, uint16_t result) { cpu->flags.halfCarry = (result & 0x10) != 0; }
+static inline void cpu_set_flag_carry_result(struct Cpu *cpu, uint16_t result) { cpu->flags.carry = (result & 0x100) != 0; }
+
+#endif
+
+
+#endif
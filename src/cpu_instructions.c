@@ -3,53 +3,48 @@
 
 #include "cpu_instructions.h"
 #include "cpu.h"
+#include "cpu_flags.h"
 #include "memory.h"
+#include "scheduler.h"
+#include "block_cache.h"
 
 // TODO: Reorganize this file. Group and rename functions as appropriate.
 
 
 static uint8_t read_mem_at_hl(struct Cpu *cpu)
 {
-    uint16_t address = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL);
+    uint16_t address = cpu->registers.hl;
     return memory_read_word(cpu->memory, address);
 }
 
 static void write_mem_at_hl(struct Cpu *cpu, uint8_t value)
 {
-    uint16_t address = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL);
+    uint16_t address = cpu->registers.hl;
     memory_write_word(cpu->memory, address, value);
 }
 
 
+// The dispatcher fetches immediates before running the instruction
 static uint8_t imm_word(struct Cpu *cpu)
 {
-    return memory_read_word(cpu->memory, cpu->pc++);
+    return (uint8_t)cpu->immediate;
 }
 
 static uint16_t imm_dword(struct Cpu *cpu)
 {
-    uint16_t value = memory_read_dword(cpu->memory, cpu->pc);
-    cpu->pc += 2;
-    return value;
+    return cpu->immediate;
 }
 
 
-static uint16_t modify_double_reg(struct Cpu *cpu, enum CpuDoubleRegister reg, uint16_t change)
-{
-    uint16_t value = cpu_read_double_reg(cpu, reg) + change;
-    cpu_write_double_reg(cpu, reg, value);
-    return value;
-}
-
 
-static void push_bc(struct Cpu *cpu) { cpu_push_dword(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_BC)); }
-static void push_de(struct Cpu *cpu) { cpu_push_dword(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_DE)); }
-static void push_hl(struct Cpu *cpu) { cpu_push_dword(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL)); }
+static void push_bc(struct Cpu *cpu) { cpu_push_dword(cpu, cpu->registers.bc); }
+static void push_de(struct Cpu *cpu) { cpu_push_dword(cpu, cpu->registers.de); }
+static void push_hl(struct Cpu *cpu) { cpu_push_dword(cpu, cpu->registers.hl); }
 static void push_af(struct Cpu *cpu) { cpu_push_dword(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_AF)); }
 
-static void pop_bc(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_BC, cpu_pop_dword(cpu)); }
-static void pop_de(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_DE, cpu_pop_dword(cpu)); }
-static void pop_hl(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_HL, cpu_pop_dword(cpu)); }
+static void pop_bc(struct Cpu *cpu) { cpu->registers.bc = cpu_pop_dword(cpu); }
+static void pop_de(struct Cpu *cpu) { cpu->registers.de = cpu_pop_dword(cpu); }
+static void pop_hl(struct Cpu *cpu) { cpu->registers.hl = cpu_pop_dword(cpu); }
 static void pop_af(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_AF, cpu_pop_dword(cpu)); }
 
 
@@ -84,38 +79,40 @@ static void halt(struct Cpu *cpu)
 
 static void jp_hl(struct Cpu *cpu)
 {
-    cpu->pc = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL);
+    cpu->pc = cpu->registers.hl;
 }
 
 static void _jp(struct Cpu *cpu, bool condition)
 {
     uint16_t address = imm_dword(cpu);
+    cpu->branchTaken = condition;
     if (condition)
     {
         cpu->pc = address;
     }
 }
 static void jp_a16(struct Cpu *cpu) { _jp(cpu, true); }
-static void jp_z_a16(struct Cpu *cpu) { _jp(cpu, cpu->flags.zero); }
-static void jp_nz_a16(struct Cpu *cpu) { _jp(cpu, ! cpu->flags.zero); }
-static void jp_c_a16(struct Cpu *cpu) { _jp(cpu, cpu->flags.carry); }
-static void jp_nc_a16(struct Cpu *cpu) { _jp(cpu, ! cpu->flags.carry); }
+static void jp_z_a16(struct Cpu *cpu) { _jp(cpu, cpu_flag_zero(cpu)); }
+static void jp_nz_a16(struct Cpu *cpu) { _jp(cpu, ! cpu_flag_zero(cpu)); }
+static void jp_c_a16(struct Cpu *cpu) { _jp(cpu, cpu_flag_carry(cpu)); }
+static void jp_nc_a16(struct Cpu *cpu) { _jp(cpu, ! cpu_flag_carry(cpu)); }
 
 
 
 static void _jr(struct Cpu *cpu, bool condition)
 {
     int8_t offset = imm_word(cpu);
+    cpu->branchTaken = condition;
     if (condition)
     {
         cpu->pc += offset;
     }
 }
 static void jr(struct Cpu *cpu) { _jr(cpu, true); }
-static void jr_z(struct Cpu *cpu) { _jr(cpu, cpu->flags.zero); }
-static void jr_nz(struct Cpu *cpu) { _jr(cpu, ! cpu->flags.zero); }
-static void jr_c(struct Cpu *cpu) { _jr(cpu, cpu->flags.carry); }
-static void jr_nc(struct Cpu *cpu) { _jr(cpu, ! cpu->flags.carry); }
+static void jr_z(struct Cpu *cpu) { _jr(cpu, cpu_flag_zero(cpu)); }
+static void jr_nz(struct Cpu *cpu) { _jr(cpu, ! cpu_flag_zero(cpu)); }
+static void jr_c(struct Cpu *cpu) { _jr(cpu, cpu_flag_carry(cpu)); }
+static void jr_nc(struct Cpu *cpu) { _jr(cpu, ! cpu_flag_carry(cpu)); }
 
 
 static void rst(struct Cpu* cpu, uint16_t address)
@@ -156,32 +153,32 @@ static void ld_mem_hl_d8(struct Cpu *cpu) { write_mem_at_hl(cpu, imm_word(cpu));
 static void ld_mem_hlm_a(struct Cpu *cpu)
 {
     write_mem_at_hl(cpu, cpu->registers.a);
-    modify_double_reg(cpu, CPU_DOUBLE_REG_HL, -1);
+    cpu->registers.hl -= 1;
 }
 static void ld_mem_hlp_a(struct Cpu *cpu)
 {
     write_mem_at_hl(cpu, cpu->registers.a);
-    modify_double_reg(cpu, CPU_DOUBLE_REG_HL, +1);
+    cpu->registers.hl += 1;
 }
 static void ld_a_mem_hlm(struct Cpu *cpu)
 {
     cpu->registers.a = read_mem_at_hl(cpu);
-    modify_double_reg(cpu, CPU_DOUBLE_REG_HL, -1);
+    cpu->registers.hl -= 1;
 }
 static void ld_a_mem_hlp(struct Cpu *cpu)
 {
     cpu->registers.a = read_mem_at_hl(cpu);
-    modify_double_reg(cpu, CPU_DOUBLE_REG_HL, +1);
+    cpu->registers.hl += 1;
 }
 
 static void ld_mem_bc_a(struct Cpu *cpu)
 {
-    uint16_t address = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_BC);
+    uint16_t address = cpu->registers.bc;
     memory_write_word(cpu->memory, address, cpu->registers.a);
 }
 static void ld_mem_de_a(struct Cpu *cpu)
 {
-    uint16_t address = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_DE);
+    uint16_t address = cpu->registers.de;
     memory_write_word(cpu->memory, address, cpu->registers.a);
 }
 static void ld_mem_a16_sp(struct Cpu *cpu)
@@ -191,12 +188,12 @@ static void ld_mem_a16_sp(struct Cpu *cpu)
 
 static void ld_a_mem_bc(struct Cpu *cpu)
 {
-    uint16_t address = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_BC);
+    uint16_t address = cpu->registers.bc;
     cpu->registers.a = memory_read_word(cpu->memory, address);
 }
 static void ld_a_mem_de(struct Cpu *cpu)
 {
-    uint16_t address = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_DE);
+    uint16_t address = cpu->registers.de;
     cpu->registers.a = memory_read_word(cpu->memory, address);
 }
 
@@ -221,11 +218,11 @@ static void ld_mem_c_a(struct Cpu *cpu)
 
 
 static void ld_sp_d16(struct Cpu *cpu) { cpu->sp = imm_dword(cpu); }
-static void ld_bc_d16(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_BC, imm_dword(cpu)); }
-static void ld_de_d16(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_DE, imm_dword(cpu)); }
-static void ld_hl_d16(struct Cpu *cpu) { cpu_write_double_reg(cpu, CPU_DOUBLE_REG_HL, imm_dword(cpu)); }
+static void ld_bc_d16(struct Cpu *cpu) { cpu->registers.bc = imm_dword(cpu); }
+static void ld_de_d16(struct Cpu *cpu) { cpu->registers.de = imm_dword(cpu); }
+static void ld_hl_d16(struct Cpu *cpu) { cpu->registers.hl = imm_dword(cpu); }
 
-static void ld_sp_hl(struct Cpu *cpu) { cpu->sp = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL); }
+static void ld_sp_hl(struct Cpu *cpu) { cpu->sp = cpu->registers.hl; }
 
 
 
@@ -233,17 +230,17 @@ static uint16_t add_signed_word_to_dword(struct Cpu *cpu, uint16_t dword, int16_
 {
     uint16_t total = (int32_t)dword + (int32_t)word;
     uint16_t tmp = dword ^ (uint16_t)word ^ total;
-    cpu->flags.zero = false;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = (tmp & 0x10) == 0x10;
-    cpu->flags.carry = (tmp & 0x100) == 0x100;
+    cpu_set_flag_zero(cpu, false);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry_result(cpu, tmp);
+    cpu_set_flag_carry_result(cpu, tmp);
     return total;
 }
 
 static void ld_hl_sp_plus_r(struct Cpu *cpu)
 {
     uint16_t hl = add_signed_word_to_dword(cpu, cpu->sp, imm_word(cpu));
-    cpu_write_double_reg(cpu, CPU_DOUBLE_REG_HL, hl);
+    cpu->registers.hl = hl;
 }
 static void add_sp_r(struct Cpu *cpu)
 {
@@ -255,9 +252,9 @@ static void add_sp_r(struct Cpu *cpu)
 static uint8_t dec(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = value - 1;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = true;
-    cpu->flags.halfCarry = (value & 0x0f) == 0x00;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, true);
+    cpu_set_flag_half_carry_result(cpu, value ^ 0x01 ^ newValue);
     // carry flag not affected
     return newValue;
 }
@@ -279,9 +276,9 @@ static void dec_mem_hl(struct Cpu *cpu)
 static uint8_t inc(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = value + 1;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = (value & 0x0f) == 0x0f;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry_result(cpu, value ^ 0x01 ^ newValue);
     // carry flag not affected
     return newValue;
 }
@@ -302,10 +299,11 @@ static void inc_mem_hl(struct Cpu *cpu)
 
 static void cp(struct Cpu *cpu, uint8_t value)
 {
-    cpu->flags.zero = cpu->registers.a == value;
-    cpu->flags.negative = true;
-    cpu->flags.halfCarry = (value & 0x0f) > (cpu->registers.a & 0x0f);
-    cpu->flags.carry = cpu->registers.a < value;
+    uint16_t result = (uint16_t)cpu->registers.a - value;
+    cpu_set_flag_zero_result(cpu, result);
+    cpu_set_flag_negative(cpu, true);
+    cpu_set_flag_half_carry_result(cpu, cpu->registers.a ^ value ^ result);
+    cpu_set_flag_carry_result(cpu, result);
 }
 static void cp_a(struct Cpu *cpu) { cp(cpu, cpu->registers.a); }
 static void cp_b(struct Cpu *cpu) { cp(cpu, cpu->registers.b); }
@@ -322,6 +320,7 @@ static void cp_d8(struct Cpu* cpu) { cp(cpu, imm_word(cpu)); }
 static void _call_a16(struct Cpu *cpu, bool condition)
 {
     uint16_t address = imm_dword(cpu);
+    cpu->branchTaken = condition;
     if (condition)
     {
         cpu_push_dword(cpu, cpu->pc);
@@ -329,35 +328,36 @@ static void _call_a16(struct Cpu *cpu, bool condition)
     }
 }
 static void call_a16(struct Cpu *cpu) { _call_a16(cpu, true); }
-static void call_z_a16(struct Cpu *cpu) { _call_a16(cpu, cpu->flags.zero); }
-static void call_nz_a16(struct Cpu *cpu) { _call_a16(cpu, ! cpu->flags.zero); }
-static void call_c_a16(struct Cpu *cpu) { _call_a16(cpu, cpu->flags.carry); }
-static void call_nc_a16(struct Cpu *cpu) { _call_a16(cpu, ! cpu->flags.carry); }
+static void call_z_a16(struct Cpu *cpu) { _call_a16(cpu, cpu_flag_zero(cpu)); }
+static void call_nz_a16(struct Cpu *cpu) { _call_a16(cpu, ! cpu_flag_zero(cpu)); }
+static void call_c_a16(struct Cpu *cpu) { _call_a16(cpu, cpu_flag_carry(cpu)); }
+static void call_nc_a16(struct Cpu *cpu) { _call_a16(cpu, ! cpu_flag_carry(cpu)); }
 
 
 static void _ret(struct Cpu *cpu, bool condition)
 {
+    cpu->branchTaken = condition;
     if (condition)
     {
         cpu->pc = cpu_pop_dword(cpu);
     }
 }
 static void ret(struct Cpu *cpu) { _ret(cpu, true); }
-static void ret_z(struct Cpu *cpu) { _ret(cpu, cpu->flags.zero); }
-static void ret_nz(struct Cpu *cpu) { _ret(cpu, ! cpu->flags.zero); }
-static void ret_c(struct Cpu *cpu) { _ret(cpu, cpu->flags.carry); }
-static void ret_nc(struct Cpu *cpu) { _ret(cpu, ! cpu->flags.carry); }
+static void ret_z(struct Cpu *cpu) { _ret(cpu, cpu_flag_zero(cpu)); }
+static void ret_nz(struct Cpu *cpu) { _ret(cpu, ! cpu_flag_zero(cpu)); }
+static void ret_c(struct Cpu *cpu) { _ret(cpu, cpu_flag_carry(cpu)); }
+static void ret_nc(struct Cpu *cpu) { _ret(cpu, ! cpu_flag_carry(cpu)); }
 static void reti(struct Cpu *cpu) { ret(cpu); cpu->ime = true; }
 
 
-static void inc_bc(struct Cpu *cpu) { modify_double_reg(cpu, CPU_DOUBLE_REG_BC, +1); }
-static void inc_de(struct Cpu *cpu) { modify_double_reg(cpu, CPU_DOUBLE_REG_DE, +1); }
-static void inc_hl(struct Cpu *cpu) { modify_double_reg(cpu, CPU_DOUBLE_REG_HL, +1); }
+static void inc_bc(struct Cpu *cpu) { cpu->registers.bc += 1; }
+static void inc_de(struct Cpu *cpu) { cpu->registers.de += 1; }
+static void inc_hl(struct Cpu *cpu) { cpu->registers.hl += 1; }
 static void inc_sp(struct Cpu *cpu) { cpu->sp += 1; }
 
-static void dec_bc(struct Cpu *cpu) { modify_double_reg(cpu, CPU_DOUBLE_REG_BC, -1); }
-static void dec_de(struct Cpu *cpu) { modify_double_reg(cpu, CPU_DOUBLE_REG_DE, -1); }
-static void dec_hl(struct Cpu *cpu) { modify_double_reg(cpu, CPU_DOUBLE_REG_HL, -1); }
+static void dec_bc(struct Cpu *cpu) { cpu->registers.bc -= 1; }
+static void dec_de(struct Cpu *cpu) { cpu->registers.de -= 1; }
+static void dec_hl(struct Cpu *cpu) { cpu->registers.hl -= 1; }
 static void dec_sp(struct Cpu *cpu) { cpu->sp -= 1; }
 
 
@@ -442,10 +442,10 @@ static void ld_a_mem_c(struct Cpu *cpu)
 static void and(struct Cpu *cpu, uint8_t value)
 {
     cpu->registers.a &= value;
-    cpu->flags.zero = cpu->registers.a == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = true;
-    cpu->flags.carry = false;
+    cpu_set_flag_zero_result(cpu, cpu->registers.a);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, true);
+    cpu_set_flag_carry(cpu, false);
 }
 static void and_a(struct Cpu *cpu) { and(cpu, cpu->registers.a); }
 static void and_b(struct Cpu *cpu) { and(cpu, cpu->registers.b); }
@@ -461,10 +461,10 @@ static void and_d8(struct Cpu *cpu) { and(cpu, imm_word(cpu)); }
 static void or(struct Cpu *cpu, uint8_t value)
 {
     cpu->registers.a |= value;
-    cpu->flags.zero = cpu->registers.a == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = false;
+    cpu_set_flag_zero_result(cpu, cpu->registers.a);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry(cpu, false);
 }
 static void or_a(struct Cpu *cpu) { or(cpu, cpu->registers.a); }
 static void or_b(struct Cpu *cpu) { or(cpu, cpu->registers.b); }
@@ -480,10 +480,10 @@ static void or_d8(struct Cpu *cpu) { or(cpu, imm_word(cpu)); }
 static void xor(struct Cpu *cpu, uint8_t value)
 {
     cpu->registers.a ^= value;
-    cpu->flags.zero = cpu->registers.a == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = false;
+    cpu_set_flag_zero_result(cpu, cpu->registers.a);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry(cpu, false);
 }
 static void xor_a(struct Cpu *cpu) { xor(cpu, cpu->registers.a); }
 static void xor_b(struct Cpu *cpu) { xor(cpu, cpu->registers.b); }
@@ -498,12 +498,12 @@ static void xor_d8(struct Cpu *cpu) { xor(cpu, imm_word(cpu)); }
 
 static void add(struct Cpu *cpu, uint8_t value)
 {
-    uint8_t newValue = cpu->registers.a + value;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = (((cpu->registers.a & 0x0f) + (value & 0x0f)) & 0x10) != 0;
-    cpu->flags.carry = 0xff - cpu->registers.a < value;
-    cpu->registers.a = newValue;
+    uint16_t result = (uint16_t)cpu->registers.a + value;
+    cpu_set_flag_zero_result(cpu, result);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry_result(cpu, cpu->registers.a ^ value ^ result);
+    cpu_set_flag_carry_result(cpu, result);
+    cpu->registers.a = result;
 }
 static void add_a(struct Cpu *cpu) { add(cpu, cpu->registers.a); }
 static void add_b(struct Cpu *cpu) { add(cpu, cpu->registers.b); }
@@ -518,14 +518,13 @@ static void add_d8(struct Cpu *cpu) { add(cpu, imm_word(cpu)); }
 
 static void adc(struct Cpu *cpu, uint8_t value)
 {
-    uint16_t carry = cpu->flags.carry ? 1 : 0;
+    uint16_t carry = cpu_flag_carry(cpu) ? 1 : 0;
     uint16_t result = cpu->registers.a + value + carry;
-    uint8_t newValue = result & 0x00ff;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = ((cpu->registers.a & 0x0f) + (value & 0x0f) + carry) > 0x0f;
-    cpu->flags.carry = result > 0x00ff;
-    cpu->registers.a = newValue;
+    cpu_set_flag_zero_result(cpu, result);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry_result(cpu, cpu->registers.a ^ value ^ result);
+    cpu_set_flag_carry_result(cpu, result);
+    cpu->registers.a = result;
 }
 static void adc_a(struct Cpu *cpu) { adc(cpu, cpu->registers.a); }
 static void adc_b(struct Cpu *cpu) { adc(cpu, cpu->registers.b); }
@@ -540,12 +539,12 @@ static void adc_d8(struct Cpu *cpu) { adc(cpu, imm_word(cpu)); }
 
 static void sub(struct Cpu *cpu, uint8_t value)
 {
-    uint8_t newValue = cpu->registers.a - value;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = true;
-    cpu->flags.halfCarry = (cpu->registers.a & 0x0f) < (value & 0x0f);
-    cpu->flags.carry = value > cpu->registers.a;
-    cpu->registers.a = newValue;
+    uint16_t result = (uint16_t)cpu->registers.a - value;
+    cpu_set_flag_zero_result(cpu, result);
+    cpu_set_flag_negative(cpu, true);
+    cpu_set_flag_half_carry_result(cpu, cpu->registers.a ^ value ^ result);
+    cpu_set_flag_carry_result(cpu, result);
+    cpu->registers.a = result;
 }
 static void sub_a(struct Cpu *cpu) { sub(cpu, cpu->registers.a); }
 static void sub_b(struct Cpu *cpu) { sub(cpu, cpu->registers.b); }
@@ -560,13 +559,12 @@ static void sub_d8(struct Cpu *cpu) { sub(cpu, imm_word(cpu)); }
 
 static void sbc(struct Cpu *cpu, uint8_t value)
 {
-    uint16_t carry = cpu->flags.carry ? 1 : 0;
-    uint16_t start = cpu->registers.a;
-    uint16_t result = start - value - carry;
-    cpu->flags.zero = (result & 0x00ff) == 0;
-    cpu->flags.negative = true;
-    cpu->flags.halfCarry = (int16_t)(start & 0x0f) - (int16_t)(value & 0x0f) - (int16_t)carry < 0;
-    cpu->flags.carry = result > 0x00ff;
+    uint16_t carry = cpu_flag_carry(cpu) ? 1 : 0;
+    uint16_t result = (uint16_t)cpu->registers.a - value - carry;
+    cpu_set_flag_zero_result(cpu, result);
+    cpu_set_flag_negative(cpu, true);
+    cpu_set_flag_half_carry_result(cpu, cpu->registers.a ^ value ^ result);
+    cpu_set_flag_carry_result(cpu, result);
     cpu->registers.a = result;
 }
 static void sbc_a(struct Cpu *cpu) { sbc(cpu, cpu->registers.a); }
@@ -582,17 +580,19 @@ static void sbc_d8(struct Cpu *cpu) { sbc(cpu, imm_word(cpu)); }
 
 static void add_hl_rr(struct Cpu *cpu, uint16_t value)
 {
-    uint32_t hl = cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL);
+    uint32_t hl = cpu->registers.hl;
     uint32_t newValue = hl + (uint32_t)value;
     // zero flag not affected
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = (((hl & 0x0fff) + (value & 0x0fff)) & 0x1000) != 0;
-    cpu->flags.carry = newValue > 0xffff;
-    cpu_write_double_reg(cpu, CPU_DOUBLE_REG_HL, newValue);
-}
-static void add_hl_bc(struct Cpu *cpu) { add_hl_rr(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_BC)); }
-static void add_hl_de(struct Cpu *cpu) { add_hl_rr(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_DE)); }
-static void add_hl_hl(struct Cpu *cpu) { add_hl_rr(cpu, cpu_read_double_reg(cpu, CPU_DOUBLE_REG_HL)); }
+    // Shift the carries out of bits 11 and 15 down to where the 8-bit
+    // operations keep them.
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry_result(cpu, (hl ^ value ^ newValue) >> 8);
+    cpu_set_flag_carry_result(cpu, newValue >> 8);
+    cpu->registers.hl = newValue;
+}
+static void add_hl_bc(struct Cpu *cpu) { add_hl_rr(cpu, cpu->registers.bc); }
+static void add_hl_de(struct Cpu *cpu) { add_hl_rr(cpu, cpu->registers.de); }
+static void add_hl_hl(struct Cpu *cpu) { add_hl_rr(cpu, cpu->registers.hl); }
 static void add_hl_sp(struct Cpu *cpu) { add_hl_rr(cpu, cpu->sp); }
 
 
@@ -600,60 +600,65 @@ static void cpl(struct Cpu *cpu)
 {
     cpu->registers.a = ~cpu->registers.a;
     // zero flag not affected
-    cpu->flags.negative = true;
-    cpu->flags.halfCarry = true;
+    cpu_set_flag_negative(cpu, true);
+    cpu_set_flag_half_carry(cpu, true);
     // carry flag not affected
 }
 
 
 static void daa(struct Cpu *cpu)
 {
-    if ( ! cpu->flags.negative)
+    bool carry = cpu_flag_carry(cpu);
+    bool halfCarry = cpu_flag_half_carry(cpu);
+
+    if ( ! cpu_flag_negative(cpu))
     {
-        if (cpu->flags.carry || cpu->registers.a > 0x99)
+        if (carry || cpu->registers.a > 0x99)
         {
             cpu->registers.a += 0x60;
-            cpu->flags.carry = true;
+            carry = true;
         }
 
-        if (cpu->flags.halfCarry || (cpu->registers.a & 0x0f) > 0x09)
+        if (halfCarry || (cpu->registers.a & 0x0f) > 0x09)
         {
             cpu->registers.a += 0x06;
-            cpu->flags.halfCarry = false;
+            halfCarry = false;
         }
     }
-    else if (cpu->flags.carry && cpu->flags.halfCarry)
+    else if (carry && halfCarry)
     {
         cpu->registers.a += 0x9a;
-        cpu->flags.halfCarry = false;
+        halfCarry = false;
     }
-    else if (cpu->flags.carry)
+    else if (carry)
     {
         cpu->registers.a += 0xa0;
     }
-    else if (cpu->flags.halfCarry)
+    else if (halfCarry)
     {
         cpu->registers.a += 0xfa;
-        cpu->flags.halfCarry = false;
+        halfCarry = false;
     }
-    cpu->flags.zero = cpu->registers.a == 0;
+    cpu_set_flag_zero_result(cpu, cpu->registers.a);
+    cpu_set_flag_half_carry(cpu, halfCarry);
+    cpu_set_flag_carry(cpu, carry);
 }
 
 
 static void scf(struct Cpu *cpu)
 {
     // zero flag not affected
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = true;
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry(cpu, true);
 }
 
 static void ccf(struct Cpu *cpu)
 {
     // zero flag not affected
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = ! cpu->flags.carry;
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry(cpu, ! cpu_flag_carry(cpu));
 }
 
 
@@ -663,10 +668,10 @@ static uint8_t swap(struct Cpu *cpu, uint8_t value)
     uint8_t upper = value >> 4;
     uint8_t lower = value & 0x0f;
     uint8_t newValue = (lower << 4) | upper;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = false;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry(cpu, false);
     return newValue;
 }
 static void swap_a(struct Cpu *cpu) { cpu->registers.a = swap(cpu, cpu->registers.a); }
@@ -682,9 +687,9 @@ static void swap_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, swap(cpu, read_mem_a
 
 static void bit(struct Cpu *cpu, uint8_t bitnum, uint8_t value)
 {
-    cpu->flags.zero = (value & (1 << bitnum)) == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = true;
+    cpu_set_flag_zero_result(cpu, value & (1 << bitnum));
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, true);
     // carry flag not affected
 }
 static void bit_0_a(struct Cpu *cpu) { bit(cpu, 0, cpu->registers.a); }
@@ -918,10 +923,10 @@ static void res_7_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, res(7, read_mem_at_
 static uint8_t sla(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = value << 1;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x80) != 0;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 1);
     return newValue;
 }
 static void sla_a(struct Cpu *cpu) { cpu->registers.a = sla(cpu, cpu->registers.a); }
@@ -937,10 +942,10 @@ static void sla_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, sla(cpu, read_mem
 static uint8_t srl(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = value >> 1;
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x01) != 0;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 8);
     return newValue;
 }
 static void srl_a(struct Cpu *cpu) { cpu->registers.a = srl(cpu, cpu->registers.a); }
@@ -956,10 +961,10 @@ static void srl_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, srl(cpu, read_mem
 static uint8_t sra(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = value >> 1 | (value & 0x80);
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x01) != 0;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 8);
     return newValue;
 }
 static void sra_a(struct Cpu *cpu) { cpu->registers.a = sra(cpu, cpu->registers.a); }
@@ -975,10 +980,10 @@ static void sra_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, sra(cpu, read_mem
 static uint8_t rlc(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = (value << 1) | ((value & 0x80) ? 0x01 : 0);
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x80) != 0;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 1);
     return newValue;
 }
 static void rlc_a(struct Cpu *cpu) { cpu->registers.a = rlc(cpu, cpu->registers.a); }
@@ -993,11 +998,11 @@ static void rlc_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, rlc(cpu, read_mem
 
 static uint8_t rl(struct Cpu *cpu, uint8_t value)
 {
-    uint8_t newValue = (value << 1) | (cpu->flags.carry ? 0x01 : 0);
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x80) != 0;
+    uint8_t newValue = (value << 1) | (cpu_flag_carry(cpu) ? 0x01 : 0);
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 1);
     return newValue;
 }
 static void rl_a(struct Cpu *cpu) { cpu->registers.a = rl(cpu, cpu->registers.a); }
@@ -1013,10 +1018,10 @@ static void rl_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, rl(cpu, read_mem_a
 static uint8_t rrc(struct Cpu *cpu, uint8_t value)
 {
     uint8_t newValue = (value >> 1) | ((value & 0x01) ? 0x80 : 0);
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x01) != 0;
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 8);
     return newValue;
 }
 static void rrc_a(struct Cpu *cpu) { cpu->registers.a = rrc(cpu, cpu->registers.a); }
@@ -1031,11 +1036,11 @@ static void rrc_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, rrc(cpu, read_mem
 
 static uint8_t rr(struct Cpu *cpu, uint8_t value)
 {
-    uint8_t newValue = (value >> 1) | (cpu->flags.carry ? 0x80 : 0);
-    cpu->flags.zero = newValue == 0;
-    cpu->flags.negative = false;
-    cpu->flags.halfCarry = false;
-    cpu->flags.carry = (value & 0x01) != 0;
+    uint8_t newValue = (value >> 1) | (cpu_flag_carry(cpu) ? 0x80 : 0);
+    cpu_set_flag_zero_result(cpu, newValue);
+    cpu_set_flag_negative(cpu, false);
+    cpu_set_flag_half_carry(cpu, false);
+    cpu_set_flag_carry_result(cpu, value << 8);
     return newValue;
 }
 static void rr_a(struct Cpu *cpu) { cpu->registers.a = rr(cpu, cpu->registers.a); }
@@ -1055,22 +1060,22 @@ static void rr_mem_hl(struct Cpu *cpu) { write_mem_at_hl(cpu, rr(cpu, read_mem_a
 static void rlca(struct Cpu *cpu)
 {
     rlc_a(cpu);
-    cpu->flags.zero = false;
+    cpu_set_flag_zero(cpu, false);
 }
 static void rla(struct Cpu *cpu)
 {
     rl_a(cpu);
-    cpu->flags.zero = false;
+    cpu_set_flag_zero(cpu, false);
 }
 static void rrca(struct Cpu *cpu)
 {
     rrc_a(cpu);
-    cpu->flags.zero = false;
+    cpu_set_flag_zero(cpu, false);
 }
 static void rra(struct Cpu *cpu)
 {
     rr_a(cpu);
-    cpu->flags.zero = false;
+    cpu_set_flag_zero(cpu, false);
 }
 
 
@@ -1081,581 +1086,795 @@ static void rra(struct Cpu *cpu)
 
 const struct Instruction instructions[256] = {
     // 0x00
-    { "NOP",             0, nop },
-    { "LD BC, 0x%04x",   2, ld_bc_d16 },
-    { "LD (BC), A",      0, ld_mem_bc_a },
-    { "INC BC",          0, inc_bc },
-    { "INC B",           0, inc_b },
-    { "DEC B",           0, dec_b },
-    { "LD B, 0x%02x",    1, ld_b_d8 },
-    { "RLCA",            0, rlca },
-    { "LD (0x%04x), SP", 2, ld_mem_a16_sp },
-    { "ADD HL, BC",      0, add_hl_bc },
-    { "LD A, (BC)",      0, ld_a_mem_bc },
-    { "DEC BC",          0, dec_bc },
-    { "INC C",           0, inc_c },
-    { "DEC C",           0, dec_c },
-    { "LD C, 0x%02x",    1, ld_c_d8 },
-    { "RRCA",            0, rrca },
+    { "NOP",             0, 1, 1, nop },
+    { "LD BC, 0x%04x",   2, 3, 3, ld_bc_d16 },
+    { "LD (BC), A",      0, 2, 2, ld_mem_bc_a },
+    { "INC BC",          0, 2, 2, inc_bc },
+    { "INC B",           0, 1, 1, inc_b },
+    { "DEC B",           0, 1, 1, dec_b },
+    { "LD B, 0x%02x",    1, 2, 2, ld_b_d8 },
+    { "RLCA",            0, 1, 1, rlca },
+    { "LD (0x%04x), SP", 2, 5, 5, ld_mem_a16_sp },
+    { "ADD HL, BC",      0, 2, 2, add_hl_bc },
+    { "LD A, (BC)",      0, 2, 2, ld_a_mem_bc },
+    { "DEC BC",          0, 2, 2, dec_bc },
+    { "INC C",           0, 1, 1, inc_c },
+    { "DEC C",           0, 1, 1, dec_c },
+    { "LD C, 0x%02x",    1, 2, 2, ld_c_d8 },
+    { "RRCA",            0, 1, 1, rrca },
 
     // 0x10
-    { "STOP %d",         1, NULL },
-    { "LD DE, 0x%04x",   2, ld_de_d16 },
-    { "LD (DE), A",      0, ld_mem_de_a },
-    { "INC DE",          0, inc_de },
-    { "INC D",           0, inc_d },
-    { "DEC D",           0, dec_d },
-    { "LD D, 0x%02x",    1, ld_d_d8 },
-    { "RLA",             0, rla },
-    { "JR %hhd",         1, jr },
-    { "ADD HL, DE",      0, add_hl_de },
-    { "LD A, (DE)",      0, ld_a_mem_de },
-    { "DEC DE",          0, dec_de },
-    { "INC E",           0, inc_e },
-    { "DEC E",           0, dec_e },
-    { "LD E, 0x%02x",    1, ld_e_d8 },
-    { "RRA",             0, rra },
+    { "STOP %d",         1, 1, 1, NULL },
+    { "LD DE, 0x%04x",   2, 3, 3, ld_de_d16 },
+    { "LD (DE), A",      0, 2, 2, ld_mem_de_a },
+    { "INC DE",          0, 2, 2, inc_de },
+    { "INC D",           0, 1, 1, inc_d },
+    { "DEC D",           0, 1, 1, dec_d },
+    { "LD D, 0x%02x",    1, 2, 2, ld_d_d8 },
+    { "RLA",             0, 1, 1, rla },
+    { "JR %hhd",         1, 3, 3, jr },
+    { "ADD HL, DE",      0, 2, 2, add_hl_de },
+    { "LD A, (DE)",      0, 2, 2, ld_a_mem_de },
+    { "DEC DE",          0, 2, 2, dec_de },
+    { "INC E",           0, 1, 1, inc_e },
+    { "DEC E",           0, 1, 1, dec_e },
+    { "LD E, 0x%02x",    1, 2, 2, ld_e_d8 },
+    { "RRA",             0, 1, 1, rra },
 
     // 0x20
-    { "JR NZ, %hhd",     1, jr_nz },
-    { "LD HL, 0x%04x",   2, ld_hl_d16 },
-    { "LD (HL+), A",     0, ld_mem_hlp_a },
-    { "INC HL",          0, inc_hl },
-    { "INC H",           0, inc_h },
-    { "DEC H",           0, dec_h },
-    { "LD H, 0x%02x",    1, ld_h_d8 },
-    { "DAA",             0, daa },
-    { "JR Z, %hhd",      1, jr_z },
-    { "ADD HL, HL",      0, add_hl_hl },
-    { "LD A, (HL+)",     0, ld_a_mem_hlp },
-    { "DEC HL",          0, dec_hl },
-    { "INC L",           0, inc_l },
-    { "DEC L",           0, dec_l },
-    { "LD L, 0x%02x",    1, ld_l_d8 },
-    { "CPL",             0, cpl },
+    { "JR NZ, %hhd",     1, 2, 3, jr_nz },
+    { "LD HL, 0x%04x",   2, 3, 3, ld_hl_d16 },
+    { "LD (HL+), A",     0, 2, 2, ld_mem_hlp_a },
+    { "INC HL",          0, 2, 2, inc_hl },
+    { "INC H",           0, 1, 1, inc_h },
+    { "DEC H",           0, 1, 1, dec_h },
+    { "LD H, 0x%02x",    1, 2, 2, ld_h_d8 },
+    { "DAA",             0, 1, 1, daa },
+    { "JR Z, %hhd",      1, 2, 3, jr_z },
+    { "ADD HL, HL",      0, 2, 2, add_hl_hl },
+    { "LD A, (HL+)",     0, 2, 2, ld_a_mem_hlp },
+    { "DEC HL",          0, 2, 2, dec_hl },
+    { "INC L",           0, 1, 1, inc_l },
+    { "DEC L",           0, 1, 1, dec_l },
+    { "LD L, 0x%02x",    1, 2, 2, ld_l_d8 },
+    { "CPL",             0, 1, 1, cpl },
 
     // 0x30
-    { "JR NC, %hhd",     1, jr_nc },
-    { "LD SP, 0x%04x",   2, ld_sp_d16 },
-    { "LD (HL-), A",     0, ld_mem_hlm_a },
-    { "INC SP",          0, inc_sp },
-    { "INC (HL)",        0, inc_mem_hl },
-    { "DEC (HL)",        0, dec_mem_hl },
-    { "LD (HL), 0x%02x", 1, ld_mem_hl_d8 },
-    { "SCF",             0, scf },
-    { "JR C, %hhd",      1, jr_c },
-    { "ADD HL, SP",      0, add_hl_sp },
-    { "LD A, (HL-)",     0, ld_a_mem_hlm },
-    { "DEC SP",          0, dec_sp },
-    { "INC A",           0, inc_a },
-    { "DEC A",           0, dec_a },
-    { "LD A, 0x%02x",    1, ld_a_d8 },
-    { "CCF",             0, ccf },
+    { "JR NC, %hhd",     1, 2, 3, jr_nc },
+    { "LD SP, 0x%04x",   2, 3, 3, ld_sp_d16 },
+    { "LD (HL-), A",     0, 2, 2, ld_mem_hlm_a },
+    { "INC SP",          0, 2, 2, inc_sp },
+    { "INC (HL)",        0, 3, 3, inc_mem_hl },
+    { "DEC (HL)",        0, 3, 3, dec_mem_hl },
+    { "LD (HL), 0x%02x", 1, 3, 3, ld_mem_hl_d8 },
+    { "SCF",             0, 1, 1, scf },
+    { "JR C, %hhd",      1, 2, 3, jr_c },
+    { "ADD HL, SP",      0, 2, 2, add_hl_sp },
+    { "LD A, (HL-)",     0, 2, 2, ld_a_mem_hlm },
+    { "DEC SP",          0, 2, 2, dec_sp },
+    { "INC A",           0, 1, 1, inc_a },
+    { "DEC A",           0, 1, 1, dec_a },
+    { "LD A, 0x%02x",    1, 2, 2, ld_a_d8 },
+    { "CCF",             0, 1, 1, ccf },
 
     // 0x40
-    { "LD B, B",         0, ld_b_b },
-    { "LD B, C",         0, ld_b_c },
-    { "LD B, D",         0, ld_b_d },
-    { "LD B, E",         0, ld_b_e },
-    { "LD B, H",         0, ld_b_h },
-    { "LD B, L",         0, ld_b_l },
-    { "LD B, (HL)",      0, ld_b_hl },
-    { "LD B, A",         0, ld_b_a },
-    { "LD C, B",         0, ld_c_b },
-    { "LD C, C",         0, ld_c_c },
-    { "LD C, D",         0, ld_c_d },
-    { "LD C, E",         0, ld_c_e },
-    { "LD C, H",         0, ld_c_h },
-    { "LD C, L",         0, ld_c_l },
-    { "LD C, (HL)",      0, ld_c_hl },
-    { "LD C, A",         0, ld_c_a },
+    { "LD B, B",         0, 1, 1, ld_b_b },
+    { "LD B, C",         0, 1, 1, ld_b_c },
+    { "LD B, D",         0, 1, 1, ld_b_d },
+    { "LD B, E",         0, 1, 1, ld_b_e },
+    { "LD B, H",         0, 1, 1, ld_b_h },
+    { "LD B, L",         0, 1, 1, ld_b_l },
+    { "LD B, (HL)",      0, 2, 2, ld_b_hl },
+    { "LD B, A",         0, 1, 1, ld_b_a },
+    { "LD C, B",         0, 1, 1, ld_c_b },
+    { "LD C, C",         0, 1, 1, ld_c_c },
+    { "LD C, D",         0, 1, 1, ld_c_d },
+    { "LD C, E",         0, 1, 1, ld_c_e },
+    { "LD C, H",         0, 1, 1, ld_c_h },
+    { "LD C, L",         0, 1, 1, ld_c_l },
+    { "LD C, (HL)",      0, 2, 2, ld_c_hl },
+    { "LD C, A",         0, 1, 1, ld_c_a },
 
     // 0x50
-    { "LD D, B",         0, ld_d_b },
-    { "LD D, C",         0, ld_d_c },
-    { "LD D, D",         0, ld_d_d },
-    { "LD D, E",         0, ld_d_e },
-    { "LD D, H",         0, ld_d_h },
-    { "LD D, L",         0, ld_d_l },
-    { "LD D, (HL)",      0, ld_d_hl },
-    { "LD D, A",         0, ld_d_a },
-    { "LD E, B",         0, ld_e_b },
-    { "LD E, C",         0, ld_e_c },
-    { "LD E, D",         0, ld_e_d },
-    { "LD E, E",         0, ld_e_e },
-    { "LD E, H",         0, ld_e_h },
-    { "LD E, L",         0, ld_e_l },
-    { "LD E, (HL)",      0, ld_e_hl },
-    { "LD E, A",         0, ld_e_a },
+    { "LD D, B",         0, 1, 1, ld_d_b },
+    { "LD D, C",         0, 1, 1, ld_d_c },
+    { "LD D, D",         0, 1, 1, ld_d_d },
+    { "LD D, E",         0, 1, 1, ld_d_e },
+    { "LD D, H",         0, 1, 1, ld_d_h },
+    { "LD D, L",         0, 1, 1, ld_d_l },
+    { "LD D, (HL)",      0, 2, 2, ld_d_hl },
+    { "LD D, A",         0, 1, 1, ld_d_a },
+    { "LD E, B",         0, 1, 1, ld_e_b },
+    { "LD E, C",         0, 1, 1, ld_e_c },
+    { "LD E, D",         0, 1, 1, ld_e_d },
+    { "LD E, E",         0, 1, 1, ld_e_e },
+    { "LD E, H",         0, 1, 1, ld_e_h },
+    { "LD E, L",         0, 1, 1, ld_e_l },
+    { "LD E, (HL)",      0, 2, 2, ld_e_hl },
+    { "LD E, A",         0, 1, 1, ld_e_a },
 
     // 0x60
-    { "LD H, B",         0, ld_h_b },
-    { "LD H, C",         0, ld_h_c },
-    { "LD H, D",         0, ld_h_d },
-    { "LD H, E",         0, ld_h_e },
-    { "LD H, H",         0, ld_h_h },
-    { "LD H, L",         0, ld_h_l },
-    { "LD H, (HL)",      0, ld_h_hl },
-    { "LD H, A",         0, ld_h_a },
-    { "LD L, B",         0, ld_l_b },
-    { "LD L, C",         0, ld_l_c },
-    { "LD L, D",         0, ld_l_d },
-    { "LD L, E",         0, ld_l_e },
-    { "LD L, H",         0, ld_l_h },
-    { "LD L, L",         0, ld_l_l },
-    { "LD L, (HL)",      0, ld_l_hl },
-    { "LD L, A",         0, ld_l_a },
+    { "LD H, B",         0, 1, 1, ld_h_b },
+    { "LD H, C",         0, 1, 1, ld_h_c },
+    { "LD H, D",         0, 1, 1, ld_h_d },
+    { "LD H, E",         0, 1, 1, ld_h_e },
+    { "LD H, H",         0, 1, 1, ld_h_h },
+    { "LD H, L",         0, 1, 1, ld_h_l },
+    { "LD H, (HL)",      0, 2, 2, ld_h_hl },
+    { "LD H, A",         0, 1, 1, ld_h_a },
+    { "LD L, B",         0, 1, 1, ld_l_b },
+    { "LD L, C",         0, 1, 1, ld_l_c },
+    { "LD L, D",         0, 1, 1, ld_l_d },
+    { "LD L, E",         0, 1, 1, ld_l_e },
+    { "LD L, H",         0, 1, 1, ld_l_h },
+    { "LD L, L",         0, 1, 1, ld_l_l },
+    { "LD L, (HL)",      0, 2, 2, ld_l_hl },
+    { "LD L, A",         0, 1, 1, ld_l_a },
 
     // 0x70
-    { "LD (HL), B",      0, ld_hl_b },
-    { "LD (HL), C",      0, ld_hl_c },
-    { "LD (HL), D",      0, ld_hl_d },
-    { "LD (HL), E",      0, ld_hl_e },
-    { "LD (HL), H",      0, ld_hl_h },
-    { "LD (HL), L",      0, ld_hl_l },
-    { "HALT",            0, halt },
-    { "LD (HL), A",      0, ld_hl_a },
-    { "LD A, B",         0, ld_a_b },
-    { "LD A, C",         0, ld_a_c },
-    { "LD A, D",         0, ld_a_d },
-    { "LD A, E",         0, ld_a_e },
-    { "LD A, H",         0, ld_a_h },
-    { "LD A, L",         0, ld_a_l },
-    { "LD A, (HL)",      0, ld_a_hl },
-    { "LD A, A",         0, ld_a_a },
+    { "LD (HL), B",      0, 2, 2, ld_hl_b },
+    { "LD (HL), C",      0, 2, 2, ld_hl_c },
+    { "LD (HL), D",      0, 2, 2, ld_hl_d },
+    { "LD (HL), E",      0, 2, 2, ld_hl_e },
+    { "LD (HL), H",      0, 2, 2, ld_hl_h },
+    { "LD (HL), L",      0, 2, 2, ld_hl_l },
+    { "HALT",            0, 1, 1, halt },
+    { "LD (HL), A",      0, 2, 2, ld_hl_a },
+    { "LD A, B",         0, 1, 1, ld_a_b },
+    { "LD A, C",         0, 1, 1, ld_a_c },
+    { "LD A, D",         0, 1, 1, ld_a_d },
+    { "LD A, E",         0, 1, 1, ld_a_e },
+    { "LD A, H",         0, 1, 1, ld_a_h },
+    { "LD A, L",         0, 1, 1, ld_a_l },
+    { "LD A, (HL)",      0, 2, 2, ld_a_hl },
+    { "LD A, A",         0, 1, 1, ld_a_a },
 
     // 0x80
-    { "ADD A, B",        0, add_b },
-    { "ADD A, C",        0, add_c },
-    { "ADD A, D",        0, add_d },
-    { "ADD A, E",        0, add_e },
-    { "ADD A, H",        0, add_h },
-    { "ADD A, L",        0, add_l },
-    { "ADD A, (HL)",     0, add_hl },
-    { "ADD A, A",        0, add_a },
-    { "ADC A, B",        0, adc_b },
-    { "ADC A, C",        0, adc_c },
-    { "ADC A, D",        0, adc_d },
-    { "ADC A, E",        0, adc_e },
-    { "ADC A, H",        0, adc_h },
-    { "ADC A, L",        0, adc_l },
-    { "ADC A, (HL)",     0, adc_hl },
-    { "ADC A, A",        0, adc_a },
+    { "ADD A, B",        0, 1, 1, add_b },
+    { "ADD A, C",        0, 1, 1, add_c },
+    { "ADD A, D",        0, 1, 1, add_d },
+    { "ADD A, E",        0, 1, 1, add_e },
+    { "ADD A, H",        0, 1, 1, add_h },
+    { "ADD A, L",        0, 1, 1, add_l },
+    { "ADD A, (HL)",     0, 2, 2, add_hl },
+    { "ADD A, A",        0, 1, 1, add_a },
+    { "ADC A, B",        0, 1, 1, adc_b },
+    { "ADC A, C",        0, 1, 1, adc_c },
+    { "ADC A, D",        0, 1, 1, adc_d },
+    { "ADC A, E",        0, 1, 1, adc_e },
+    { "ADC A, H",        0, 1, 1, adc_h },
+    { "ADC A, L",        0, 1, 1, adc_l },
+    { "ADC A, (HL)",     0, 2, 2, adc_hl },
+    { "ADC A, A",        0, 1, 1, adc_a },
 
     // 0x90
-    { "SUB B",           0, sub_b },
-    { "SUB C",           0, sub_c },
-    { "SUB D",           0, sub_d },
-    { "SUB E",           0, sub_e },
-    { "SUB H",           0, sub_h },
-    { "SUB L",           0, sub_l },
-    { "SUB (HL)",        0, sub_hl },
-    { "SUB A",           0, sub_a },
-    { "SBC A, B",        0, sbc_b },
-    { "SBC A, C",        0, sbc_c },
-    { "SBC A, D",        0, sbc_d },
-    { "SBC A, E",        0, sbc_e },
-    { "SBC A, H",        0, sbc_h },
-    { "SBC A, L",        0, sbc_l },
-    { "SBC A, (HL)",     0, sbc_hl },
-    { "SBC A, A",        0, sbc_a },
+    { "SUB B",           0, 1, 1, sub_b },
+    { "SUB C",           0, 1, 1, sub_c },
+    { "SUB D",           0, 1, 1, sub_d },
+    { "SUB E",           0, 1, 1, sub_e },
+    { "SUB H",           0, 1, 1, sub_h },
+    { "SUB L",           0, 1, 1, sub_l },
+    { "SUB (HL)",        0, 2, 2, sub_hl },
+    { "SUB A",           0, 1, 1, sub_a },
+    { "SBC A, B",        0, 1, 1, sbc_b },
+    { "SBC A, C",        0, 1, 1, sbc_c },
+    { "SBC A, D",        0, 1, 1, sbc_d },
+    { "SBC A, E",        0, 1, 1, sbc_e },
+    { "SBC A, H",        0, 1, 1, sbc_h },
+    { "SBC A, L",        0, 1, 1, sbc_l },
+    { "SBC A, (HL)",     0, 2, 2, sbc_hl },
+    { "SBC A, A",        0, 1, 1, sbc_a },
 
     // 0xa0
-    { "AND B",           0, and_b },
-    { "AND C",           0, and_c },
-    { "AND D",           0, and_d },
-    { "AND E",           0, and_e },
-    { "AND H",           0, and_h },
-    { "AND L",           0, and_l },
-    { "AND (HL)",        0, and_hl },
-    { "AND A",           0, and_a },
-    { "XOR B",           0, xor_b },
-    { "XOR C",           0, xor_c },
-    { "XOR D",           0, xor_d },
-    { "XOR E",           0, xor_e },
-    { "XOR H",           0, xor_h },
-    { "XOR L",           0, xor_l },
-    { "XOR (HL)",        0, xor_hl },
-    { "XOR A",           0, xor_a },
+    { "AND B",           0, 1, 1, and_b },
+    { "AND C",           0, 1, 1, and_c },
+    { "AND D",           0, 1, 1, and_d },
+    { "AND E",           0, 1, 1, and_e },
+    { "AND H",           0, 1, 1, and_h },
+    { "AND L",           0, 1, 1, and_l },
+    { "AND (HL)",        0, 2, 2, and_hl },
+    { "AND A",           0, 1, 1, and_a },
+    { "XOR B",           0, 1, 1, xor_b },
+    { "XOR C",           0, 1, 1, xor_c },
+    { "XOR D",           0, 1, 1, xor_d },
+    { "XOR E",           0, 1, 1, xor_e },
+    { "XOR H",           0, 1, 1, xor_h },
+    { "XOR L",           0, 1, 1, xor_l },
+    { "XOR (HL)",        0, 2, 2, xor_hl },
+    { "XOR A",           0, 1, 1, xor_a },
 
     // 0xb0
-    { "OR B",            0, or_b },
-    { "OR C",            0, or_c },
-    { "OR D",            0, or_d },
-    { "OR E",            0, or_e },
-    { "OR H",            0, or_h },
-    { "OR L",            0, or_l },
-    { "OR (HL)",         0, or_hl },
-    { "OR A",            0, or_a },
-    { "CP B",            0, cp_b },
-    { "CP C",            0, cp_c },
-    { "CP D",            0, cp_d },
-    { "CP E",            0, cp_e },
-    { "CP H",            0, cp_h },
-    { "CP L",            0, cp_l },
-    { "CP (HL)",         0, cp_mem_hl },
-    { "CP A",            0, cp_a },
+    { "OR B",            0, 1, 1, or_b },
+    { "OR C",            0, 1, 1, or_c },
+    { "OR D",            0, 1, 1, or_d },
+    { "OR E",            0, 1, 1, or_e },
+    { "OR H",            0, 1, 1, or_h },
+    { "OR L",            0, 1, 1, or_l },
+    { "OR (HL)",         0, 2, 2, or_hl },
+    { "OR A",            0, 1, 1, or_a },
+    { "CP B",            0, 1, 1, cp_b },
+    { "CP C",            0, 1, 1, cp_c },
+    { "CP D",            0, 1, 1, cp_d },
+    { "CP E",            0, 1, 1, cp_e },
+    { "CP H",            0, 1, 1, cp_h },
+    { "CP L",            0, 1, 1, cp_l },
+    { "CP (HL)",         0, 2, 2, cp_mem_hl },
+    { "CP A",            0, 1, 1, cp_a },
 
     // 0xc0
-    { "RET NZ",          0, ret_nz },
-    { "POP BC",          0, pop_bc },
-    { "JP NZ, 0x%04x",   2, jp_nz_a16 },
-    { "JP 0x%04x",       2, jp_a16 },
-    { "CALL NZ, 0x%04x", 2, call_nz_a16 },
-    { "PUSH BC",         0, push_bc },
-    { "ADD A, 0x%02x",   1, add_d8 },
-    { "RST 0x00",        0, rst00 },
-    { "RET Z",           0, ret_z },
-    { "RET",             0, ret },
-    { "JP Z, 0x%04x",    2, jp_z_a16 },
-    { "<prefix cb>",     0, NULL },
-    { "CALL Z, 0x%04x",  2, call_z_a16 },
-    { "CALL 0x%04x",     2, call_a16 },
-    { "ADC A, 0x%02x",   1, adc_d8 },
-    { "RST 0x08",        0, rst08 },
+    { "RET NZ",          0, 2, 5, ret_nz },
+    { "POP BC",          0, 3, 3, pop_bc },
+    { "JP NZ, 0x%04x",   2, 3, 4, jp_nz_a16 },
+    { "JP 0x%04x",       2, 4, 4, jp_a16 },
+    { "CALL NZ, 0x%04x", 2, 3, 6, call_nz_a16 },
+    { "PUSH BC",         0, 4, 4, push_bc },
+    { "ADD A, 0x%02x",   1, 2, 2, add_d8 },
+    { "RST 0x00",        0, 4, 4, rst00 },
+    { "RET Z",           0, 2, 5, ret_z },
+    { "RET",             0, 4, 4, ret },
+    { "JP Z, 0x%04x",    2, 3, 4, jp_z_a16 },
+    { "<prefix cb>",     0, 1, 1, NULL },
+    { "CALL Z, 0x%04x",  2, 3, 6, call_z_a16 },
+    { "CALL 0x%04x",     2, 6, 6, call_a16 },
+    { "ADC A, 0x%02x",   1, 2, 2, adc_d8 },
+    { "RST 0x08",        0, 4, 4, rst08 },
 
     // 0xd0
-    { "RET NC",          0, ret_nc },
-    { "POP DE",          0, pop_de },
-    { "JP NC, 0x%04x",   2, jp_nc_a16 },
-    { "<undocumented>",  0, NULL },
-    { "CALL NC, 0x%04x", 2, call_nc_a16 },
-    { "PUSH DE",         0, push_de },
-    { "SUB 0x%02x",      1, sub_d8 },
-    { "RST 0x10",        0, rst10 },
-    { "RET C",           0, ret_c },
-    { "RETI",            0, reti },
-    { "JP C, 0x%04x",    2, jp_c_a16 },
-    { "<undocumented>",  0, NULL },
-    { "CALL C, 0x%04x",  2, call_c_a16 },
-    { "<undocumented>",  0, NULL },
-    { "SBC A, 0x%02x",   1, sbc_d8 },
-    { "RST 0x18",        0, rst18 },
+    { "RET NC",          0, 2, 5, ret_nc },
+    { "POP DE",          0, 3, 3, pop_de },
+    { "JP NC, 0x%04x",   2, 3, 4, jp_nc_a16 },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "CALL NC, 0x%04x", 2, 3, 6, call_nc_a16 },
+    { "PUSH DE",         0, 4, 4, push_de },
+    { "SUB 0x%02x",      1, 2, 2, sub_d8 },
+    { "RST 0x10",        0, 4, 4, rst10 },
+    { "RET C",           0, 2, 5, ret_c },
+    { "RETI",            0, 4, 4, reti },
+    { "JP C, 0x%04x",    2, 3, 4, jp_c_a16 },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "CALL C, 0x%04x",  2, 3, 6, call_c_a16 },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "SBC A, 0x%02x",   1, 2, 2, sbc_d8 },
+    { "RST 0x18",        0, 4, 4, rst18 },
 
     // 0xe0
-    { "LDH (0x%02x), A", 1, ldh_a8_a },
-    { "POP HL",          0, pop_hl },
-    { "LD (C), A",       0, ld_mem_c_a },
-    { "<undocumented>",  0, NULL },
-    { "<undocumented>",  0, NULL },
-    { "PUSH HL",         0, push_hl },
-    { "AND 0x%02x",      1, and_d8 },
-    { "RST 0x20",        0, rst20 },
-    { "ADD SP, %hhd",    1, add_sp_r },
-    { "JP (HL)",         0, jp_hl },
-    { "LD (0x%04x), A",  2, ld_mem_a16_a },
-    { "<undocumented>",  0, NULL },
-    { "<undocumented>",  0, NULL },
-    { "<undocumented>",  0, NULL },
-    { "XOR A, 0x%02x",   1, xor_d8 },
-    { "RST 0x28",        0, rst28 },
+    { "LDH (0x%02x), A", 1, 3, 3, ldh_a8_a },
+    { "POP HL",          0, 3, 3, pop_hl },
+    { "LD (C), A",       0, 2, 2, ld_mem_c_a },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "PUSH HL",         0, 4, 4, push_hl },
+    { "AND 0x%02x",      1, 2, 2, and_d8 },
+    { "RST 0x20",        0, 4, 4, rst20 },
+    { "ADD SP, %hhd",    1, 4, 4, add_sp_r },
+    { "JP (HL)",         0, 1, 1, jp_hl },
+    { "LD (0x%04x), A",  2, 4, 4, ld_mem_a16_a },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "XOR A, 0x%02x",   1, 2, 2, xor_d8 },
+    { "RST 0x28",        0, 4, 4, rst28 },
 
     // 0xf0
-    { "LDH A, (0x%02x)", 1, ldh_a_a8 },
-    { "POP AF",          0, pop_af },
-    { "LD A, (C)",       0, ld_a_mem_c },
-    { "DI",              0, di },
-    { "<undocumented>",  0, NULL },
-    { "PUSH AF",         0, push_af },
-    { "OR 0x%02x",       1, or_d8 },
-    { "RST 0x30",        0, rst30 },
-    { "LD HL, SP%+d",    1, ld_hl_sp_plus_r },
-    { "LD SP, HL",       0, ld_sp_hl },
-    { "LD A, (0x%04x)",  2, ld_a_mem_a16 },
-    { "EI",              0, ei },
-    { "<undocumented>",  0, NULL },
-    { "<undocumented>",  0, NULL },
-    { "CP A, 0x%02x",    1, cp_d8 },
-    { "RST 0x38",        0, rst38 },
+    { "LDH A, (0x%02x)", 1, 3, 3, ldh_a_a8 },
+    { "POP AF",          0, 3, 3, pop_af },
+    { "LD A, (C)",       0, 2, 2, ld_a_mem_c },
+    { "DI",              0, 1, 1, di },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "PUSH AF",         0, 4, 4, push_af },
+    { "OR 0x%02x",       1, 2, 2, or_d8 },
+    { "RST 0x30",        0, 4, 4, rst30 },
+    { "LD HL, SP%+d",    1, 3, 3, ld_hl_sp_plus_r },
+    { "LD SP, HL",       0, 2, 2, ld_sp_hl },
+    { "LD A, (0x%04x)",  2, 4, 4, ld_a_mem_a16 },
+    { "EI",              0, 1, 1, ei },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "<undocumented>",  0, 1, 1, NULL },
+    { "CP A, 0x%02x",    1, 2, 2, cp_d8 },
+    { "RST 0x38",        0, 4, 4, rst38 },
 };
 
 
+// Cycle counts here include the 0xcb prefix.
 const struct Instruction cbInstructions[256] = {
     // 0x00
-    { "RLC B",      0, rlc_b },
-    { "RLC C",      0, rlc_c },
-    { "RLC D",      0, rlc_d },
-    { "RLC E",      0, rlc_e },
-    { "RLC H",      0, rlc_h },
-    { "RLC L",      0, rlc_l },
-    { "RLC (HL)",   0, rlc_mem_hl },
-    { "RLC A",      0, rlc_a },
-    { "RRC B",      0, rrc_b },
-    { "RRC C",      0, rrc_c },
-    { "RRC D",      0, rrc_d },
-    { "RRC E",      0, rrc_e },
-    { "RRC H",      0, rrc_h },
-    { "RRC L",      0, rrc_l },
-    { "RRC (HL)",   0, rrc_mem_hl },
-    { "RRC A",      0, rrc_a },
+    { "RLC B",      0, 2, 2, rlc_b },
+    { "RLC C",      0, 2, 2, rlc_c },
+    { "RLC D",      0, 2, 2, rlc_d },
+    { "RLC E",      0, 2, 2, rlc_e },
+    { "RLC H",      0, 2, 2, rlc_h },
+    { "RLC L",      0, 2, 2, rlc_l },
+    { "RLC (HL)",   0, 4, 4, rlc_mem_hl },
+    { "RLC A",      0, 2, 2, rlc_a },
+    { "RRC B",      0, 2, 2, rrc_b },
+    { "RRC C",      0, 2, 2, rrc_c },
+    { "RRC D",      0, 2, 2, rrc_d },
+    { "RRC E",      0, 2, 2, rrc_e },
+    { "RRC H",      0, 2, 2, rrc_h },
+    { "RRC L",      0, 2, 2, rrc_l },
+    { "RRC (HL)",   0, 4, 4, rrc_mem_hl },
+    { "RRC A",      0, 2, 2, rrc_a },
 
     // 0x10
-    { "RL B",       0, rl_b },
-    { "RL C",       0, rl_c },
-    { "RL D",       0, rl_d },
-    { "RL E",       0, rl_e },
-    { "RL H",       0, rl_h },
-    { "RL L",       0, rl_l },
-    { "RL (HL)",    0, rl_mem_hl },
-    { "RL A",       0, rl_a },
-    { "RR B",       0, rr_b },
-    { "RR C",       0, rr_c },
-    { "RR D",       0, rr_d },
-    { "RR E",       0, rr_e },
-    { "RR H",       0, rr_h },
-    { "RR L",       0, rr_l },
-    { "RR (HL)",    0, rr_mem_hl },
-    { "RR A",       0, rr_a },
+    { "RL B",       0, 2, 2, rl_b },
+    { "RL C",       0, 2, 2, rl_c },
+    { "RL D",       0, 2, 2, rl_d },
+    { "RL E",       0, 2, 2, rl_e },
+    { "RL H",       0, 2, 2, rl_h },
+    { "RL L",       0, 2, 2, rl_l },
+    { "RL (HL)",    0, 4, 4, rl_mem_hl },
+    { "RL A",       0, 2, 2, rl_a },
+    { "RR B",       0, 2, 2, rr_b },
+    { "RR C",       0, 2, 2, rr_c },
+    { "RR D",       0, 2, 2, rr_d },
+    { "RR E",       0, 2, 2, rr_e },
+    { "RR H",       0, 2, 2, rr_h },
+    { "RR L",       0, 2, 2, rr_l },
+    { "RR (HL)",    0, 4, 4, rr_mem_hl },
+    { "RR A",       0, 2, 2, rr_a },
 
     // 0x20
-    { "SLA B",      0, sla_b },
-    { "SLA C",      0, sla_c },
-    { "SLA D",      0, sla_d },
-    { "SLA E",      0, sla_e },
-    { "SLA H",      0, sla_h },
-    { "SLA L",      0, sla_l },
-    { "SLA (HL)",   0, sla_mem_hl },
-    { "SLA A",      0, sla_a },
-    { "SRA B",      0, sra_b },
-    { "SRA C",      0, sra_c },
-    { "SRA D",      0, sra_d },
-    { "SRA E",      0, sra_e },
-    { "SRA H",      0, sra_h },
-    { "SRA L",      0, sra_l },
-    { "SRA (HL)",   0, sra_mem_hl },
-    { "SRA A",      0, sra_a },
+    { "SLA B",      0, 2, 2, sla_b },
+    { "SLA C",      0, 2, 2, sla_c },
+    { "SLA D",      0, 2, 2, sla_d },
+    { "SLA E",      0, 2, 2, sla_e },
+    { "SLA H",      0, 2, 2, sla_h },
+    { "SLA L",      0, 2, 2, sla_l },
+    { "SLA (HL)",   0, 4, 4, sla_mem_hl },
+    { "SLA A",      0, 2, 2, sla_a },
+    { "SRA B",      0, 2, 2, sra_b },
+    { "SRA C",      0, 2, 2, sra_c },
+    { "SRA D",      0, 2, 2, sra_d },
+    { "SRA E",      0, 2, 2, sra_e },
+    { "SRA H",      0, 2, 2, sra_h },
+    { "SRA L",      0, 2, 2, sra_l },
+    { "SRA (HL)",   0, 4, 4, sra_mem_hl },
+    { "SRA A",      0, 2, 2, sra_a },
 
     // 0x30
-    { "SWAP B",     0, swap_b },
-    { "SWAP C",     0, swap_c },
-    { "SWAP D",     0, swap_d },
-    { "SWAP E",     0, swap_e },
-    { "SWAP H",     0, swap_h },
-    { "SWAP L",     0, swap_l },
-    { "SWAP (HL)",  0, swap_hl },
-    { "SWAP A",     0, swap_a },
-    { "SRL B",      0, srl_b },
-    { "SRL C",      0, srl_c },
-    { "SRL D",      0, srl_d },
-    { "SRL E",      0, srl_e },
-    { "SRL H",      0, srl_h },
-    { "SRL L",      0, srl_l },
-    { "SRL (HL)",   0, srl_mem_hl },
-    { "SRL A",      0, srl_a },
+    { "SWAP B",     0, 2, 2, swap_b },
+    { "SWAP C",     0, 2, 2, swap_c },
+    { "SWAP D",     0, 2, 2, swap_d },
+    { "SWAP E",     0, 2, 2, swap_e },
+    { "SWAP H",     0, 2, 2, swap_h },
+    { "SWAP L",     0, 2, 2, swap_l },
+    { "SWAP (HL)",  0, 4, 4, swap_hl },
+    { "SWAP A",     0, 2, 2, swap_a },
+    { "SRL B",      0, 2, 2, srl_b },
+    { "SRL C",      0, 2, 2, srl_c },
+    { "SRL D",      0, 2, 2, srl_d },
+    { "SRL E",      0, 2, 2, srl_e },
+    { "SRL H",      0, 2, 2, srl_h },
+    { "SRL L",      0, 2, 2, srl_l },
+    { "SRL (HL)",   0, 4, 4, srl_mem_hl },
+    { "SRL A",      0, 2, 2, srl_a },
 
     // 0x40
-    { "BIT 0 B",      0, bit_0_b },
-    { "BIT 0 C",      0, bit_0_c },
-    { "BIT 0 D",      0, bit_0_d },
-    { "BIT 0 E",      0, bit_0_e },
-    { "BIT 0 H",      0, bit_0_h },
-    { "BIT 0 L",      0, bit_0_l },
-    { "BIT 0 (HL)",   0, bit_0_mem_hl },
-    { "BIT 0 A",      0, bit_0_a },
-    { "BIT 1 B",      0, bit_1_b },
-    { "BIT 1 C",      0, bit_1_c },
-    { "BIT 1 D",      0, bit_1_d },
-    { "BIT 1 E",      0, bit_1_e },
-    { "BIT 1 H",      0, bit_1_h },
-    { "BIT 1 L",      0, bit_1_l },
-    { "BIT 1 (HL)",   0, bit_1_mem_hl },
-    { "BIT 1 A",      0, bit_1_a },
+    { "BIT 0 B",      0, 2, 2, bit_0_b },
+    { "BIT 0 C",      0, 2, 2, bit_0_c },
+    { "BIT 0 D",      0, 2, 2, bit_0_d },
+    { "BIT 0 E",      0, 2, 2, bit_0_e },
+    { "BIT 0 H",      0, 2, 2, bit_0_h },
+    { "BIT 0 L",      0, 2, 2, bit_0_l },
+    { "BIT 0 (HL)",   0, 3, 3, bit_0_mem_hl },
+    { "BIT 0 A",      0, 2, 2, bit_0_a },
+    { "BIT 1 B",      0, 2, 2, bit_1_b },
+    { "BIT 1 C",      0, 2, 2, bit_1_c },
+    { "BIT 1 D",      0, 2, 2, bit_1_d },
+    { "BIT 1 E",      0, 2, 2, bit_1_e },
+    { "BIT 1 H",      0, 2, 2, bit_1_h },
+    { "BIT 1 L",      0, 2, 2, bit_1_l },
+    { "BIT 1 (HL)",   0, 3, 3, bit_1_mem_hl },
+    { "BIT 1 A",      0, 2, 2, bit_1_a },
 
     // 0x50
-    { "BIT 2 B",      0, bit_2_b },
-    { "BIT 2 C",      0, bit_2_c },
-    { "BIT 2 D",      0, bit_2_d },
-    { "BIT 2 E",      0, bit_2_e },
-    { "BIT 2 H",      0, bit_2_h },
-    { "BIT 2 L",      0, bit_2_l },
-    { "BIT 2 (HL)",   0, bit_2_mem_hl },
-    { "BIT 2 A",      0, bit_2_a },
-    { "BIT 3 B",      0, bit_3_b },
-    { "BIT 3 C",      0, bit_3_c },
-    { "BIT 3 D",      0, bit_3_d },
-    { "BIT 3 E",      0, bit_3_e },
-    { "BIT 3 H",      0, bit_3_h },
-    { "BIT 3 L",      0, bit_3_l },
-    { "BIT 3 (HL)",   0, bit_3_mem_hl },
-    { "BIT 3 A",      0, bit_3_a },
+    { "BIT 2 B",      0, 2, 2, bit_2_b },
+    { "BIT 2 C",      0, 2, 2, bit_2_c },
+    { "BIT 2 D",      0, 2, 2, bit_2_d },
+    { "BIT 2 E",      0, 2, 2, bit_2_e },
+    { "BIT 2 H",      0, 2, 2, bit_2_h },
+    { "BIT 2 L",      0, 2, 2, bit_2_l },
+    { "BIT 2 (HL)",   0, 3, 3, bit_2_mem_hl },
+    { "BIT 2 A",      0, 2, 2, bit_2_a },
+    { "BIT 3 B",      0, 2, 2, bit_3_b },
+    { "BIT 3 C",      0, 2, 2, bit_3_c },
+    { "BIT 3 D",      0, 2, 2, bit_3_d },
+    { "BIT 3 E",      0, 2, 2, bit_3_e },
+    { "BIT 3 H",      0, 2, 2, bit_3_h },
+    { "BIT 3 L",      0, 2, 2, bit_3_l },
+    { "BIT 3 (HL)",   0, 3, 3, bit_3_mem_hl },
+    { "BIT 3 A",      0, 2, 2, bit_3_a },
 
     // 0x60
-    { "BIT 4 B",      0, bit_4_b },
-    { "BIT 4 C",      0, bit_4_c },
-    { "BIT 4 D",      0, bit_4_d },
-    { "BIT 4 E",      0, bit_4_e },
-    { "BIT 4 H",      0, bit_4_h },
-    { "BIT 4 L",      0, bit_4_l },
-    { "BIT 4 (HL)",   0, bit_4_mem_hl },
-    { "BIT 4 A",      0, bit_4_a },
-    { "BIT 5 B",      0, bit_5_b },
-    { "BIT 5 C",      0, bit_5_c },
-    { "BIT 5 D",      0, bit_5_d },
-    { "BIT 5 E",      0, bit_5_e },
-    { "BIT 5 H",      0, bit_5_h },
-    { "BIT 5 L",      0, bit_5_l },
-    { "BIT 5 (HL)",   0, bit_5_mem_hl },
-    { "BIT 5 A",      0, bit_5_a },
+    { "BIT 4 B",      0, 2, 2, bit_4_b },
+    { "BIT 4 C",      0, 2, 2, bit_4_c },
+    { "BIT 4 D",      0, 2, 2, bit_4_d },
+    { "BIT 4 E",      0, 2, 2, bit_4_e },
+    { "BIT 4 H",      0, 2, 2, bit_4_h },
+    { "BIT 4 L",      0, 2, 2, bit_4_l },
+    { "BIT 4 (HL)",   0, 3, 3, bit_4_mem_hl },
+    { "BIT 4 A",      0, 2, 2, bit_4_a },
+    { "BIT 5 B",      0, 2, 2, bit_5_b },
+    { "BIT 5 C",      0, 2, 2, bit_5_c },
+    { "BIT 5 D",      0, 2, 2, bit_5_d },
+    { "BIT 5 E",      0, 2, 2, bit_5_e },
+    { "BIT 5 H",      0, 2, 2, bit_5_h },
+    { "BIT 5 L",      0, 2, 2, bit_5_l },
+    { "BIT 5 (HL)",   0, 3, 3, bit_5_mem_hl },
+    { "BIT 5 A",      0, 2, 2, bit_5_a },
 
     // 0x70
-    { "BIT 6 B",      0, bit_6_b },
-    { "BIT 6 C",      0, bit_6_c },
-    { "BIT 6 D",      0, bit_6_d },
-    { "BIT 6 E",      0, bit_6_e },
-    { "BIT 6 H",      0, bit_6_h },
-    { "BIT 6 L",      0, bit_6_l },
-    { "BIT 6 (HL)",   0, bit_6_mem_hl },
-    { "BIT 6 A",      0, bit_6_a },
-    { "BIT 7 B",      0, bit_7_b },
-    { "BIT 7 C",      0, bit_7_c },
-    { "BIT 7 D",      0, bit_7_d },
-    { "BIT 7 E",      0, bit_7_e },
-    { "BIT 7 H",      0, bit_7_h },
-    { "BIT 7 L",      0, bit_7_l },
-    { "BIT 7 (HL)",   0, bit_7_mem_hl },
-    { "BIT 7 A",      0, bit_7_a },
+    { "BIT 6 B",      0, 2, 2, bit_6_b },
+    { "BIT 6 C",      0, 2, 2, bit_6_c },
+    { "BIT 6 D",      0, 2, 2, bit_6_d },
+    { "BIT 6 E",      0, 2, 2, bit_6_e },
+    { "BIT 6 H",      0, 2, 2, bit_6_h },
+    { "BIT 6 L",      0, 2, 2, bit_6_l },
+    { "BIT 6 (HL)",   0, 3, 3, bit_6_mem_hl },
+    { "BIT 6 A",      0, 2, 2, bit_6_a },
+    { "BIT 7 B",      0, 2, 2, bit_7_b },
+    { "BIT 7 C",      0, 2, 2, bit_7_c },
+    { "BIT 7 D",      0, 2, 2, bit_7_d },
+    { "BIT 7 E",      0, 2, 2, bit_7_e },
+    { "BIT 7 H",      0, 2, 2, bit_7_h },
+    { "BIT 7 L",      0, 2, 2, bit_7_l },
+    { "BIT 7 (HL)",   0, 3, 3, bit_7_mem_hl },
+    { "BIT 7 A",      0, 2, 2, bit_7_a },
 
     // 0x80
-    { "RES 0 B",      0, res_0_b },
-    { "RES 0 C",      0, res_0_c },
-    { "RES 0 D",      0, res_0_d },
-    { "RES 0 E",      0, res_0_e },
-    { "RES 0 H",      0, res_0_h },
-    { "RES 0 L",      0, res_0_l },
-    { "RES 0 (HL)",   0, res_0_hl },
-    { "RES 0 A",      0, res_0_a },
-    { "RES 1 B",      0, res_1_b },
-    { "RES 1 C",      0, res_1_c },
-    { "RES 1 D",      0, res_1_d },
-    { "RES 1 E",      0, res_1_e },
-    { "RES 1 H",      0, res_1_h },
-    { "RES 1 L",      0, res_1_l },
-    { "RES 1 (HL)",   0, res_1_hl },
-    { "RES 1 A",      0, res_1_a },
+    { "RES 0 B",      0, 2, 2, res_0_b },
+    { "RES 0 C",      0, 2, 2, res_0_c },
+    { "RES 0 D",      0, 2, 2, res_0_d },
+    { "RES 0 E",      0, 2, 2, res_0_e },
+    { "RES 0 H",      0, 2, 2, res_0_h },
+    { "RES 0 L",      0, 2, 2, res_0_l },
+    { "RES 0 (HL)",   0, 4, 4, res_0_hl },
+    { "RES 0 A",      0, 2, 2, res_0_a },
+    { "RES 1 B",      0, 2, 2, res_1_b },
+    { "RES 1 C",      0, 2, 2, res_1_c },
+    { "RES 1 D",      0, 2, 2, res_1_d },
+    { "RES 1 E",      0, 2, 2, res_1_e },
+    { "RES 1 H",      0, 2, 2, res_1_h },
+    { "RES 1 L",      0, 2, 2, res_1_l },
+    { "RES 1 (HL)",   0, 4, 4, res_1_hl },
+    { "RES 1 A",      0, 2, 2, res_1_a },
 
     // 0x90
-    { "RES 2 B",      0, res_2_b },
-    { "RES 2 C",      0, res_2_c },
-    { "RES 2 D",      0, res_2_d },
-    { "RES 2 E",      0, res_2_e },
-    { "RES 2 H",      0, res_2_h },
-    { "RES 2 L",      0, res_2_l },
-    { "RES 2 (HL)",   0, res_2_hl },
-    { "RES 2 A",      0, res_2_a },
-    { "RES 3 B",      0, res_3_b },
-    { "RES 3 C",      0, res_3_c },
-    { "RES 3 D",      0, res_3_d },
-    { "RES 3 E",      0, res_3_e },
-    { "RES 3 H",      0, res_3_h },
-    { "RES 3 L",      0, res_3_l },
-    { "RES 3 (HL)",   0, res_3_hl },
-    { "RES 3 A",      0, res_3_a },
+    { "RES 2 B",      0, 2, 2, res_2_b },
+    { "RES 2 C",      0, 2, 2, res_2_c },
+    { "RES 2 D",      0, 2, 2, res_2_d },
+    { "RES 2 E",      0, 2, 2, res_2_e },
+    { "RES 2 H",      0, 2, 2, res_2_h },
+    { "RES 2 L",      0, 2, 2, res_2_l },
+    { "RES 2 (HL)",   0, 4, 4, res_2_hl },
+    { "RES 2 A",      0, 2, 2, res_2_a },
+    { "RES 3 B",      0, 2, 2, res_3_b },
+    { "RES 3 C",      0, 2, 2, res_3_c },
+    { "RES 3 D",      0, 2, 2, res_3_d },
+    { "RES 3 E",      0, 2, 2, res_3_e },
+    { "RES 3 H",      0, 2, 2, res_3_h },
+    { "RES 3 L",      0, 2, 2, res_3_l },
+    { "RES 3 (HL)",   0, 4, 4, res_3_hl },
+    { "RES 3 A",      0, 2, 2, res_3_a },
 
     // 0xa0
-    { "RES 4 B",      0, res_4_b },
-    { "RES 4 C",      0, res_4_c },
-    { "RES 4 D",      0, res_4_d },
-    { "RES 4 E",      0, res_4_e },
-    { "RES 4 H",      0, res_4_h },
-    { "RES 4 L",      0, res_4_l },
-    { "RES 4 (HL)",   0, res_4_hl },
-    { "RES 4 A",      0, res_4_a },
-    { "RES 5 B",      0, res_5_b },
-    { "RES 5 C",      0, res_5_c },
-    { "RES 5 D",      0, res_5_d },
-    { "RES 5 E",      0, res_5_e },
-    { "RES 5 H",      0, res_5_h },
-    { "RES 5 L",      0, res_5_l },
-    { "RES 5 (HL)",   0, res_5_hl },
-    { "RES 5 A",      0, res_5_a },
+    { "RES 4 B",      0, 2, 2, res_4_b },
+    { "RES 4 C",      0, 2, 2, res_4_c },
+    { "RES 4 D",      0, 2, 2, res_4_d },
+    { "RES 4 E",      0, 2, 2, res_4_e },
+    { "RES 4 H",      0, 2, 2, res_4_h },
+    { "RES 4 L",      0, 2, 2, res_4_l },
+    { "RES 4 (HL)",   0, 4, 4, res_4_hl },
+    { "RES 4 A",      0, 2, 2, res_4_a },
+    { "RES 5 B",      0, 2, 2, res_5_b },
+    { "RES 5 C",      0, 2, 2, res_5_c },
+    { "RES 5 D",      0, 2, 2, res_5_d },
+    { "RES 5 E",      0, 2, 2, res_5_e },
+    { "RES 5 H",      0, 2, 2, res_5_h },
+    { "RES 5 L",      0, 2, 2, res_5_l },
+    { "RES 5 (HL)",   0, 4, 4, res_5_hl },
+    { "RES 5 A",      0, 2, 2, res_5_a },
 
     // 0xb0
-    { "RES 6 B",      0, res_6_b },
-    { "RES 6 C",      0, res_6_c },
-    { "RES 6 D",      0, res_6_d },
-    { "RES 6 E",      0, res_6_e },
-    { "RES 6 H",      0, res_6_h },
-    { "RES 6 L",      0, res_6_l },
-    { "RES 6 (HL)",   0, res_6_hl },
-    { "RES 6 A",      0, res_6_a },
-    { "RES 7 B",      0, res_7_b },
-    { "RES 7 C",      0, res_7_c },
-    { "RES 7 D",      0, res_7_d },
-    { "RES 7 E",      0, res_7_e },
-    { "RES 7 H",      0, res_7_h },
-    { "RES 7 L",      0, res_7_l },
-    { "RES 7 (HL)",   0, res_7_hl },
-    { "RES 7 A",      0, res_7_a },
+    { "RES 6 B",      0, 2, 2, res_6_b },
+    { "RES 6 C",      0, 2, 2, res_6_c },
+    { "RES 6 D",      0, 2, 2, res_6_d },
+    { "RES 6 E",      0, 2, 2, res_6_e },
+    { "RES 6 H",      0, 2, 2, res_6_h },
+    { "RES 6 L",      0, 2, 2, res_6_l },
+    { "RES 6 (HL)",   0, 4, 4, res_6_hl },
+    { "RES 6 A",      0, 2, 2, res_6_a },
+    { "RES 7 B",      0, 2, 2, res_7_b },
+    { "RES 7 C",      0, 2, 2, res_7_c },
+    { "RES 7 D",      0, 2, 2, res_7_d },
+    { "RES 7 E",      0, 2, 2, res_7_e },
+    { "RES 7 H",      0, 2, 2, res_7_h },
+    { "RES 7 L",      0, 2, 2, res_7_l },
+    { "RES 7 (HL)",   0, 4, 4, res_7_hl },
+    { "RES 7 A",      0, 2, 2, res_7_a },
 
     // 0xc0
-    { "SET 0 B",      0, set_0_b },
-    { "SET 0 C",      0, set_0_c },
-    { "SET 0 D",      0, set_0_d },
-    { "SET 0 E",      0, set_0_e },
-    { "SET 0 H",      0, set_0_h },
-    { "SET 0 L",      0, set_0_l },
-    { "SET 0 (HL)",   0, set_0_hl },
-    { "SET 0 A",      0, set_0_a },
-    { "SET 1 B",      0, set_1_b },
-    { "SET 1 C",      0, set_1_c },
-    { "SET 1 D",      0, set_1_d },
-    { "SET 1 E",      0, set_1_e },
-    { "SET 1 H",      0, set_1_h },
-    { "SET 1 L",      0, set_1_l },
-    { "SET 1 (HL)",   0, set_1_hl },
-    { "SET 1 A",      0, set_1_a },
+    { "SET 0 B",      0, 2, 2, set_0_b },
+    { "SET 0 C",      0, 2, 2, set_0_c },
+    { "SET 0 D",      0, 2, 2, set_0_d },
+    { "SET 0 E",      0, 2, 2, set_0_e },
+    { "SET 0 H",      0, 2, 2, set_0_h },
+    { "SET 0 L",      0, 2, 2, set_0_l },
+    { "SET 0 (HL)",   0, 4, 4, set_0_hl },
+    { "SET 0 A",      0, 2, 2, set_0_a },
+    { "SET 1 B",      0, 2, 2, set_1_b },
+    { "SET 1 C",      0, 2, 2, set_1_c },
+    { "SET 1 D",      0, 2, 2, set_1_d },
+    { "SET 1 E",      0, 2, 2, set_1_e },
+    { "SET 1 H",      0, 2, 2, set_1_h },
+    { "SET 1 L",      0, 2, 2, set_1_l },
+    { "SET 1 (HL)",   0, 4, 4, set_1_hl },
+    { "SET 1 A",      0, 2, 2, set_1_a },
 
     // 0xd0
-    { "SET 2 B",      0, set_2_b },
-    { "SET 2 C",      0, set_2_c },
-    { "SET 2 D",      0, set_2_d },
-    { "SET 2 E",      0, set_2_e },
-    { "SET 2 H",      0, set_2_h },
-    { "SET 2 L",      0, set_2_l },
-    { "SET 2 (HL)",   0, set_2_hl },
-    { "SET 2 A",      0, set_2_a },
-    { "SET 3 B",      0, set_3_b },
-    { "SET 3 C",      0, set_3_c },
-    { "SET 3 D",      0, set_3_d },
-    { "SET 3 E",      0, set_3_e },
-    { "SET 3 H",      0, set_3_h },
-    { "SET 3 L",      0, set_3_l },
-    { "SET 3 (HL)",   0, set_3_hl },
-    { "SET 3 A",      0, set_3_a },
+    { "SET 2 B",      0, 2, 2, set_2_b },
+    { "SET 2 C",      0, 2, 2, set_2_c },
+    { "SET 2 D",      0, 2, 2, set_2_d },
+    { "SET 2 E",      0, 2, 2, set_2_e },
+    { "SET 2 H",      0, 2, 2, set_2_h },
+    { "SET 2 L",      0, 2, 2, set_2_l },
+    { "SET 2 (HL)",   0, 4, 4, set_2_hl },
+    { "SET 2 A",      0, 2, 2, set_2_a },
+    { "SET 3 B",      0, 2, 2, set_3_b },
+    { "SET 3 C",      0, 2, 2, set_3_c },
+    { "SET 3 D",      0, 2, 2, set_3_d },
+    { "SET 3 E",      0, 2, 2, set_3_e },
+    { "SET 3 H",      0, 2, 2, set_3_h },
+    { "SET 3 L",      0, 2, 2, set_3_l },
+    { "SET 3 (HL)",   0, 4, 4, set_3_hl },
+    { "SET 3 A",      0, 2, 2, set_3_a },
 
     // 0xe0
-    { "SET 4 B",      0, set_4_b },
-    { "SET 4 C",      0, set_4_c },
-    { "SET 4 D",      0, set_4_d },
-    { "SET 4 E",      0, set_4_e },
-    { "SET 4 H",      0, set_4_h },
-    { "SET 4 L",      0, set_4_l },
-    { "SET 4 (HL)",   0, set_4_hl },
-    { "SET 4 A",      0, set_4_a },
-    { "SET 5 B",      0, set_5_b },
-    { "SET 5 C",      0, set_5_c },
-    { "SET 5 D",      0, set_5_d },
-    { "SET 5 E",      0, set_5_e },
-    { "SET 5 H",      0, set_5_h },
-    { "SET 5 L",      0, set_5_l },
-    { "SET 5 (HL)",   0, set_5_hl },
-    { "SET 5 A",      0, set_5_a },
+    { "SET 4 B",      0, 2, 2, set_4_b },
+    { "SET 4 C",      0, 2, 2, set_4_c },
+    { "SET 4 D",      0, 2, 2, set_4_d },
+    { "SET 4 E",      0, 2, 2, set_4_e },
+    { "SET 4 H",      0, 2, 2, set_4_h },
+    { "SET 4 L",      0, 2, 2, set_4_l },
+    { "SET 4 (HL)",   0, 4, 4, set_4_hl },
+    { "SET 4 A",      0, 2, 2, set_4_a },
+    { "SET 5 B",      0, 2, 2, set_5_b },
+    { "SET 5 C",      0, 2, 2, set_5_c },
+    { "SET 5 D",      0, 2, 2, set_5_d },
+    { "SET 5 E",      0, 2, 2, set_5_e },
+    { "SET 5 H",      0, 2, 2, set_5_h },
+    { "SET 5 L",      0, 2, 2, set_5_l },
+    { "SET 5 (HL)",   0, 4, 4, set_5_hl },
+    { "SET 5 A",      0, 2, 2, set_5_a },
 
     // 0xf0
-    { "SET 6 B",      0, set_6_b },
-    { "SET 6 C",      0, set_6_c },
-    { "SET 6 D",      0, set_6_d },
-    { "SET 6 E",      0, set_6_e },
-    { "SET 6 H",      0, set_6_h },
-    { "SET 6 L",      0, set_6_l },
-    { "SET 6 (HL)",   0, set_6_hl },
-    { "SET 6 A",      0, set_6_a },
-    { "SET 7 B",      0, set_7_b },
-    { "SET 7 C",      0, set_7_c },
-    { "SET 7 D",      0, set_7_d },
-    { "SET 7 E",      0, set_7_e },
-    { "SET 7 H",      0, set_7_h },
-    { "SET 7 L",      0, set_7_l },
-    { "SET 7 (HL)",   0, set_7_hl },
-    { "SET 7 A",      0, set_7_a },
+    { "SET 6 B",      0, 2, 2, set_6_b },
+    { "SET 6 C",      0, 2, 2, set_6_c },
+    { "SET 6 D",      0, 2, 2, set_6_d },
+    { "SET 6 E",      0, 2, 2, set_6_e },
+    { "SET 6 H",      0, 2, 2, set_6_h },
+    { "SET 6 L",      0, 2, 2, set_6_l },
+    { "SET 6 (HL)",   0, 4, 4, set_6_hl },
+    { "SET 6 A",      0, 2, 2, set_6_a },
+    { "SET 7 B",      0, 2, 2, set_7_b },
+    { "SET 7 C",      0, 2, 2, set_7_c },
+    { "SET 7 D",      0, 2, 2, set_7_d },
+    { "SET 7 E",      0, 2, 2, set_7_e },
+    { "SET 7 H",      0, 2, 2, set_7_h },
+    { "SET 7 L",      0, 2, 2, set_7_l },
+    { "SET 7 (HL)",   0, 4, 4, set_7_hl },
+    { "SET 7 A",      0, 2, 2, set_7_a },
 };
+
+
+
+bool cpu_instruction_ends_block(uint8_t opcode)
+{
+    switch (opcode)
+    {
+    // JR
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+    // JP
+    case 0xc2: case 0xc3: case 0xca: case 0xd2: case 0xda: case 0xe9:
+    // CALL
+    case 0xc4: case 0xcc: case 0xcd: case 0xd4: case 0xdc:
+    // RET, RETI
+    case 0xc0: case 0xc8: case 0xc9: case 0xd0: case 0xd8: case 0xd9:
+    // RST
+    case 0xc7: case 0xcf: case 0xd7: case 0xdf: case 0xe7: case 0xef: case 0xf7: case 0xff:
+    // STOP, HALT
+    case 0x10: case 0x76:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+
+#if CPU_THREADED_DISPATCH
+
+// Each opcode gets its own label in cpu_run_threaded(). Because the
+// instruction tables are constant, the compiler resolves each
+// instructions[n].impl to a direct (and usually inlined) call,
+// and every handler ends with its own copy of the dispatch sequence
+// instead of returning to a single indirect call site.
+#define OPCODES_ROW(X, hi) \
+    X(hi##0) X(hi##1) X(hi##2) X(hi##3) X(hi##4) X(hi##5) X(hi##6) X(hi##7) \
+    X(hi##8) X(hi##9) X(hi##a) X(hi##b) X(hi##c) X(hi##d) X(hi##e) X(hi##f)
+#define ALL_OPCODES(X) \
+    OPCODES_ROW(X, 0x0) OPCODES_ROW(X, 0x1) OPCODES_ROW(X, 0x2) OPCODES_ROW(X, 0x3) \
+    OPCODES_ROW(X, 0x4) OPCODES_ROW(X, 0x5) OPCODES_ROW(X, 0x6) OPCODES_ROW(X, 0x7) \
+    OPCODES_ROW(X, 0x8) OPCODES_ROW(X, 0x9) OPCODES_ROW(X, 0xa) OPCODES_ROW(X, 0xb) \
+    OPCODES_ROW(X, 0xc) OPCODES_ROW(X, 0xd) OPCODES_ROW(X, 0xe) OPCODES_ROW(X, 0xf)
+
+#define OPCODE_LABEL_ADDRESS(n)     &&op_##n,
+#define CB_OPCODE_LABEL_ADDRESS(n)  &&cb_##n,
+#define EXEC_LABEL_ADDRESS(n)       &&exec_##n,
+
+#define INTERRUPT_PENDING(cpu) \
+    ((cpu)->ime && ((cpu)->interruptFlags & (cpu)->interruptEnable & 0x1f))
+
+#define INSTRUCTION_CYCLES(instruction) \
+    (((instruction).cycles == (instruction).cyclesBranchTaken || ! cpu->branchTaken) \
+        ? (instruction).cycles \
+        : (instruction).cyclesBranchTaken)
+
+// Continue with the next instruction of the current decoded block, if any
+#define DISPATCH_DECODED() \
+    do \
+    { \
+        cpu->immediate = decoded->immediate; \
+        cpu->pc = decoded->nextPc; \
+        goto *decodedLabels[(decoded++)->opcode]; \
+    } \
+    while (0)
+
+// Finish the current instruction and jump straight to the next one,
+// unless a scheduled event is due or an interrupt needs servicing. Within
+// a decoded block, an MBC write switching banks ends the block early.
+#define DISPATCH_NEXT() \
+    do \
+    { \
+        if (scheduler->now >= scheduler->nextEventTime || INTERRUPT_PENDING(cpu)) \
+        { \
+            goto step; \
+        } \
+        if (decoded != decodedEnd && cpu->memory->selectedRomBank == decodedRomBank) \
+        { \
+            DISPATCH_DECODED(); \
+        } \
+        goto fetch; \
+    } \
+    while (0)
+
+// Entered with the pc just past the opcode. Decoded instructions skip the
+// immediate fetch and enter at exec_n instead.
+#define OPCODE_CASE(n) \
+    op_##n: \
+        if (n == 0xcb) \
+        { \
+            goto prefix_cb; \
+        } \
+        if (instructions[n].impl == NULL) \
+        { \
+            cpu->pc -= 1; \
+            goto unimplemented; \
+        } \
+        if (instructions[n].numImmediateBytes == 1) \
+        { \
+            cpu->immediate = memory_read_word(cpu->memory, cpu->pc); \
+        } \
+        else if (instructions[n].numImmediateBytes == 2) \
+        { \
+            cpu->immediate = memory_read_dword(cpu->memory, cpu->pc); \
+        } \
+        cpu->pc += instructions[n].numImmediateBytes; \
+    exec_##n: \
+        instructions[n].impl(cpu); \
+        scheduler->now += INSTRUCTION_CYCLES(instructions[n]); \
+        if (n == 0x76) \
+        { \
+            /* HALT: let the slow path decide whether to stop */ \
+            goto step; \
+        } \
+        DISPATCH_NEXT();
+
+#define CB_OPCODE_CASE(n) \
+    cb_##n: \
+        if (cbInstructions[n].impl == NULL) \
+        { \
+            cpu->pc -= 2; \
+            goto unimplemented; \
+        } \
+        cbInstructions[n].impl(cpu); \
+        scheduler->now += cbInstructions[n].cycles; \
+        DISPATCH_NEXT();
+
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+bool cpu_run_threaded(struct Cpu *cpu, struct Scheduler *scheduler)
+{
+    static const void *const opcodeLabels[256] = { ALL_OPCODES(OPCODE_LABEL_ADDRESS) };
+    static const void *const cbOpcodeLabels[256] = { ALL_OPCODES(CB_OPCODE_LABEL_ADDRESS) };
+
+    // Indexed by DecodedInstruction.opcode. The block cache never decodes
+    // unimplemented instructions or a bare 0xcb prefix.
+    static const void *const decodedLabels[BLOCK_CACHE_CB_OPCODE + 256] =
+    {
+        ALL_OPCODES(EXEC_LABEL_ADDRESS)
+        ALL_OPCODES(CB_OPCODE_LABEL_ADDRESS)
+    };
+
+    int stepCycles;
+    uint8_t opcode;
+    bool success = true;
+
+    const struct DecodedBlock *block;
+    const struct DecodedInstruction *decoded = NULL;
+    const struct DecodedInstruction *decodedEnd = NULL;
+    size_t decodedRomBank = 0;
+#if CPU_SKIP_IDLE_LOOPS
+    struct IdleLoopState idleLoop = { NULL, 0, 0, 0, 0, 0 };
+#endif
+
+step:
+#if CPU_SKIP_IDLE_LOOPS
+    idleLoop.block = NULL;
+#endif
+    if (scheduler->now >= scheduler->nextEventTime)
+    {
+        goto done;
+    }
+    stepCycles = cpu_handle_interrupts(cpu);
+    if (stepCycles > 0)
+    {
+        scheduler->now += stepCycles;
+        goto step;
+    }
+    if (cpu->halted)
+    {
+        // Nothing can wake the CPU until the rest of the system catches up.
+        scheduler->now = scheduler->nextEventTime;
+        goto done;
+    }
+
+fetch:
+    block = (cpu->blockCache != NULL)
+        ? block_cache_lookup(cpu->blockCache, cpu->memory, cpu->pc)
+        : NULL;
+#if CPU_SKIP_IDLE_LOOPS
+    cpu_skip_idle_loop(&idleLoop, cpu, scheduler, block);
+#endif
+    if (block != NULL)
+    {
+        decoded = block->instructions;
+        decodedEnd = decoded + block->numInstructions;
+        decodedRomBank = cpu->memory->selectedRomBank;
+        DISPATCH_DECODED();
+    }
+    decoded = decodedEnd;
+    opcode = memory_read_word(cpu->memory, cpu->pc++);
+    goto *opcodeLabels[opcode];
+
+prefix_cb:
+    opcode = memory_read_word(cpu->memory, cpu->pc++);
+    goto *cbOpcodeLabels[opcode];
+
+    ALL_OPCODES(OPCODE_CASE)
+    ALL_OPCODES(CB_OPCODE_CASE)
+
+unimplemented:
+    // Let the regular path report the problem.
+    success = cpu_execute_next(cpu, &stepCycles);
+    scheduler->now += stepCycles;
+
+done:
+    return success;
+}
+
+#pragma GCC diagnostic pop
+
+#endif
@@ -2,19 +2,70 @@
 #ifndef CPU_INSTRUCTIONS
 #define CPU_INSTRUCTIONS
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
 struct Cpu;
+struct Scheduler;
+struct DecodedBlock;
 typedef void (*InstructionImplFunc)(struct Cpu*);
 
 
+// Dispatch instructions with computed gotos where the compiler supports
+// them (GCC and Clang). Otherwise fall back to calling through the
+// instruction tables one instruction at a time.
+#ifndef CPU_THREADED_DISPATCH
+#if defined(__GNUC__)
+#define CPU_THREADED_DISPATCH  1
+#else
+#define CPU_THREADED_DISPATCH  0
+#endif
+#endif
+
+
+// Cycle counts are in machine cycles (1 MiHz). Conditional jumps, calls,
+// and returns take longer when the branch is taken; for every other
+// instruction the two counts are the same. The counts for the 0xcb-prefixed
+// instructions include fetching the prefix byte.
 struct Instruction
 {
     const char *name;
     int numImmediateBytes;
+    int cycles;
+    int cyclesBranchTaken;
     InstructionImplFunc impl;
 };
 
-const struct Instruction instructions[256];
-const struct Instruction cbInstructions[256];
+extern const struct Instruction instructions[256];
+extern const struct Instruction cbInstructions[256];
+
+
+// True for instructions that may transfer control somewhere other than the
+// next instruction (jumps, calls, returns, RST) or stop the CPU (HALT, STOP).
+bool cpu_instruction_ends_block(uint8_t opcode);
+
+
+#if CPU_SKIP_IDLE_LOOPS
+// Consecutive runs of the same idle loop (see struct DecodedBlock)
+struct IdleLoopState
+{
+    const struct DecodedBlock *block;
+    uint64_t entryTime;
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+};
+
+void cpu_skip_idle_loop(struct IdleLoopState *state, struct Cpu *cpu, struct Scheduler *scheduler, const struct DecodedBlock *block);
+#endif
+
+
+#if CPU_THREADED_DISPATCH
+bool cpu_run_threaded(struct Cpu *cpu, struct Scheduler *scheduler);
+#endif
 
 
 #endif
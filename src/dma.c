@@ -1,24 +1,42 @@
 
 #include "dma.h"
 #include "memory.h"
+#include "scheduler.h"
 
 #define NUM_DMA_CYCLES  160
 #define NUM_DMA_WORDS   MEMORY_OAM_SIZE
 
 
+static void dma_handle_complete(SchedulerEventFuncContext context, uint64_t time)
+{
+    (void)time;
+    struct Dma *dma = context;
+
+    // TODO: Only copy these bytes as cycles tick by instead of all at once?
+    for (uint16_t i = 0; i < NUM_DMA_WORDS; i++)
+    {
+        uint16_t sourceAddress = dma->sourceAddressStart + i;
+        dma->memory->oam[i] = memory_read_word(dma->memory, sourceAddress);
+    }
+    // TODO: unlock memory
+}
+
+
 #define IO_REGISTER_DMA  0x46
 static void io_handler_write_dma(IoRegisterFuncContext context, uint8_t value)
 {
     struct Dma *dma = context;
-    dma->cycleCounter = NUM_DMA_CYCLES;
     dma->sourceAddressStart = (uint16_t)value << 8;
+    scheduler_schedule(dma->scheduler, SCHEDULER_EVENT_DMA, dma->scheduler->now + NUM_DMA_CYCLES);
     // TODO: lock memory
 }
 
 
-void dma_init(struct Dma *dma, struct Memory *memory)
+void dma_init(struct Dma *dma, struct Memory *memory, struct Scheduler *scheduler)
 {
-    dma->cycleCounter = 0;
+    dma->sourceAddressStart = 0x0000;
+    dma->scheduler = scheduler;
+    scheduler_register_event(scheduler, SCHEDULER_EVENT_DMA, dma_handle_complete, dma);
 
     dma->memory = memory;
     memory_register_io_handler(
@@ -31,22 +49,13 @@ void dma_init(struct Dma *dma, struct Memory *memory)
 }
 
 
-void dma_tick(struct Dma *dma, int cycles)
+void dma_save_state(const struct Dma *dma, struct DmaState *state)
 {
-    if (dma->cycleCounter > 0)
-    {
-        dma->cycleCounter -= cycles;
-        if (dma->cycleCounter <= 0)
-        {
-            // TODO: Only copy these bytes as cycles tick by instead of all at once?
-            for (uint16_t i = 0; i < NUM_DMA_WORDS; i++)
-            {
-                uint16_t sourceAddress = dma->sourceAddressStart + i;
-                dma->memory->oam[i] = memory_read_word(dma->memory, sourceAddress);
-            }
-            // TODO: unlock memory
-        }
-    }
+    state->sourceAddressStart = dma->sourceAddressStart;
 }
 
 
+void dma_load_state(struct Dma *dma, const struct DmaState *state)
+{
+    dma->sourceAddressStart = state->sourceAddressStart;
+}
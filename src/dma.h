@@ -5,18 +5,28 @@
 #include <stdint.h>
 
 struct Memory;
+struct Scheduler;
 
 
 struct Dma
 {
-    int cycleCounter;
     uint16_t sourceAddressStart;
     struct Memory *memory;
+    struct Scheduler *scheduler;
 };
 
+// For save states. Whether a transfer is in progress is saved along with
+// the scheduler.
+struct DmaState
+{
+    uint16_t sourceAddressStart;
+};
+
+
+void dma_init(struct Dma *dma, struct Memory *memory, struct Scheduler *scheduler);
 
-void dma_init(struct Dma *dma, struct Memory *memory);
-void dma_tick(struct Dma *dma, int cycles);
+void dma_save_state(const struct Dma *dma, struct DmaState *state);
+void dma_load_state(struct Dma *dma, const struct DmaState *state);
 
 
 #endif
@@ -0,0 +1,112 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "cartridge.h"
+#include "block_cache.h"
+#include "jit.h"
+
+
+static void gameboy_handle_deadline_event(SchedulerEventFuncContext context, uint64_t time)
+{
+    (void)time;
+    struct GameBoy *gameBoy = context;
+    gameBoy->deadlineReached = true;
+}
+
+
+bool gameboy_init(struct GameBoy *gameBoy, const struct Cartridge *cartridge, bool useJit)
+{
+    if ( ! memory_init(&gameBoy->memory, cartridge))
+    {
+        return false;
+    }
+
+    scheduler_init(&gameBoy->scheduler);
+    scheduler_register_event(&gameBoy->scheduler, SCHEDULER_EVENT_DEADLINE, gameboy_handle_deadline_event, gameBoy);
+    gameBoy->deadlineReached = false;
+
+    cpu_init(&gameBoy->cpu, &gameBoy->memory);
+
+    // Without the cache the interpreter just decodes everything as it goes
+    gameBoy->cpu.blockCache = block_cache_create();
+
+    memset(gameBoy->pixelBuffer, 0, sizeof(gameBoy->pixelBuffer));
+    ppu_init(&gameBoy->ppu, &gameBoy->memory, &gameBoy->scheduler, &gameBoy->cpu, gameBoy->pixelBuffer);
+    dma_init(&gameBoy->dma, &gameBoy->memory, &gameBoy->scheduler);
+    timer_init(&gameBoy->timer, &gameBoy->memory, &gameBoy->scheduler, &gameBoy->cpu);
+    serial_init(&gameBoy->serial, &gameBoy->memory, &gameBoy->scheduler, &gameBoy->cpu);
+
+    memset(&gameBoy->inputState, 0, sizeof(gameBoy->inputState));
+    keypad_init(&gameBoy->keypad, &gameBoy->inputState, &gameBoy->cpu, &gameBoy->memory);
+
+    gameBoy->jit = NULL;
+    if (useJit)
+    {
+        gameBoy->jit = jit_create();
+        if (gameBoy->jit == NULL)
+        {
+            fprintf(stderr, "warning: recompiler not available, falling back to the interpreter \n");
+        }
+    }
+
+    return true;
+}
+
+
+void gameboy_teardown(struct GameBoy *gameBoy)
+{
+    jit_destroy(gameBoy->jit);
+    gameBoy->jit = NULL;
+    block_cache_destroy(gameBoy->cpu.blockCache);
+    gameBoy->cpu.blockCache = NULL;
+    memory_teardown(&gameBoy->memory);
+}
+
+
+bool gameboy_step(struct GameBoy *gameBoy)
+{
+    bool success = (gameBoy->jit != NULL)
+        ? jit_run(gameBoy->jit, &gameBoy->cpu, &gameBoy->scheduler)
+        : cpu_run(&gameBoy->cpu, &gameBoy->scheduler);
+    scheduler_run_due_events(&gameBoy->scheduler);
+    return success;
+}
+
+
+bool gameboy_run_frame(struct GameBoy *gameBoy)
+{
+    gameBoy->ppu.frameComplete = false;
+    while ( ! gameBoy->ppu.frameComplete)
+    {
+        if ( ! gameboy_step(gameBoy))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool gameboy_run_cycles(struct GameBoy *gameBoy, uint64_t cycles)
+{
+    if (cycles == 0)
+    {
+        return true;
+    }
+
+    // Scheduling the deadline as an event means a halted CPU or an idle
+    // loop skips ahead to exactly the right time.
+    gameBoy->deadlineReached = false;
+    scheduler_schedule(&gameBoy->scheduler, SCHEDULER_EVENT_DEADLINE, gameBoy->scheduler.now + cycles);
+    while ( ! gameBoy->deadlineReached)
+    {
+        if ( ! gameboy_step(gameBoy))
+        {
+            scheduler_cancel(&gameBoy->scheduler, SCHEDULER_EVENT_DEADLINE);
+            return false;
+        }
+    }
+    return true;
+}
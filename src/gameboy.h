@@ -0,0 +1,64 @@
+
+#ifndef GAMEBOY_H
+#define GAMEBOY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lcd.h"
+#include "memory.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "keypad.h"
+#include "dma.h"
+#include "timer.h"
+#include "serial.h"
+#include "scheduler.h"
+#include "input.h"
+
+struct Cartridge;
+struct Jit;
+
+
+// The whole emulated system, wired together. It doesn't depend on any
+// platform layer; frontends feed it input and present its pixel buffer.
+// The subsystems keep pointers to each other, so it mustn't be moved
+// after gameboy_init.
+struct GameBoy
+{
+    struct Memory memory;
+    struct Scheduler scheduler;
+    struct Cpu cpu;
+    struct Ppu ppu;
+    struct Dma dma;
+    struct Timer timer;
+    struct Serial serial;
+    struct Keypad keypad;
+    struct InputState inputState;
+    struct Jit *jit;
+
+    // Set by the deadline event that ends gameboy_run_cycles
+    bool deadlineReached;
+
+    // The shade of each pixel; see ppu_expand_pixels for colors
+    uint8_t pixelBuffer[LCD_WIDTH * LCD_HEIGHT];
+};
+
+
+// The cartridge must outlive the GameBoy, which runs its ROM in place
+bool gameboy_init(struct GameBoy *gameBoy, const struct Cartridge *cartridge, bool useJit);
+void gameboy_teardown(struct GameBoy *gameBoy);
+
+// Run the CPU up to the next scheduled event, then let the other
+// subsystems catch up. Returns false if the CPU couldn't continue.
+bool gameboy_step(struct GameBoy *gameBoy);
+
+// Run until the PPU completes the next frame
+bool gameboy_run_frame(struct GameBoy *gameBoy);
+
+// Run for (at least) the given number of machine cycles. The CPU stops at
+// the first instruction boundary after the deadline.
+bool gameboy_run_cycles(struct GameBoy *gameBoy, uint64_t cycles);
+
+
+#endif
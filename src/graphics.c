@@ -2,11 +2,11 @@
 #include "graphics.h"
 
 
-void graphics_update(struct Graphics* graphics)
+void graphics_update(struct Graphics* graphics, const uint8_t *pixelBuffer)
 {
     if (graphics->sdlWindow != NULL)
     {
-        SDL_UpdateTexture(graphics->sdlCanvasTexture, NULL, graphics->pixelBuffer, 4 * LCD_WIDTH);
+        SDL_UpdateTexture(graphics->sdlCanvasTexture, NULL, pixelBuffer, 4 * LCD_WIDTH);
         SDL_RenderCopy(graphics->sdlRenderer, graphics->sdlCanvasTexture, NULL, NULL);
         SDL_RenderPresent(graphics->sdlRenderer);
     }
@@ -71,6 +71,19 @@ bool graphics_init(struct Graphics *graphics, struct GraphicsOptions *options)
 
 
 
+#define DEFAULT_REFRESH_RATE  60
+
+int graphics_get_refresh_rate(struct Graphics *graphics)
+{
+    SDL_DisplayMode displayMode;
+    if (graphics->sdlWindow == NULL || SDL_GetWindowDisplayMode(graphics->sdlWindow, &displayMode) != 0 || displayMode.refresh_rate <= 0)
+    {
+        return DEFAULT_REFRESH_RATE;
+    }
+    return displayMode.refresh_rate;
+}
+
+
 void graphics_teardown(struct Graphics *graphics)
 {
     if (graphics->sdlCanvasTexture != NULL)
@@ -7,13 +7,7 @@
 #include <SDL2/SDL.h>
 
 #include "lcd.h"
-
-
-struct GraphicsOptions
-{
-    bool smallWindow;
-    bool headless;
-};
+#include "options.h"
 
 
 struct Graphics
@@ -21,13 +15,16 @@ struct Graphics
     SDL_Window* sdlWindow;
     SDL_Renderer* sdlRenderer;
     SDL_Texture* sdlCanvasTexture;
-    uint8_t pixelBuffer[4 * LCD_WIDTH * LCD_HEIGHT];
 };
 
 
 bool graphics_init(struct Graphics *graphics, struct GraphicsOptions *options);
-void graphics_update(struct Graphics* graphics);
+// pixelBuffer is 4 * LCD_WIDTH * LCD_HEIGHT bytes of ARGB8888 pixels
+void graphics_update(struct Graphics* graphics, const uint8_t *pixelBuffer);
 void graphics_teardown(struct Graphics *graphics);
 
+// Refresh rate of the display showing the window, in Hz
+int graphics_get_refresh_rate(struct Graphics *graphics);
+
 
 #endif
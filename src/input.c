@@ -13,6 +13,12 @@
 #define KEYPAD_DPAD_UP        SDLK_UP
 #define KEYPAD_DPAD_DOWN      SDLK_DOWN
 
+// Held to run as fast as possible
+#define KEY_TURBO  SDLK_TAB
+
+// Held to step backwards through recent history
+#define KEY_REWIND  SDLK_BACKSPACE
+
 
 void input_update(struct InputState *input)
 {
@@ -42,6 +48,12 @@ void input_update(struct InputState *input)
             case SDLK_m:
                 input->dumpMemory = true;
                 break;
+            case KEY_TURBO:
+                input->turbo = true;
+                break;
+            case KEY_REWIND:
+                input->rewind = true;
+                break;
 
             case KEYPAD_BUTTON_A:
                 input->buttonA = true;
@@ -76,6 +88,13 @@ void input_update(struct InputState *input)
         {
             switch (event.key.keysym.sym)
             {
+            case KEY_TURBO:
+                input->turbo = false;
+                break;
+            case KEY_REWIND:
+                input->rewind = false;
+                break;
+
             case KEYPAD_BUTTON_A:
                 input->buttonA = false;
                 break;
@@ -10,6 +10,8 @@ struct InputState
     // Emulator controls
     bool quit;
     bool dumpMemory;
+    bool turbo;
+    bool rewind;
 
     // GameBoy controls
     bool buttonA;
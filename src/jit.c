@@ -0,0 +1,810 @@
+
+// Needed for MAP_ANONYMOUS and sysconf
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "jit.h"
+#include "cpu.h"
+#include "cpu_instructions.h"
+#include "memory.h"
+#include "scheduler.h"
+
+
+#if JIT_SUPPORTED
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+// This is a first tier "call-threaded" recompiler: each SM83 instruction in
+// a block becomes a direct call to its interpreter implementation, with
+// the program counter, cycle accounting and event/interrupt checks emitted
+// inline. That removes opcode fetch, decode and dispatch entirely while
+// reusing the interpreter's instruction semantics unchanged. The most common
+// register-only instructions (loads, INC/DEC, ALU ops and jumps) are
+// translated to native code instead.
+//
+// Only code in ROM is translated. ROM cannot be written to, so translated
+// blocks never need to be invalidated; they are keyed by their offset in
+// the ROM image, which takes the selected bank into account. Code running
+// from RAM always goes through the interpreter.
+//
+// The code buffer is never writable and executable at once: the pages a
+// block is emitted into are made writable while it's compiled, then
+// executable again before anything runs. The emulator can be embedded in
+// other programs, so they mustn't be left with a W+X mapping (which
+// hardened kernels refuse anyway).
+//
+// Register usage inside a block:
+//   rbx: struct Cpu *
+//   r12: struct Scheduler *
+//   r13: struct Memory *
+
+typedef void (*JitBlockFunc)(struct Cpu*, struct Scheduler*);
+
+#define CODE_BUFFER_SIZE          (16 * 1024 * 1024)
+#define MAX_BLOCK_INSTRUCTIONS    64
+#define MAX_INSTRUCTION_CODE_SIZE 128
+#define MAX_BLOCK_CODE_SIZE       (MAX_BLOCK_INSTRUCTIONS * MAX_INSTRUCTION_CODE_SIZE + 64)
+
+#define ROM_REGION_END  (MEMORY_ROM_BANKN_END + 1)
+
+
+struct Jit
+{
+    uint8_t *codeBuffer;
+    size_t codeBufferUsed;
+    size_t pageSize;
+
+    // Entry points indexed by ROM offset, allocated one bank at a time
+    JitBlockFunc *blocks[MEMORY_MAX_ROM_BANKS];
+};
+
+
+struct Emitter
+{
+    uint8_t *start;
+    uint8_t *cursor;
+
+    // Locations of rel32 jump operands that should target the block exit
+    uint8_t *exitFixups[MAX_BLOCK_INSTRUCTIONS * 3];
+    size_t numExitFixups;
+};
+
+
+static void emit8(struct Emitter *emitter, uint8_t value)
+{
+    *emitter->cursor++ = value;
+}
+
+static void emit_bytes(struct Emitter *emitter, const uint8_t *bytes, size_t size)
+{
+    memcpy(emitter->cursor, bytes, size);
+    emitter->cursor += size;
+}
+
+static void emit16(struct Emitter *emitter, uint16_t value)
+{
+    emit_bytes(emitter, (const uint8_t*)&value, sizeof(value));
+}
+
+static void emit32(struct Emitter *emitter, uint32_t value)
+{
+    emit_bytes(emitter, (const uint8_t*)&value, sizeof(value));
+}
+
+static void emit64(struct Emitter *emitter, uint64_t value)
+{
+    emit_bytes(emitter, (const uint8_t*)&value, sizeof(value));
+}
+
+// Emit a rel32 operand to be pointed at the block exit later
+static void emit_exit_fixup(struct Emitter *emitter)
+{
+    assert(emitter->numExitFixups < sizeof(emitter->exitFixups) / sizeof(emitter->exitFixups[0]));
+    emitter->exitFixups[emitter->numExitFixups++] = emitter->cursor;
+    emit32(emitter, 0);
+}
+
+
+static void emit_prologue(struct Emitter *emitter)
+{
+    // Three pushes also leave the stack 16-byte aligned for calls
+    emit8(emitter, 0x53);                                 // push rbx
+    emit8(emitter, 0x41); emit8(emitter, 0x54);           // push r12
+    emit8(emitter, 0x41); emit8(emitter, 0x55);           // push r13
+    emit8(emitter, 0x48); emit8(emitter, 0x89); emit8(emitter, 0xfb);  // mov rbx, rdi
+    emit8(emitter, 0x49); emit8(emitter, 0x89); emit8(emitter, 0xf4);  // mov r12, rsi
+    emit8(emitter, 0x4c); emit8(emitter, 0x8b); emit8(emitter, 0xab);  // mov r13, [rbx + memory]
+    emit32(emitter, offsetof(struct Cpu, memory));
+}
+
+static void emit_epilogue(struct Emitter *emitter)
+{
+    emit8(emitter, 0x41); emit8(emitter, 0x5d);  // pop r13
+    emit8(emitter, 0x41); emit8(emitter, 0x5c);  // pop r12
+    emit8(emitter, 0x5b);                        // pop rbx
+    emit8(emitter, 0xc3);                        // ret
+}
+
+
+// Offsets of the 8-bit registers in the order opcodes encode them. Operand
+// 6 is (HL), which is never handled natively.
+#define OPERAND_MEM_HL  6
+static const uint32_t registerOffsets[8] =
+{
+    offsetof(struct Cpu, registers.b),
+    offsetof(struct Cpu, registers.c),
+    offsetof(struct Cpu, registers.d),
+    offsetof(struct Cpu, registers.e),
+    offsetof(struct Cpu, registers.h),
+    offsetof(struct Cpu, registers.l),
+    0,
+    offsetof(struct Cpu, registers.a),
+};
+
+// BC, DE, HL, SP
+static const uint32_t registerPairOffsets[4] =
+{
+    offsetof(struct Cpu, registers.bc),
+    offsetof(struct Cpu, registers.de),
+    offsetof(struct Cpu, registers.hl),
+    offsetof(struct Cpu, sp),
+};
+
+
+// Instructions that access [rbx + offset] all use a mod=10, rm=rbx ModRM
+// byte followed by a 32-bit displacement.
+static void emit_rbx_operand(struct Emitter *emitter, uint8_t reg, uint32_t offset)
+{
+    emit8(emitter, 0x83 | (uint8_t)(reg << 3));
+    emit32(emitter, offset);
+}
+
+#define X86_EAX  0
+#define X86_ECX  1
+#define X86_EDX  2
+
+static void emit_store_byte_imm(struct Emitter *emitter, uint32_t offset, uint8_t value)
+{
+    emit8(emitter, 0xc6);  // mov byte [rbx + offset], imm8
+    emit_rbx_operand(emitter, 0, offset);
+    emit8(emitter, value);
+}
+
+static void emit_store_word_imm(struct Emitter *emitter, uint32_t offset, uint16_t value)
+{
+    emit8(emitter, 0x66); emit8(emitter, 0xc7);  // mov word [rbx + offset], imm16
+    emit_rbx_operand(emitter, 0, offset);
+    emit16(emitter, value);
+}
+
+static void emit_load_byte_zx(struct Emitter *emitter, uint8_t reg, uint32_t offset)
+{
+    emit8(emitter, 0x0f); emit8(emitter, 0xb6);  // movzx reg, byte [rbx + offset]
+    emit_rbx_operand(emitter, reg, offset);
+}
+
+static void emit_store_byte(struct Emitter *emitter, uint8_t reg, uint32_t offset)
+{
+    emit8(emitter, 0x88);  // mov [rbx + offset], reg8
+    emit_rbx_operand(emitter, reg, offset);
+}
+
+static void emit_set_pc(struct Emitter *emitter, uint16_t pc)
+{
+    emit_store_word_imm(emitter, offsetof(struct Cpu, pc), pc);
+}
+
+static void emit_add_now(struct Emitter *emitter, int cycles)
+{
+    // add qword [r12 + now], imm32
+    emit8(emitter, 0x49); emit8(emitter, 0x81); emit8(emitter, 0x84); emit8(emitter, 0x24);
+    emit32(emitter, offsetof(struct Scheduler, now));
+    emit32(emitter, (uint32_t)cycles);
+}
+
+
+static void emit_call_instruction(struct Emitter *emitter, uint16_t nextPc, uint16_t immediate, const struct Instruction *instruction)
+{
+    // Do what the interpreter's dispatcher does before running an instruction
+    if (instruction->numImmediateBytes > 0)
+    {
+        emit_store_word_imm(emitter, offsetof(struct Cpu, immediate), immediate);
+    }
+    emit_set_pc(emitter, nextPc);
+
+    InstructionImplFunc impl = instruction->impl;
+
+    uint64_t implAddress;
+    memcpy(&implAddress, &impl, sizeof(implAddress));
+    emit8(emitter, 0x48); emit8(emitter, 0x89); emit8(emitter, 0xdf);  // mov rdi, rbx
+    emit8(emitter, 0x48); emit8(emitter, 0xb8);                        // mov rax, imm64
+    emit64(emitter, implAddress);
+    emit8(emitter, 0xff); emit8(emitter, 0xd0);                        // call rax
+}
+
+
+static void emit_add_cycles(struct Emitter *emitter, const struct Instruction *instruction)
+{
+    if (instruction->cycles == instruction->cyclesBranchTaken)
+    {
+        emit_add_now(emitter, instruction->cycles);
+    }
+    else
+    {
+        // eax = cycles + branchTaken * (cyclesBranchTaken - cycles)
+        assert(instruction->cyclesBranchTaken > instruction->cycles);
+        emit_load_byte_zx(emitter, X86_EAX, offsetof(struct Cpu, branchTaken));
+        emit8(emitter, 0x6b); emit8(emitter, 0xc0);  // imul eax, eax, imm8
+        emit8(emitter, (uint8_t)(instruction->cyclesBranchTaken - instruction->cycles));
+        emit8(emitter, 0x05);                        // add eax, imm32
+        emit32(emitter, (uint32_t)instruction->cycles);
+
+        // add qword [r12 + now], rax
+        emit8(emitter, 0x49); emit8(emitter, 0x01); emit8(emitter, 0x84); emit8(emitter, 0x24);
+        emit32(emitter, offsetof(struct Scheduler, now));
+    }
+}
+
+
+// Leave the block when the interpreter would stop dispatching because a
+// scheduled event is due.
+static void emit_event_check(struct Emitter *emitter)
+{
+    // mov rax, [r12 + now]
+    emit8(emitter, 0x49); emit8(emitter, 0x8b); emit8(emitter, 0x84); emit8(emitter, 0x24);
+    emit32(emitter, offsetof(struct Scheduler, now));
+    // cmp rax, [r12 + nextEventTime]
+    emit8(emitter, 0x49); emit8(emitter, 0x3b); emit8(emitter, 0x84); emit8(emitter, 0x24);
+    emit32(emitter, offsetof(struct Scheduler, nextEventTime));
+    // jae exit
+    emit8(emitter, 0x0f); emit8(emitter, 0x83);
+    emit_exit_fixup(emitter);
+}
+
+// Leave the block if an interrupt should be taken. Only an instruction that
+// writes memory or changes IME can make one pending, so natively translated
+// instructions skip this check.
+static void emit_interrupt_check(struct Emitter *emitter)
+{
+    // cmp byte [rbx + ime], 0
+    emit8(emitter, 0x80);
+    emit_rbx_operand(emitter, 7, offsetof(struct Cpu, ime));
+    emit8(emitter, 0x00);
+    // je (past the interrupt check)
+    emit8(emitter, 0x74); emit8(emitter, 21);
+    // movzx eax, byte [rbx + interruptFlags]
+    emit_load_byte_zx(emitter, X86_EAX, offsetof(struct Cpu, interruptFlags));
+    // and al, [rbx + interruptEnable]
+    emit8(emitter, 0x22);
+    emit_rbx_operand(emitter, X86_EAX, offsetof(struct Cpu, interruptEnable));
+    // test al, 0x1f
+    emit8(emitter, 0xa8); emit8(emitter, 0x1f);
+    // jnz exit
+    emit8(emitter, 0x0f); emit8(emitter, 0x85);
+    emit_exit_fixup(emitter);
+}
+
+// The rest of the block is stale if an MBC write switched banks
+static void emit_rom_bank_check(struct Emitter *emitter, size_t romBank)
+{
+    // mov rax, [r13 + selectedRomBank]
+    emit8(emitter, 0x49); emit8(emitter, 0x8b); emit8(emitter, 0x85);
+    emit32(emitter, offsetof(struct Memory, selectedRomBank));
+    // cmp rax, imm32
+    emit8(emitter, 0x48); emit8(emitter, 0x3d);
+    emit32(emitter, (uint32_t)romBank);
+    // jne exit
+    emit8(emitter, 0x0f); emit8(emitter, 0x85);
+    emit_exit_fixup(emitter);
+}
+
+
+#if CPU_LAZY_FLAGS
+
+// Only the lazy flag results are stored from a 16-bit register
+static void emit_store_word(struct Emitter *emitter, uint8_t reg, uint32_t offset)
+{
+    emit8(emitter, 0x66); emit8(emitter, 0x89);  // mov [rbx + offset], reg16
+    emit_rbx_operand(emitter, reg, offset);
+}
+
+
+// These depend on the lazy flag representation in cpu_flags.h
+
+#define ALU_ADD  0
+#define ALU_SUB  2
+#define ALU_AND  4
+#define ALU_XOR  5
+#define ALU_OR   6
+#define ALU_CP   7
+
+// A = A op ecx
+static bool emit_alu(struct Emitter *emitter, int operation)
+{
+    uint32_t aOffset = offsetof(struct Cpu, registers.a);
+    switch (operation)
+    {
+    case ALU_ADD:
+    case ALU_SUB:
+    case ALU_CP:
+        emit_load_byte_zx(emitter, X86_EAX, aOffset);
+        if (operation == ALU_ADD)
+        {
+            emit8(emitter, 0x8d); emit8(emitter, 0x14); emit8(emitter, 0x08);  // lea edx, [rax + rcx]
+        }
+        else
+        {
+            emit8(emitter, 0x89); emit8(emitter, 0xc2);  // mov edx, eax
+            emit8(emitter, 0x29); emit8(emitter, 0xca);  // sub edx, ecx
+        }
+        emit_store_byte(emitter, X86_EDX, offsetof(struct Cpu, flags.zeroResult));
+        emit_store_word(emitter, X86_EDX, offsetof(struct Cpu, flags.carryResult));
+        emit_store_byte_imm(emitter, offsetof(struct Cpu, flags.negative), operation != ALU_ADD);
+        if (operation != ALU_CP)
+        {
+            emit_store_byte(emitter, X86_EDX, aOffset);
+        }
+        emit8(emitter, 0x31); emit8(emitter, 0xc8);  // xor eax, ecx
+        emit8(emitter, 0x31); emit8(emitter, 0xd0);  // xor eax, edx
+        emit_store_word(emitter, X86_EAX, offsetof(struct Cpu, flags.halfCarryResult));
+        return true;
+    case ALU_AND:
+    case ALU_XOR:
+    case ALU_OR:
+        emit_load_byte_zx(emitter, X86_EAX, aOffset);
+        emit8(emitter, (operation == ALU_AND) ? 0x21 : (operation == ALU_XOR) ? 0x31 : 0x09);
+        emit8(emitter, 0xc8);  // and/xor/or eax, ecx
+        emit_store_byte(emitter, X86_EAX, aOffset);
+        emit_store_byte(emitter, X86_EAX, offsetof(struct Cpu, flags.zeroResult));
+        emit_store_byte_imm(emitter, offsetof(struct Cpu, flags.negative), 0);
+        emit_store_word_imm(emitter, offsetof(struct Cpu, flags.halfCarryResult), (operation == ALU_AND) ? 0x10 : 0);
+        emit_store_word_imm(emitter, offsetof(struct Cpu, flags.carryResult), 0);
+        return true;
+    default:
+        // ADC and SBC go through the interpreter
+        return false;
+    }
+}
+
+
+// Conditions as encoded in JR cc and JP cc: NZ, Z, NC, C
+static void emit_conditional_jump(struct Emitter *emitter, int condition, uint16_t target, uint16_t fallthrough, const struct Instruction *instruction)
+{
+    if (condition < 2)
+    {
+        // cmp byte [rbx + zeroResult], 0  (ZF = Z)
+        emit8(emitter, 0x80);
+        emit_rbx_operand(emitter, 7, offsetof(struct Cpu, flags.zeroResult));
+        emit8(emitter, 0x00);
+    }
+    else
+    {
+        // test word [rbx + carryResult], 0x100  (ZF = !C)
+        emit8(emitter, 0x66); emit8(emitter, 0xf7);
+        emit_rbx_operand(emitter, 0, offsetof(struct Cpu, flags.carryResult));
+        emit16(emitter, 0x100);
+    }
+
+    // Skip over the taken path: je for NZ and C, jne for Z and NC
+    emit8(emitter, (condition == 0 || condition == 3) ? 0x74 : 0x75);
+    uint8_t *skip = emitter->cursor;
+    emit8(emitter, 0);
+
+    emit_set_pc(emitter, target);
+    emit_add_now(emitter, instruction->cyclesBranchTaken);
+    emit8(emitter, 0xe9);  // jmp exit
+    emit_exit_fixup(emitter);
+
+    *skip = (uint8_t)(emitter->cursor - (skip + 1));
+    emit_set_pc(emitter, fallthrough);
+    emit_add_now(emitter, instruction->cycles);
+}
+
+#endif
+
+
+// Translate the simple, hot instructions to native code instead of calling
+// their implementations. None of these access memory, so they cannot have
+// side effects beyond the CPU registers. Returns false if the instruction
+// has no native translation.
+static bool emit_native_instruction(struct Emitter *emitter, const uint8_t *bytes, uint16_t address)
+{
+    uint8_t opcode = bytes[0];
+    const struct Instruction *instruction = &instructions[opcode];
+    uint16_t nextPc = address + 1 + instruction->numImmediateBytes;
+    uint8_t imm8 = bytes[1];
+    uint16_t imm16 = bytes[1] | (bytes[2] << 8);
+
+    int dst = (opcode >> 3) & 0x07;
+    int src = opcode & 0x07;
+    int pair = (opcode >> 4) & 0x03;
+
+    uint8_t *start = emitter->cursor;
+    emit_set_pc(emitter, nextPc);
+
+    if (opcode == 0x00)
+    {
+        // NOP
+    }
+    else if (opcode >= 0x40 && opcode <= 0x7f && dst != OPERAND_MEM_HL && src != OPERAND_MEM_HL)
+    {
+        // LD r, r
+        emit_load_byte_zx(emitter, X86_EAX, registerOffsets[src]);
+        emit_store_byte(emitter, X86_EAX, registerOffsets[dst]);
+    }
+    else if ((opcode & 0xc7) == 0x06 && dst != OPERAND_MEM_HL)
+    {
+        // LD r, d8
+        emit_store_byte_imm(emitter, registerOffsets[dst], imm8);
+    }
+    else if ((opcode & 0xcf) == 0x01)
+    {
+        // LD rr, d16
+        emit_store_word_imm(emitter, registerPairOffsets[pair], imm16);
+    }
+    else if ((opcode & 0xcf) == 0x03 || (opcode & 0xcf) == 0x0b)
+    {
+        // INC rr, DEC rr: add/sub word [rbx + offset], 1
+        emit8(emitter, 0x66); emit8(emitter, 0x83);
+        emit_rbx_operand(emitter, ((opcode & 0x0f) == 0x03) ? 0 : 5, registerPairOffsets[pair]);
+        emit8(emitter, 1);
+    }
+    else if (opcode == 0x18 || opcode == 0xc3)
+    {
+        // JR r8, JP a16
+        emitter->cursor = start;
+        emit_set_pc(emitter, (opcode == 0x18) ? (uint16_t)(nextPc + (int8_t)imm8) : imm16);
+    }
+#if CPU_LAZY_FLAGS
+    else if (((opcode & 0xc7) == 0x04 || (opcode & 0xc7) == 0x05) && dst != OPERAND_MEM_HL)
+    {
+        // INC r, DEC r
+        bool isIncrement = (opcode & 0x07) == 0x04;
+        emit_load_byte_zx(emitter, X86_EAX, registerOffsets[dst]);
+        emit8(emitter, 0x8d); emit8(emitter, 0x50);  // lea edx, [rax +/- 1]
+        emit8(emitter, isIncrement ? 0x01 : 0xff);
+        emit_store_byte(emitter, X86_EDX, registerOffsets[dst]);
+        emit_store_byte(emitter, X86_EDX, offsetof(struct Cpu, flags.zeroResult));
+        emit_store_byte_imm(emitter, offsetof(struct Cpu, flags.negative), ! isIncrement);
+        emit8(emitter, 0x31); emit8(emitter, 0xd0);                       // xor eax, edx
+        emit8(emitter, 0x83); emit8(emitter, 0xf0); emit8(emitter, 0x01); // xor eax, 1
+        emit_store_word(emitter, X86_EAX, offsetof(struct Cpu, flags.halfCarryResult));
+    }
+    else if (opcode >= 0x80 && opcode <= 0xbf && src != OPERAND_MEM_HL)
+    {
+        // ALU A, r
+        emit_load_byte_zx(emitter, X86_ECX, registerOffsets[src]);
+        if ( ! emit_alu(emitter, dst))
+        {
+            emitter->cursor = start;
+            return false;
+        }
+    }
+    else if ((opcode & 0xc7) == 0xc6)
+    {
+        // ALU A, d8
+        emit8(emitter, 0xb9);  // mov ecx, imm32
+        emit32(emitter, imm8);
+        if ( ! emit_alu(emitter, dst))
+        {
+            emitter->cursor = start;
+            return false;
+        }
+    }
+    else if (opcode == 0x20 || opcode == 0x28 || opcode == 0x30 || opcode == 0x38 ||
+        opcode == 0xc2 || opcode == 0xca || opcode == 0xd2 || opcode == 0xda)
+    {
+        // JR cc, r8 and JP cc, a16
+        emitter->cursor = start;
+        uint16_t target = (opcode < 0x40) ? (uint16_t)(nextPc + (int8_t)imm8) : imm16;
+        emit_conditional_jump(emitter, dst & 0x03, target, nextPc, instruction);
+        return true;
+    }
+#endif
+    else
+    {
+        emitter->cursor = start;
+        return false;
+    }
+
+    emit_add_now(emitter, instruction->cycles);
+    return true;
+}
+
+
+// Changes the protection of the pages a block at this offset in the code
+// buffer can be emitted into
+static bool protect_block(struct Jit *jit, size_t offset, int protection)
+{
+    size_t start = offset - offset % jit->pageSize;
+    size_t end = offset + MAX_BLOCK_CODE_SIZE;
+    return mprotect(jit->codeBuffer + start, end - start, protection) == 0;
+}
+
+
+// Returns NULL if not even the first instruction could be translated
+static JitBlockFunc compile_block(struct Jit *jit, struct Cpu *cpu, uint16_t startAddress)
+{
+    struct Memory *memory = cpu->memory;
+    bool inSwitchableBank = startAddress >= MEMORY_ROM_BANKN_START;
+    uint16_t regionEnd = inSwitchableBank ? ROM_REGION_END : MEMORY_ROM_BANKN_START;
+
+    size_t offset = jit->codeBufferUsed;
+    if ( ! protect_block(jit, offset, PROT_READ | PROT_WRITE))
+    {
+        return NULL;
+    }
+
+    struct Emitter emitter;
+    emitter.start = jit->codeBuffer + offset;
+    emitter.cursor = emitter.start;
+    emitter.numExitFixups = 0;
+    emit_prologue(&emitter);
+
+    uint16_t address = startAddress;
+    int numInstructions = 0;
+    while (numInstructions < MAX_BLOCK_INSTRUCTIONS)
+    {
+        // ROM contents can't change, so the immediates can be baked in
+        uint8_t bytes[3];
+        for (uint16_t i = 0; i < sizeof(bytes); i++)
+        {
+            bytes[i] = memory_read_word(memory, address + i);
+        }
+
+        uint8_t opcode = bytes[0];
+        const struct Instruction *instruction;
+        uint16_t length;
+        if (opcode == 0xcb)
+        {
+            instruction = &cbInstructions[bytes[1]];
+            length = 2;
+        }
+        else
+        {
+            instruction = &instructions[opcode];
+            length = 1 + instruction->numImmediateBytes;
+        }
+
+        // Leave unimplemented instructions for the interpreter to report,
+        // and don't run into the next memory region.
+        if (instruction->impl == NULL || (uint32_t)address + length > regionEnd)
+        {
+            break;
+        }
+
+        bool isNative = (opcode != 0xcb) && emit_native_instruction(&emitter, bytes, address);
+        if ( ! isNative)
+        {
+            uint16_t immediate = (instruction->numImmediateBytes == 1) ? bytes[1] : (uint16_t)(bytes[1] | (bytes[2] << 8));
+            emit_call_instruction(&emitter, address + length, immediate, instruction);
+            emit_add_cycles(&emitter, instruction);
+        }
+        numInstructions += 1;
+
+        if (opcode != 0xcb && cpu_instruction_ends_block(opcode))
+        {
+            break;
+        }
+        address += length;
+        if (address >= regionEnd)
+        {
+            break;
+        }
+
+        emit_event_check(&emitter);
+        if ( ! isNative)
+        {
+            emit_interrupt_check(&emitter);
+            if (inSwitchableBank)
+            {
+                emit_rom_bank_check(&emitter, memory->selectedRomBank);
+            }
+        }
+    }
+
+    JitBlockFunc func = NULL;
+    if (numInstructions > 0)
+    {
+        uint8_t *exit = emitter.cursor;
+        emit_epilogue(&emitter);
+        for (size_t i = 0; i < emitter.numExitFixups; i++)
+        {
+            uint8_t *fixup = emitter.exitFixups[i];
+            int32_t displacement = (int32_t)(exit - (fixup + sizeof(int32_t)));
+            memcpy(fixup, &displacement, sizeof(displacement));
+        }
+
+        size_t codeSize = (size_t)(emitter.cursor - emitter.start);
+        assert(codeSize <= MAX_BLOCK_CODE_SIZE);
+        jit->codeBufferUsed += codeSize;
+        memcpy(&func, &emitter.start, sizeof(func));
+    }
+
+    // Earlier blocks can share the first page, so it has to be executable
+    // again even if nothing was emitted. If it can't be, forget them all.
+    if ( ! protect_block(jit, offset, PROT_READ | PROT_EXEC))
+    {
+        jit_flush(jit);
+        return NULL;
+    }
+    return func;
+}
+
+
+static JitBlockFunc find_block(struct Jit *jit, struct Cpu *cpu)
+{
+    uint16_t pc = cpu->pc;
+    if (pc >= ROM_REGION_END)
+    {
+        return NULL;
+    }
+
+    // Blocks have their addresses built in, so bank 0 mapped into the
+    // switchable region can't share them with the start of the ROM (see
+    // block_cache_lookup)
+    if (pc >= MEMORY_ROM_BANKN_START && cpu->memory->selectedRomBank == 0)
+    {
+        return NULL;
+    }
+
+    size_t romOffset = pc;
+    if (pc >= MEMORY_ROM_BANKN_START)
+    {
+        romOffset += (cpu->memory->selectedRomBank - 1) * MEMORY_ROM_BANK_SIZE;
+    }
+    size_t bank = romOffset / MEMORY_ROM_BANK_SIZE;
+    size_t offsetInBank = romOffset % MEMORY_ROM_BANK_SIZE;
+    if (bank >= MEMORY_MAX_ROM_BANKS)
+    {
+        return NULL;
+    }
+
+    if (jit->blocks[bank] == NULL)
+    {
+        jit->blocks[bank] = calloc(MEMORY_ROM_BANK_SIZE, sizeof(JitBlockFunc));
+        if (jit->blocks[bank] == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    JitBlockFunc block = jit->blocks[bank][offsetInBank];
+    if (block == NULL)
+    {
+        if (CODE_BUFFER_SIZE - jit->codeBufferUsed < MAX_BLOCK_CODE_SIZE)
+        {
+            jit_flush(jit);
+            return find_block(jit, cpu);
+        }
+        block = compile_block(jit, cpu, pc);
+
+        // Compiling flushes everything if it fails badly enough
+        if (jit->blocks[bank] != NULL)
+        {
+            jit->blocks[bank][offsetInBank] = block;
+        }
+    }
+    return block;
+}
+
+
+struct Jit* jit_create(void)
+{
+    struct Jit *jit = calloc(1, sizeof(struct Jit));
+    if (jit == NULL)
+    {
+        return NULL;
+    }
+
+    void *codeBuffer = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (codeBuffer == MAP_FAILED)
+    {
+        free(jit);
+        return NULL;
+    }
+    jit->codeBuffer = codeBuffer;
+    jit->codeBufferUsed = 0;
+    jit->pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    // Fail now, so the interpreter is used instead, if the system won't
+    // let the buffer become executable
+    if ( ! protect_block(jit, 0, PROT_READ | PROT_EXEC))
+    {
+        jit_destroy(jit);
+        return NULL;
+    }
+    return jit;
+}
+
+
+void jit_destroy(struct Jit *jit)
+{
+    if (jit != NULL)
+    {
+        jit_flush(jit);
+        munmap(jit->codeBuffer, CODE_BUFFER_SIZE);
+        free(jit);
+    }
+}
+
+
+void jit_flush(struct Jit *jit)
+{
+    for (size_t i = 0; i < MEMORY_MAX_ROM_BANKS; i++)
+    {
+        free(jit->blocks[i]);
+        jit->blocks[i] = NULL;
+    }
+    jit->codeBufferUsed = 0;
+}
+
+
+bool jit_run(struct Jit *jit, struct Cpu *cpu, struct Scheduler *scheduler)
+{
+    while (scheduler->now < scheduler->nextEventTime)
+    {
+        int cycles = cpu_handle_interrupts(cpu);
+        if (cycles > 0)
+        {
+            scheduler->now += cycles;
+            continue;
+        }
+        if (cpu->halted)
+        {
+            // Nothing can wake the CPU until the next event fires.
+            scheduler->now = scheduler->nextEventTime;
+            break;
+        }
+
+        JitBlockFunc block = find_block(jit, cpu);
+        if (block != NULL)
+        {
+            block(cpu, scheduler);
+        }
+        else
+        {
+            if ( ! cpu_execute_next(cpu, &cycles))
+            {
+                return false;
+            }
+            scheduler->now += cycles;
+        }
+    }
+    return true;
+}
+
+
+#else
+
+
+struct Jit* jit_create(void)
+{
+    return NULL;
+}
+
+void jit_destroy(struct Jit *jit)
+{
+    (void)jit;
+}
+
+void jit_flush(struct Jit *jit)
+{
+    (void)jit;
+}
+
+bool jit_run(struct Jit *jit, struct Cpu *cpu, struct Scheduler *scheduler)
+{
+    (void)jit;
+    return cpu_run(cpu, scheduler);
+}
+
+
+#endif
@@ -0,0 +1,34 @@
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+
+struct Cpu;
+struct Scheduler;
+
+
+// The recompiler emits x86-64 machine code into anonymous executable
+// mappings, so it is only available on x86-64 Linux. Elsewhere jit_create
+// always fails and callers fall back to the interpreter.
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED  1
+#else
+#define JIT_SUPPORTED  0
+#endif
+
+
+struct Jit;
+
+struct Jit* jit_create(void);
+void jit_destroy(struct Jit *jit);
+
+// Drop all translated code, e.g. because the ROM has changed.
+void jit_flush(struct Jit *jit);
+
+// Same contract as cpu_run, but executes translated ROM blocks where
+// possible and falls back to the interpreter for everything else.
+bool jit_run(struct Jit *jit, struct Cpu *cpu, struct Scheduler *scheduler);
+
+
+#endif
@@ -72,3 +72,15 @@ void keypad_tick(struct Keypad *keypad)
 {
     update_state(keypad);
 }
+
+
+void keypad_save_state(const struct Keypad *keypad, struct KeypadState *state)
+{
+    state->p1 = keypad->p1;
+}
+
+
+void keypad_load_state(struct Keypad *keypad, const struct KeypadState *state)
+{
+    keypad->p1 = state->p1;
+}
@@ -16,9 +16,19 @@ struct Keypad
     struct InputState *inputState;
 };
 
+// For save states. The buttons held belong to the frontend, not the
+// emulated system, so they aren't included.
+struct KeypadState
+{
+    uint8_t p1;
+};
+
 
 void keypad_init(struct Keypad *keypad, struct InputState *inputState, struct Cpu *cpu, struct Memory *memory);
 void keypad_tick(struct Keypad *keypad);
 
+void keypad_save_state(const struct Keypad *keypad, struct KeypadState *state);
+void keypad_load_state(struct Keypad *keypad, const struct KeypadState *state);
+
 
 #endif
@@ -7,6 +7,14 @@
 #define LCD_HEIGHT  144
 
 
+// The colors the four shades are shown in, chosen by the frontend
+enum LcdPalette
+{
+    LCD_PALETTE_GRAY = 0,
+    LCD_PALETTE_GREEN = 1,
+};
+
+
 #define LCD_COLOR_GREEN_LIGHTEST_R  224
 #define LCD_COLOR_GREEN_LIGHTEST_G  248
 #define LCD_COLOR_GREEN_LIGHTEST_B  208
@@ -41,41 +49,4 @@
 #define LCD_COLOR_GRAY_DARKEST_B    16
 
 
-#if LCD_GRAY
-#define LCD_COLOR_LIGHTEST_R  LCD_COLOR_GRAY_LIGHTEST_R
-#define LCD_COLOR_LIGHTEST_G  LCD_COLOR_GRAY_LIGHTEST_G
-#define LCD_COLOR_LIGHTEST_B  LCD_COLOR_GRAY_LIGHTEST_B
-
-#define LCD_COLOR_LIGHTER_R   LCD_COLOR_GRAY_LIGHTER_R
-#define LCD_COLOR_LIGHTER_G   LCD_COLOR_GRAY_LIGHTER_G
-#define LCD_COLOR_LIGHTER_B   LCD_COLOR_GRAY_LIGHTER_B
-
-#define LCD_COLOR_DARKER_R    LCD_COLOR_GRAY_DARKER_R
-#define LCD_COLOR_DARKER_G    LCD_COLOR_GRAY_DARKER_G
-#define LCD_COLOR_DARKER_B    LCD_COLOR_GRAY_DARKER_B
-
-#define LCD_COLOR_DARKEST_R   LCD_COLOR_GRAY_DARKEST_R
-#define LCD_COLOR_DARKEST_G   LCD_COLOR_GRAY_DARKEST_G
-#define LCD_COLOR_DARKEST_B   LCD_COLOR_GRAY_DARKEST_B
-
-#else
-
-#define LCD_COLOR_LIGHTEST_R  LCD_COLOR_GREEN_LIGHTEST_R
-#define LCD_COLOR_LIGHTEST_G  LCD_COLOR_GREEN_LIGHTEST_G
-#define LCD_COLOR_LIGHTEST_B  LCD_COLOR_GREEN_LIGHTEST_B
-
-#define LCD_COLOR_LIGHTER_R   LCD_COLOR_GREEN_LIGHTER_R
-#define LCD_COLOR_LIGHTER_G   LCD_COLOR_GREEN_LIGHTER_G
-#define LCD_COLOR_LIGHTER_B   LCD_COLOR_GREEN_LIGHTER_B
-
-#define LCD_COLOR_DARKER_R    LCD_COLOR_GREEN_DARKER_R
-#define LCD_COLOR_DARKER_G    LCD_COLOR_GREEN_DARKER_G
-#define LCD_COLOR_DARKER_B    LCD_COLOR_GREEN_DARKER_B
-
-#define LCD_COLOR_DARKEST_R   LCD_COLOR_GREEN_DARKEST_R
-#define LCD_COLOR_DARKEST_G   LCD_COLOR_GREEN_DARKEST_G
-#define LCD_COLOR_DARKEST_B   LCD_COLOR_GREEN_DARKEST_B
-#endif
-
-
 #endif
@@ -0,0 +1,187 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libgameboy.h"
+#include "gameboy.h"
+#include "cartridge.h"
+#include "save_state.h"
+
+
+_Static_assert(GB_FRAMEBUFFER_WIDTH == LCD_WIDTH, "framebuffer width must match the LCD");
+_Static_assert(GB_FRAMEBUFFER_HEIGHT == LCD_HEIGHT, "framebuffer height must match the LCD");
+
+
+struct GbEmulator
+{
+    struct GameBoy gameBoy;
+    struct Cartridge cartridge;
+    bool romLoaded;
+
+    // Kept so that it survives loading a new ROM
+    uint8_t buttons;
+
+    // Filled in by gb_get_framebuffer
+    uint8_t framebuffer[GB_FRAMEBUFFER_BYTES_PER_PIXEL * LCD_WIDTH * LCD_HEIGHT];
+};
+
+
+static void apply_input(struct GbEmulator *gb)
+{
+    struct InputState *input = &gb->gameBoy.inputState;
+    input->buttonA = (gb->buttons & GB_BUTTON_A) != 0;
+    input->buttonB = (gb->buttons & GB_BUTTON_B) != 0;
+    input->buttonSelect = (gb->buttons & GB_BUTTON_SELECT) != 0;
+    input->buttonStart = (gb->buttons & GB_BUTTON_START) != 0;
+    input->dpadRight = (gb->buttons & GB_DPAD_RIGHT) != 0;
+    input->dpadLeft = (gb->buttons & GB_DPAD_LEFT) != 0;
+    input->dpadUp = (gb->buttons & GB_DPAD_UP) != 0;
+    input->dpadDown = (gb->buttons & GB_DPAD_DOWN) != 0;
+
+    // Raise the keypad interrupt now rather than waiting for a frontend
+    // to tick the keypad at the end of the frame
+    keypad_tick(&gb->gameBoy.keypad);
+}
+
+
+struct GbEmulator* gb_create(void)
+{
+    // Far too large for the caller's stack, and must not move once running
+    struct GbEmulator *gb = calloc(1, sizeof(*gb));
+    if (gb == NULL)
+    {
+        return NULL;
+    }
+    gb->romLoaded = false;
+    gb->buttons = 0;
+    return gb;
+}
+
+
+void gb_destroy(struct GbEmulator *gb)
+{
+    if (gb == NULL)
+    {
+        return;
+    }
+    if (gb->romLoaded)
+    {
+        gameboy_teardown(&gb->gameBoy);
+        cartridge_teardown(&gb->cartridge);
+    }
+    free(gb);
+}
+
+
+static void unload_rom(struct GbEmulator *gb)
+{
+    if (gb->romLoaded)
+    {
+        gameboy_teardown(&gb->gameBoy);
+        cartridge_teardown(&gb->cartridge);
+        gb->romLoaded = false;
+    }
+}
+
+
+// Takes ownership of the cartridge whether or not it succeeds
+static bool power_on(struct GbEmulator *gb)
+{
+    gb->romLoaded = gameboy_init(&gb->gameBoy, &gb->cartridge, false);
+    if ( ! gb->romLoaded)
+    {
+        cartridge_teardown(&gb->cartridge);
+        return false;
+    }
+    apply_input(gb);
+    return true;
+}
+
+
+bool gb_load_rom_from_memory(struct GbEmulator *gb, const void *data, size_t dataSize)
+{
+    unload_rom(gb);
+    if ( ! cartridge_load_from_memory(&gb->cartridge, data, dataSize))
+    {
+        cartridge_teardown(&gb->cartridge);
+        return false;
+    }
+    return power_on(gb);
+}
+
+
+bool gb_load_rom_shared(struct GbEmulator *gb, const void *data, size_t dataSize)
+{
+    unload_rom(gb);
+    if ( ! cartridge_load_shared(&gb->cartridge, data, dataSize))
+    {
+        return false;
+    }
+    return power_on(gb);
+}
+
+
+bool gb_run_frame(struct GbEmulator *gb)
+{
+    return gb->romLoaded && gameboy_run_frame(&gb->gameBoy);
+}
+
+
+bool gb_run_cycles(struct GbEmulator *gb, uint64_t cycles)
+{
+    return gb->romLoaded && gameboy_run_cycles(&gb->gameBoy, cycles);
+}
+
+
+void gb_set_input(struct GbEmulator *gb, uint8_t buttons)
+{
+    gb->buttons = buttons;
+    if (gb->romLoaded)
+    {
+        apply_input(gb);
+    }
+}
+
+
+size_t gb_save_state_size(const struct GbEmulator *gb)
+{
+    return gb->romLoaded ? gameboy_save_state_size(&gb->gameBoy) : 0;
+}
+
+
+bool gb_save_state(const struct GbEmulator *gb, void *buffer, size_t bufferSize)
+{
+    return gb->romLoaded && gameboy_save_state(&gb->gameBoy, buffer, bufferSize);
+}
+
+
+bool gb_load_state(struct GbEmulator *gb, const void *buffer, size_t bufferSize)
+{
+    if ( ! gb->romLoaded || ! gameboy_load_state(&gb->gameBoy, buffer, bufferSize))
+    {
+        return false;
+    }
+
+    // The buttons held belong to the host, not the state
+    apply_input(gb);
+    return true;
+}
+
+const uint8_t* gb_get_framebuffer(struct GbEmulator *gb)
+{
+    // The PPU isn't set up until a ROM loads
+    if (gb->romLoaded)
+    {
+        ppu_expand_pixels(&gb->gameBoy.ppu, gb->framebuffer);
+    }
+    else
+    {
+        memset(gb->framebuffer, 0, sizeof(gb->framebuffer));
+    }
+    return gb->framebuffer;
+}
+
+const uint8_t* gb_get_shades(const struct GbEmulator *gb)
+{
+    return gb->gameBoy.pixelBuffer;
+}
@@ -0,0 +1,129 @@
+
+#ifndef LIBGAMEBOY_H
+#define LIBGAMEBOY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Public interface for embedding the emulator in another program, built
+// as libgameboy.so and libgameboy.a. Each emulator is independent, so a
+// host can run many of them in one process (one thread per emulator at a
+// time). Nothing else in src/ is exported from the shared library.
+
+#if defined(__GNUC__)
+#define GB_API  __attribute__((visibility("default")))
+#else
+#define GB_API
+#endif
+
+
+#define GB_FRAMEBUFFER_WIDTH   160
+#define GB_FRAMEBUFFER_HEIGHT  144
+
+// Pixels are stored as B, G, R, A bytes (ARGB8888 on little endian hosts)
+#define GB_FRAMEBUFFER_BYTES_PER_PIXEL  4
+
+// Machine cycles (1.048576 MHz)
+#define GB_CYCLES_PER_SECOND  1048576
+#define GB_CYCLES_PER_FRAME   17556
+
+// Bits for gb_set_input
+#define GB_BUTTON_A       (1 << 0)
+#define GB_BUTTON_B       (1 << 1)
+#define GB_BUTTON_SELECT  (1 << 2)
+#define GB_BUTTON_START   (1 << 3)
+#define GB_DPAD_RIGHT     (1 << 4)
+#define GB_DPAD_LEFT      (1 << 5)
+#define GB_DPAD_UP        (1 << 6)
+#define GB_DPAD_DOWN      (1 << 7)
+
+
+struct GbEmulator;
+
+// Returns NULL if out of memory. A ROM must be loaded before running.
+GB_API struct GbEmulator* gb_create(void);
+GB_API void gb_destroy(struct GbEmulator *gb);
+
+// Powers on with the given ROM image, which is copied. Loading another ROM
+// (or the same one again) starts over from power on. Returns false if the
+// image is too small or too large.
+GB_API bool gb_load_rom_from_memory(struct GbEmulator *gb, const void *data, size_t dataSize);
+
+// Like gb_load_rom_from_memory, but the ROM image is used in place rather
+// than copied, so any number of emulators can share it (e.g. from mmap).
+// It must stay valid and unchanged until every emulator using it has been
+// destroyed or loaded another ROM.
+GB_API bool gb_load_rom_shared(struct GbEmulator *gb, const void *data, size_t dataSize);
+
+// Both return false if no ROM is loaded or the CPU can't continue (e.g. it
+// hit an unimplemented instruction).
+GB_API bool gb_run_frame(struct GbEmulator *gb);
+GB_API bool gb_run_cycles(struct GbEmulator *gb, uint64_t cycles);
+
+// Buttons held from now on, as a combination of GB_BUTTON_* and GB_DPAD_*
+GB_API void gb_set_input(struct GbEmulator *gb, uint8_t buttons);
+
+// Save states hold the whole machine except the framebuffer, and are only
+// loaded into an emulator running the same ROM. Saving and loading copy
+// into and out of the caller's buffer without allocating anything, so
+// they're cheap enough to restart from a checkpoint every episode. The
+// buffer must be aligned like malloc's. All of these fail (returning 0 or
+// false) if no ROM is loaded.
+GB_API size_t gb_save_state_size(const struct GbEmulator *gb);
+GB_API bool gb_save_state(const struct GbEmulator *gb, void *buffer, size_t bufferSize);
+GB_API bool gb_load_state(struct GbEmulator *gb, const void *buffer, size_t bufferSize);
+
+// GB_FRAMEBUFFER_HEIGHT rows of GB_FRAMEBUFFER_WIDTH pixels. The emulator
+// only stores shades, so each call converts the lines drawn so far to
+// colors. All zero while no ROM is loaded. The pointer stays valid until
+// gb_destroy.
+GB_API const uint8_t* gb_get_framebuffer(struct GbEmulator *gb);
+
+// The same pixels as one byte each, from 0 (lightest) to 3 (darkest), as
+// they are drawn, without any conversion. The pointer stays valid until
+// gb_destroy; lines are drawn into it as the PPU renders.
+GB_API const uint8_t* gb_get_shades(const struct GbEmulator *gb);
+
+
+
+// A batch of independent emulators, all stepped one frame at a time by a
+// pool of worker threads. Each emulator must only be used through the
+// batch while a gb_batch_run_frame call is in progress.
+struct GbBatch;
+
+// numThreads includes the calling thread; 0 means one per CPU. Returns
+// NULL if numEmulators is 0 or the batch couldn't be created.
+GB_API struct GbBatch* gb_batch_create(size_t numEmulators, size_t numThreads);
+GB_API void gb_batch_destroy(struct GbBatch *batch);
+
+GB_API size_t gb_batch_size(const struct GbBatch *batch);
+
+// For loading different ROMs or setting up individual emulators.
+// Returns NULL if the index is out of range.
+GB_API struct GbEmulator* gb_batch_get_emulator(struct GbBatch *batch, size_t index);
+
+// Loads the same ROM into every emulator. The batch keeps one copy that
+// all of them share.
+GB_API bool gb_batch_load_rom_from_memory(struct GbBatch *batch, const void *data, size_t dataSize);
+
+// Runs every emulator for one frame. buttons holds one gb_set_input value
+// per emulator, or is NULL to keep the previous values. Returns false if
+// any emulator failed to run.
+GB_API bool gb_batch_run_frame(struct GbBatch *batch, const uint8_t *buttons);
+
+// One byte of gray intensity per pixel, as a contiguous
+// [gb_batch_size][GB_FRAMEBUFFER_HEIGHT][GB_FRAMEBUFFER_WIDTH] array.
+// Updated by each gb_batch_run_frame and valid until gb_batch_destroy.
+GB_API const uint8_t* gb_batch_get_frames(const struct GbBatch *batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,319 @@
+
+// Needed for sysconf(_SC_NPROCESSORS_ONLN)
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "libgameboy.h"
+#include "lcd.h"
+
+
+// A fixed pool of worker threads steps every emulator by one frame per
+// call. Emulators are handed out one at a time from a shared counter, so
+// the work balances itself when some take longer than others (e.g. one
+// is in a tight loop while another is halted). The calling thread works
+// too, and waits for the last emulator to finish before returning.
+
+struct GbBatch
+{
+    size_t numEmulators;
+    struct GbEmulator **emulators;
+
+    // Shared by every emulator, from gb_batch_load_rom_from_memory
+    uint8_t *rom;
+    uint8_t *buttons;
+
+    // Whether each emulator failed to run during the last frame
+    bool *failed;
+
+    // numEmulators x GB_FRAMEBUFFER_HEIGHT x GB_FRAMEBUFFER_WIDTH
+    uint8_t *frames;
+
+    size_t numWorkers;
+    pthread_t *workers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workReady;
+    pthread_cond_t workDone;
+
+    // Incremented (under the mutex) each time work is handed out
+    uint64_t generation;
+    bool quit;
+
+    atomic_size_t nextEmulator;
+    atomic_size_t numRemaining;
+};
+
+
+#define FRAME_SIZE  (GB_FRAMEBUFFER_WIDTH * GB_FRAMEBUFFER_HEIGHT)
+
+static void run_emulator(struct GbBatch *batch, size_t index)
+{
+    struct GbEmulator *gb = batch->emulators[index];
+    gb_set_input(gb, batch->buttons[index]);
+    batch->failed[index] = ! gb_run_frame(gb);
+
+    // The intensity of each shade in the gray palette, looked up straight
+    // from the shades without converting them to colors first
+    static const uint8_t GRAY_INTENSITIES[4] = {
+        LCD_COLOR_GRAY_LIGHTEST_G,
+        LCD_COLOR_GRAY_LIGHTER_G,
+        LCD_COLOR_GRAY_DARKER_G,
+        LCD_COLOR_GRAY_DARKEST_G,
+    };
+    const uint8_t *shades = gb_get_shades(gb);
+    uint8_t *frame = &batch->frames[index * FRAME_SIZE];
+    for (size_t i = 0; i < FRAME_SIZE; i++)
+    {
+        frame[i] = GRAY_INTENSITIES[shades[i]];
+    }
+}
+
+
+// Returns once no more emulators are waiting to be run
+static void run_emulators(struct GbBatch *batch)
+{
+    while (true)
+    {
+        size_t index = atomic_fetch_add(&batch->nextEmulator, 1);
+        if (index >= batch->numEmulators)
+        {
+            return;
+        }
+        run_emulator(batch, index);
+
+        if (atomic_fetch_sub(&batch->numRemaining, 1) == 1)
+        {
+            pthread_mutex_lock(&batch->mutex);
+            pthread_cond_signal(&batch->workDone);
+            pthread_mutex_unlock(&batch->mutex);
+        }
+    }
+}
+
+
+static void* worker_main(void *arg)
+{
+    struct GbBatch *batch = arg;
+    uint64_t lastGeneration = 0;
+
+    pthread_mutex_lock(&batch->mutex);
+    while (true)
+    {
+        while ( ! batch->quit && batch->generation == lastGeneration)
+        {
+            pthread_cond_wait(&batch->workReady, &batch->mutex);
+        }
+        if (batch->quit)
+        {
+            break;
+        }
+        lastGeneration = batch->generation;
+
+        pthread_mutex_unlock(&batch->mutex);
+        run_emulators(batch);
+        pthread_mutex_lock(&batch->mutex);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+    return NULL;
+}
+
+
+static void stop_workers(struct GbBatch *batch, size_t numStarted)
+{
+    pthread_mutex_lock(&batch->mutex);
+    batch->quit = true;
+    pthread_cond_broadcast(&batch->workReady);
+    pthread_mutex_unlock(&batch->mutex);
+
+    for (size_t i = 0; i < numStarted; i++)
+    {
+        pthread_join(batch->workers[i], NULL);
+    }
+}
+
+
+struct GbBatch* gb_batch_create(size_t numEmulators, size_t numThreads)
+{
+    if (numEmulators == 0)
+    {
+        return NULL;
+    }
+    if (numThreads == 0)
+    {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = (numCpus > 0) ? (size_t)numCpus : 1;
+    }
+    if (numThreads > numEmulators)
+    {
+        numThreads = numEmulators;
+    }
+
+    struct GbBatch *batch = calloc(1, sizeof(*batch));
+    if (batch == NULL)
+    {
+        return NULL;
+    }
+    batch->numEmulators = numEmulators;
+    batch->numWorkers = numThreads - 1;
+    batch->generation = 0;
+    batch->quit = false;
+    atomic_init(&batch->nextEmulator, numEmulators);
+    atomic_init(&batch->numRemaining, 0);
+
+    batch->emulators = calloc(numEmulators, sizeof(batch->emulators[0]));
+    batch->buttons = calloc(numEmulators, sizeof(batch->buttons[0]));
+    batch->failed = calloc(numEmulators, sizeof(batch->failed[0]));
+    batch->frames = calloc(numEmulators, FRAME_SIZE);
+    batch->workers = calloc(batch->numWorkers, sizeof(batch->workers[0]));
+    if (batch->emulators == NULL || batch->buttons == NULL || batch->failed == NULL || batch->frames == NULL || (batch->numWorkers > 0 && batch->workers == NULL))
+    {
+        goto cleanup_arrays;
+    }
+
+    for (size_t i = 0; i < numEmulators; i++)
+    {
+        batch->emulators[i] = gb_create();
+        if (batch->emulators[i] == NULL)
+        {
+            goto cleanup_emulators;
+        }
+    }
+
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_cond_init(&batch->workReady, NULL);
+    pthread_cond_init(&batch->workDone, NULL);
+    for (size_t i = 0; i < batch->numWorkers; i++)
+    {
+        if (pthread_create(&batch->workers[i], NULL, worker_main, batch) != 0)
+        {
+            stop_workers(batch, i);
+            goto cleanup_threading;
+        }
+    }
+
+    return batch;
+
+cleanup_threading:
+    pthread_cond_destroy(&batch->workDone);
+    pthread_cond_destroy(&batch->workReady);
+    pthread_mutex_destroy(&batch->mutex);
+cleanup_emulators:
+    for (size_t i = 0; i < numEmulators; i++)
+    {
+        gb_destroy(batch->emulators[i]);
+    }
+cleanup_arrays:
+    free(batch->workers);
+    free(batch->frames);
+    free(batch->failed);
+    free(batch->buttons);
+    free(batch->emulators);
+    free(batch);
+    return NULL;
+}
+
+
+void gb_batch_destroy(struct GbBatch *batch)
+{
+    if (batch == NULL)
+    {
+        return;
+    }
+
+    stop_workers(batch, batch->numWorkers);
+    pthread_cond_destroy(&batch->workDone);
+    pthread_cond_destroy(&batch->workReady);
+    pthread_mutex_destroy(&batch->mutex);
+
+    for (size_t i = 0; i < batch->numEmulators; i++)
+    {
+        gb_destroy(batch->emulators[i]);
+    }
+    free(batch->rom);
+    free(batch->workers);
+    free(batch->frames);
+    free(batch->failed);
+    free(batch->buttons);
+    free(batch->emulators);
+    free(batch);
+}
+
+
+size_t gb_batch_size(const struct GbBatch *batch)
+{
+    return batch->numEmulators;
+}
+
+
+struct GbEmulator* gb_batch_get_emulator(struct GbBatch *batch, size_t index)
+{
+    return (index < batch->numEmulators) ? batch->emulators[index] : NULL;
+}
+
+
+bool gb_batch_load_rom_from_memory(struct GbBatch *batch, const void *data, size_t dataSize)
+{
+    uint8_t *rom = malloc(dataSize);
+    if (rom == NULL)
+    {
+        return false;
+    }
+    memcpy(rom, data, dataSize);
+
+    bool success = true;
+    for (size_t i = 0; i < batch->numEmulators; i++)
+    {
+        success = gb_load_rom_shared(batch->emulators[i], rom, dataSize) && success;
+    }
+
+    // Nothing refers to the old ROM any more
+    free(batch->rom);
+    batch->rom = rom;
+    return success;
+}
+
+
+bool gb_batch_run_frame(struct GbBatch *batch, const uint8_t *buttons)
+{
+    if (buttons != NULL)
+    {
+        memcpy(batch->buttons, buttons, batch->numEmulators * sizeof(batch->buttons[0]));
+    }
+
+    // Reset the counters before waking anyone, so no worker can see a
+    // stale count for the new generation
+    atomic_store(&batch->numRemaining, batch->numEmulators);
+    atomic_store(&batch->nextEmulator, 0);
+
+    pthread_mutex_lock(&batch->mutex);
+    batch->generation += 1;
+    pthread_cond_broadcast(&batch->workReady);
+    pthread_mutex_unlock(&batch->mutex);
+
+    run_emulators(batch);
+
+    pthread_mutex_lock(&batch->mutex);
+    while (atomic_load(&batch->numRemaining) > 0)
+    {
+        pthread_cond_wait(&batch->workDone, &batch->mutex);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+
+    bool success = true;
+    for (size_t i = 0; i < batch->numEmulators; i++)
+    {
+        success = success && ! batch->failed[i];
+    }
+    return success;
+}
+
+
+const uint8_t* gb_batch_get_frames(const struct GbBatch *batch)
+{
+    return batch->frames;
+}
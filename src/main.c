@@ -8,13 +8,9 @@
 #include "input.h"
 #include "graphics.h"
 #include "cartridge.h"
-#include "memory.h"
-#include "cpu.h"
-#include "ppu.h"
-#include "keypad.h"
-#include "dma.h"
-#include "timer.h"
-#include "serial.h"
+#include "gameboy.h"
+#include "rewind_buffer.h"
+#include "movie.h"
 
 
 static void dump_memory(struct Memory *memory)
@@ -48,6 +44,80 @@ static void teardown_serial_log_file(FILE* file)
 }
 
 
+// The GameBoy LCD refreshes at (very nearly) 60Hz
+#define FRAMES_PER_SECOND  60
+
+// If the host can't keep up for this long, stop trying to catch up
+#define MAX_FRAME_LAG_MS  100
+
+// Keeps emulation at a multiple of real time. Deadlines are measured from
+// when pacing started rather than from the previous frame, so rounding
+// errors from millisecond timers don't accumulate.
+struct FramePacer
+{
+    int speed;
+    uint32_t startTime;
+    uint32_t numFrames;
+};
+
+static void frame_pacer_reset(struct FramePacer *pacer, int speed)
+{
+    pacer->speed = speed;
+    pacer->startTime = SDL_GetTicks();
+    pacer->numFrames = 0;
+}
+
+static void frame_pacer_wait(struct FramePacer *pacer, int speed)
+{
+    if (speed != pacer->speed)
+    {
+        frame_pacer_reset(pacer, speed);
+    }
+    if (speed == OPTIONS_SPEED_UNCAPPED)
+    {
+        return;
+    }
+
+    pacer->numFrames += 1;
+    uint32_t elapsedMs = (uint32_t)((uint64_t)pacer->numFrames * 1000 / (uint64_t)(FRAMES_PER_SECOND * speed));
+    uint32_t targetTime = pacer->startTime + elapsedMs;
+    uint32_t now = SDL_GetTicks();
+    if ((int32_t)(targetTime - now) > 0)
+    {
+        SDL_Delay(targetTime - now);
+    }
+    else if (now - targetTime > MAX_FRAME_LAG_MS)
+    {
+        frame_pacer_reset(pacer, speed);
+    }
+}
+
+
+// Call after each input update. Ends the movie if it's finished playing or
+// can't be written, leaving the keyboard in control.
+static void update_movie(struct Movie *movie, struct InputState *input)
+{
+    if (movie->file == NULL)
+    {
+        return;
+    }
+
+    if (movie->recording)
+    {
+        if ( ! movie_record_input(movie, input))
+        {
+            fprintf(stderr, "error: failed to write the movie file, recording stopped \n");
+            movie_teardown(movie);
+        }
+    }
+    else if ( ! movie_play_input(movie, input))
+    {
+        printf("Movie finished after %llu frames \n", (unsigned long long)movie->frame);
+        movie_teardown(movie);
+    }
+}
+
+
 static bool sigint_caught = false;
 static void signal_handler(sig_atomic_t sig)
 {
@@ -82,7 +152,7 @@ int main(int argc, char **argv)
     }
 
     struct Cartridge cartridge;
-    if ( ! cartridge_load(&cartridge, argv[1]))
+    if ( ! cartridge_load(&cartridge, options.romPath))
     {
         fprintf(stderr, "error: failed to load the cartridge! \n");
         statusCode = 1;
@@ -90,21 +160,18 @@ int main(int argc, char **argv)
     }
 
     struct CartridgeHeader cartridgeHeader;
-    cartridge_get_header(&cartridge, &cartridgeHeader);
-    char cartridgeTypeStringBuffer[64];
-    cartridge_get_type_string(&cartridgeHeader, cartridgeTypeStringBuffer, sizeof(cartridgeTypeStringBuffer));
-    printf("Loaded ROM \"%s\" (%ld bytes) (%s)\n", cartridgeHeader.title, cartridge.dataSize, cartridgeTypeStringBuffer);
-
-    struct Memory memory;
-    if ( ! memory_init(&memory, &cartridge))
+    if ( ! cartridge_get_header(&cartridge, &cartridgeHeader))
     {
-        fprintf(stderr, "error: failed to create the memory mapper! \n");
+        fprintf(stderr, "error: unsupported cartridge type 0x%02x \n", cartridgeHeader.typeCode);
         statusCode = 1;
-        goto cleanup_memory;
+        goto cleanup_cartridge;
     }
+    char cartridgeTypeStringBuffer[64];
+    cartridge_get_type_string(&cartridgeHeader, cartridgeTypeStringBuffer, sizeof(cartridgeTypeStringBuffer));
+    printf("Loaded ROM \"%s\" (%ld bytes) (%s)\n", cartridgeHeader.title, cartridge.dataSize, cartridgeTypeStringBuffer);
 
     // TODO: Headless mode affects graphics output AND the input system.
-    // Basically we can't use SDL at all.
+    // Basically we can't use SDL at all. (Use emulator_headless instead.)
 
     struct Graphics graphics;
     if ( ! graphics_init(&graphics, &options.graphics))
@@ -114,92 +181,128 @@ int main(int argc, char **argv)
         goto cleanup_graphics;
     }
 
-    struct Ppu ppu;
-    ppu_init(&ppu, &memory);
-
-    struct Cpu cpu;
-    cpu_init(&cpu, &memory);
+    // The subsystems are large and refer to each other, so they live in
+    // static storage rather than on the stack.
+    static struct GameBoy gameBoy;
+    static uint8_t pixels[4 * LCD_WIDTH * LCD_HEIGHT];
+    if ( ! gameboy_init(&gameBoy, &cartridge, options.jit))
+    {
+        fprintf(stderr, "error: failed to create the memory mapper! \n");
+        statusCode = 1;
+        goto cleanup_graphics;
+    }
+    ppu_set_lcd_palette(&gameBoy.ppu, options.palette);
 
-    struct Dma dma;
-    dma_init(&dma, &memory);
+    struct Movie movie;
+    movie.file = NULL;
+    if (options.recordMoviePath != NULL && ! movie_init_recording(&movie, options.recordMoviePath, &cartridge))
+    {
+        fprintf(stderr, "error: failed to create the movie file \n");
+        statusCode = 1;
+        goto cleanup_gameboy;
+    }
+    if (options.playMoviePath != NULL && ! movie_init_playback(&movie, options.playMoviePath, &cartridge))
+    {
+        fprintf(stderr, "error: failed to open the movie file, or it was recorded with a different ROM \n");
+        statusCode = 1;
+        goto cleanup_gameboy;
+    }
 
-    struct Timer timer;
-    timer_init(&timer, &memory);
+    struct RewindBuffer *rewindBuffer = NULL;
+    if (options.rewindBufferMiB > 0)
+    {
+        rewindBuffer = rewind_buffer_create(&gameBoy, options.rewindBufferMiB << 20, (size_t)options.rewindInterval);
+        if (rewindBuffer == NULL)
+        {
+            fprintf(stderr, "warning: failed to create the rewind buffer, rewinding is disabled \n");
+        }
+    }
 
-    struct Serial serial;
-    serial_init(&serial, &memory);
+    input_update(&gameBoy.inputState);
+    update_movie(&movie, &gameBoy.inputState);
 
-    struct InputState inputState;
-    input_update(&inputState);
+    // Above 1x the emulator produces frames faster than the display can
+    // show them, so only present one per display refresh
+    uint32_t presentIntervalMs = 1000 / (uint32_t)graphics_get_refresh_rate(&graphics);
+    uint32_t lastPresentTime = SDL_GetTicks();
 
-    struct Keypad keypad;
-    keypad_init(&keypad, &inputState, &cpu, &memory);
+    struct FramePacer pacer;
+    frame_pacer_reset(&pacer, options.speed);
 
-    uint32_t frameStartTime = SDL_GetTicks();
     bool isRunning = true;
     while (isRunning)
     {
-        if ( ! cpu_execute_next(&cpu))
+        if ( ! gameboy_step(&gameBoy))
         {
             isRunning = false;
         }
 
-        int instructionCycles = 1;  // TODO: accurate number of cycles for each instruction
-        keypad_tick(&keypad);
-        dma_tick(&dma, instructionCycles);
-        timer_tick(&timer, &cpu, instructionCycles);
-
-        bool enteringVBlank = ppu_tick(&ppu, &cpu, instructionCycles, graphics.pixelBuffer);
-
-        bool serialTransferComplete = serial_tick(&serial, &cpu, instructionCycles);
-        if (serialTransferComplete && serialLogFile != NULL)
+        struct Serial *serial = &gameBoy.serial;
+        if (serial->transferComplete && serialLogFile != NULL)
         {
             // Flush the output immediately so that test scripts watching
             // the output know when the test completes.
-            fwrite(&serial.outgoingData, sizeof(serial.outgoingData), 1, serialLogFile);
+            fwrite(&serial->outgoingData, sizeof(serial->outgoingData), 1, serialLogFile);
             fflush(serialLogFile);
         }
+        serial->transferComplete = false;
 
-        if (inputState.quit || sigint_caught)
+        if (gameBoy.inputState.quit || sigint_caught)
         {
             isRunning = false;
         }
-        if (inputState.dumpMemory)
-        {
-            dump_memory(&memory);
-        }
 
-        if (enteringVBlank)
+        if (gameBoy.ppu.frameComplete)
         {
-            // TODO: Provide a recorded input system for headless mode
-            //   (although could also be useful for non-headless demos)
+            gameBoy.ppu.frameComplete = false;
+
+            if (gameBoy.inputState.dumpMemory)
+            {
+                dump_memory(&gameBoy.memory);
+            }
+
             if ( ! options.graphics.headless)
             {
-                input_update(&inputState);
+                input_update(&gameBoy.inputState);
+            }
+            update_movie(&movie, &gameBoy.inputState);
+            keypad_tick(&gameBoy.keypad);
+
+            if (rewindBuffer != NULL)
+            {
+                // Each frame with the key held goes back one snapshot.
+                // Jumping back would throw a movie out of sync with the
+                // emulator, so it's ignored while one is in progress.
+                if (gameBoy.inputState.rewind && movie.file == NULL)
+                {
+                    rewind_buffer_step_back(rewindBuffer, &gameBoy);
+                }
+                else
+                {
+                    rewind_buffer_record_frame(rewindBuffer, &gameBoy);
+                }
             }
 
-            graphics_update(&graphics);
+            int speed = gameBoy.inputState.turbo ? OPTIONS_SPEED_UNCAPPED : options.speed;
 
-            uint32_t frameMs = SDL_GetTicks() - frameStartTime;
-            uint32_t targetMs = 1000 / 60;
-            if (targetMs > frameMs)
+            uint32_t now = SDL_GetTicks();
+            if (speed == 1 || now - lastPresentTime >= presentIntervalMs)
             {
-                SDL_Delay(targetMs - frameMs);
+                ppu_expand_pixels(&gameBoy.ppu, pixels);
+                graphics_update(&graphics, pixels);
+                lastPresentTime = now;
             }
 
-            // TODO: Add flag for turning diagnostics like this on and off
-            // frameMs = SDL_GetTicks() - frameStartTime;
-            // {
-            //     printf("frame took %d ms \n", frameMs);
-            // }
-            frameStartTime = SDL_GetTicks();
+            frame_pacer_wait(&pacer, speed);
         }
     }
 
+    rewind_buffer_destroy(rewindBuffer);
+cleanup_gameboy:
+    movie_teardown(&movie);
+    gameboy_teardown(&gameBoy);
 cleanup_graphics:
     graphics_teardown(&graphics);
-cleanup_memory:
-    memory_teardown(&memory);
 cleanup_cartridge:
     cartridge_teardown(&cartridge);
 cleanup_serial:
@@ -0,0 +1,143 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+
+#include "options.h"
+#include "cartridge.h"
+#include "gameboy.h"
+#include "movie.h"
+
+
+// Runs the emulator as fast as possible without a display, for automated
+// tests and benchmarks. Unlike the regular emulator, it doesn't depend on
+// SDL at all. The --headless option is implied, and --small, --speed and
+// the rewind options are ignored. There's no keyboard, so the only input
+// comes from --play-movie, and running stops at the end of the movie.
+
+
+static bool sigint_caught = false;
+static void signal_handler(sig_atomic_t sig)
+{
+    if (sig == SIGINT)
+    {
+        sigint_caught = true;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    signal(SIGINT, signal_handler);
+
+    struct Options options;
+    int statusCode = parse_options(argc, argv, &options);
+    if (statusCode != 0 || options.exitEarly)
+    {
+        return statusCode;
+    }
+    if (options.recordMoviePath != NULL)
+    {
+        fprintf(stderr, "error: there's no input to record without a display \n");
+        return 1;
+    }
+
+    FILE *serialLogFile = NULL;
+    if (options.serialOutPath != NULL)
+    {
+        serialLogFile = fopen(options.serialOutPath, "wb");
+        if (serialLogFile == NULL)
+        {
+            statusCode = 1;
+            fprintf(stderr, "error: failed to open serial log file \n");
+            goto cleanup_serial;
+        }
+    }
+
+    struct Cartridge cartridge;
+    if ( ! cartridge_load(&cartridge, options.romPath))
+    {
+        fprintf(stderr, "error: failed to load the cartridge! \n");
+        statusCode = 1;
+        goto cleanup_cartridge;
+    }
+
+    struct CartridgeHeader cartridgeHeader;
+    if ( ! cartridge_get_header(&cartridge, &cartridgeHeader))
+    {
+        fprintf(stderr, "error: unsupported cartridge type 0x%02x \n", cartridgeHeader.typeCode);
+        statusCode = 1;
+        goto cleanup_cartridge;
+    }
+
+    static struct GameBoy gameBoy;
+    if ( ! gameboy_init(&gameBoy, &cartridge, options.jit))
+    {
+        fprintf(stderr, "error: failed to create the memory mapper! \n");
+        statusCode = 1;
+        goto cleanup_cartridge;
+    }
+
+    struct Movie movie;
+    movie.file = NULL;
+    if (options.playMoviePath != NULL)
+    {
+        if ( ! movie_init_playback(&movie, options.playMoviePath, &cartridge))
+        {
+            fprintf(stderr, "error: failed to open the movie file, or it was recorded with a different ROM \n");
+            statusCode = 1;
+            goto cleanup_gameboy;
+        }
+        movie_play_input(&movie, &gameBoy.inputState);
+    }
+
+    struct timespec startTime;
+    timespec_get(&startTime, TIME_UTC);
+
+    while ( ! sigint_caught)
+    {
+        if ( ! gameboy_step(&gameBoy))
+        {
+            break;
+        }
+
+        struct Serial *serial = &gameBoy.serial;
+        if (serial->transferComplete && serialLogFile != NULL)
+        {
+            // Flush the output immediately so that test scripts watching
+            // the output know when the test completes.
+            fwrite(&serial->outgoingData, sizeof(serial->outgoingData), 1, serialLogFile);
+            fflush(serialLogFile);
+        }
+        serial->transferComplete = false;
+
+        if (gameBoy.ppu.frameComplete)
+        {
+            gameBoy.ppu.frameComplete = false;
+            if (movie.file != NULL && ! movie_play_input(&movie, &gameBoy.inputState))
+            {
+                struct timespec endTime;
+                timespec_get(&endTime, TIME_UTC);
+                double seconds = (double)(endTime.tv_sec - startTime.tv_sec) + (double)(endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+                printf("Movie finished after %llu frames in %.3f seconds \n", (unsigned long long)movie.frame, seconds);
+                break;
+            }
+            keypad_tick(&gameBoy.keypad);
+        }
+    }
+
+cleanup_gameboy:
+    movie_teardown(&movie);
+    gameboy_teardown(&gameBoy);
+
+cleanup_cartridge:
+    cartridge_teardown(&cartridge);
+cleanup_serial:
+    if (serialLogFile != NULL)
+    {
+        fclose(serialLogFile);
+    }
+
+    return statusCode;
+}
@@ -1,49 +1,81 @@
 
 #include <assert.h>  // for assert
 #include <stddef.h>  // for NULL
-#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "memory.h"
 #include "cartridge.h"
 
 
-// TODO: For ROM and RAM, use a "decode-to-pointer" style function
-//   avoid repeating MBC logic?
-
-
-uint8_t memory_read_word(struct Memory *memory, uint16_t address)
+static void map_pages(struct Memory *memory, uint16_t start, uint16_t end, const uint8_t *readBase, uint8_t *writeBase)
 {
-    if (address <= MEMORY_ROM_BANK0_END)
-    {
-        return memory->rom[address - MEMORY_ROM_BANK0_START];
-    }
-    else if (address <= MEMORY_ROM_BANKN_END)
-    {
-        size_t romBankOffset = memory->selectedRomBank * MEMORY_ROM_BANK_SIZE;
-        return memory->rom[address - MEMORY_ROM_BANKN_START + romBankOffset];
-    }
-    else if (address <= MEMORY_VRAM_END)
-    {
-        return memory->vram[address - MEMORY_VRAM_START];
-    }
-    else if (address <= MEMORY_EXTERNAL_RAM_END)
+    assert((start % MEMORY_PAGE_SIZE) == 0);
+    assert((end % MEMORY_PAGE_SIZE) == MEMORY_PAGE_SIZE - 1);
+
+    for (size_t page = start / MEMORY_PAGE_SIZE; page <= end / MEMORY_PAGE_SIZE; page++)
     {
-        return memory->externalRam[address - MEMORY_EXTERNAL_RAM_START];
+        size_t offset = page * MEMORY_PAGE_SIZE - start;
+        memory->readPages[page] = (readBase != NULL) ? readBase + offset : NULL;
+        memory->writePages[page] = (writeBase != NULL) ? writeBase + offset : NULL;
     }
-    else if (address <= MEMORY_WRAM_BANK0_END)
+}
+
+
+static void map_rom_bank_pages(struct Memory *memory)
+{
+    // Writes to ROM are MBC commands, so those always take the slow path
+    size_t romBankOffset = memory->selectedRomBank * MEMORY_ROM_BANK_SIZE;
+    map_pages(memory, MEMORY_ROM_BANKN_START, MEMORY_ROM_BANKN_END, &memory->rom[romBankOffset], NULL);
+}
+
+
+static void map_all_pages(struct Memory *memory)
+{
+    map_pages(memory, MEMORY_ROM_BANK0_START, MEMORY_ROM_BANK0_END, memory->rom, NULL);
+    map_rom_bank_pages(memory);
+
+    // Writes to tile data are tracked, for the PPU's decoded tiles
+    uint8_t *tileMaps = &memory->vram[MEMORY_TILE_MAPS_START - MEMORY_VRAM_START];
+    map_pages(memory, MEMORY_TILE_DATA_START, MEMORY_TILE_DATA_END, memory->vram, NULL);
+    map_pages(memory, MEMORY_TILE_MAPS_START, MEMORY_VRAM_END, tileMaps, tileMaps);
+
+    if (memory->externalRamSize >= MEMORY_EXTERNAL_RAM_SIZE)
     {
-        return memory->wramBank0[address - MEMORY_WRAM_BANK0_START];
+        map_pages(memory, MEMORY_EXTERNAL_RAM_START, MEMORY_EXTERNAL_RAM_END, memory->externalRam, memory->externalRam);
     }
-    else if (address <= MEMORY_WRAM_BANK1_END)
+    else
     {
-        return memory->wramBank1[address - MEMORY_WRAM_BANK1_START];
+        map_pages(memory, MEMORY_EXTERNAL_RAM_START, MEMORY_EXTERNAL_RAM_END, NULL, NULL);
     }
-    else if (address <= MEMORY_WRAM_ECHO_END)
+    map_pages(memory, MEMORY_WRAM_BANK0_START, MEMORY_WRAM_BANK0_END, memory->wramBank0, memory->wramBank0);
+    map_pages(memory, MEMORY_WRAM_BANK1_START, MEMORY_WRAM_BANK1_END, memory->wramBank1, memory->wramBank1);
+
+    // The echo area mirrors 0xc000-0xddff
+    uint16_t echoBank1Start = MEMORY_WRAM_ECHO_START + MEMORY_WRAM_BANK_SIZE;
+    map_pages(memory, MEMORY_WRAM_ECHO_START, echoBank1Start - 1, memory->wramBank0, memory->wramBank0);
+    map_pages(memory, echoBank1Start, MEMORY_WRAM_ECHO_END, memory->wramBank1, memory->wramBank1);
+
+    // OAM shares its page with the unusable area, and high RAM shares its
+    // page with the IO registers
+    map_pages(memory, MEMORY_OAM_START, MEMORY_NOT_USABLE_END, NULL, NULL);
+    map_pages(memory, MEMORY_IO_START, MEMORY_INTERRUPT_ENABLE_REGISTER_ADDRESS, NULL, NULL);
+}
+
+
+// Handles the pages that have no direct mapping
+uint8_t memory_read_word_slow(struct Memory *memory, uint16_t address)
+{
+    if (address <= MEMORY_EXTERNAL_RAM_END)
     {
-        return memory_read_word(memory, address - MEMORY_WRAM_ECHO_START + MEMORY_WRAM_BANK0_START);
+        // Cartridges with less than a full bank of RAM (or none at all)
+        assert(address >= MEMORY_EXTERNAL_RAM_START);
+        size_t offset = address - MEMORY_EXTERNAL_RAM_START;
+        return (offset < memory->externalRamSize) ? memory->externalRam[offset] : 0xff;
     }
     else if (address <= MEMORY_OAM_END)
     {
+        assert(address >= MEMORY_OAM_START);
         return memory->oam[address - MEMORY_OAM_START];
     }
     else if (address <= MEMORY_NOT_USABLE_END)
@@ -73,12 +105,6 @@ static void handle_rom_write(struct Memory *memory, uint16_t address, uint8_t va
 {
     if (memory->cartridgeType & CARTRIDGE_TYPE_MBC1)
     {
-        // TODO
-        (void)address;
-        (void)value;
-        printf("Wrote 0x%02x to ROM address: 0x%04x \n", value, address);
-        // assert(false);
-
         // TODO: Do this properly. This is wrong.
         if (address >= 0x2000 && address <= 0x3fff)
         {
@@ -88,41 +114,55 @@ static void handle_rom_write(struct Memory *memory, uint16_t address, uint8_t va
                 memory->selectedRomBank = 1;
             }
 
-            printf("Selected ROM bank %ld \n", memory->selectedRomBank);
+            // Bank numbers wrap around the ROM size like on the real MBC.
+            // This can map bank 0 into the switchable region.
+            memory->selectedRomBank &= memory->numRomBanks - 1;
+
+            map_rom_bank_pages(memory);
         }
+    }
+}
+
 
+static void mark_all_tiles_dirty(struct Memory *memory)
+{
+    for (size_t i = 0; i < MEMORY_NUM_TILES; i++)
+    {
+        memory->tileDirty[i] = true;
     }
+    memory->tileDataDirty = true;
 }
 
 
-void memory_write_word(struct Memory *memory, uint16_t address, uint8_t value)
+// Handles the pages that have no direct mapping
+void memory_write_word_slow(struct Memory *memory, uint16_t address, uint8_t value)
 {
     if (address <= MEMORY_ROM_BANKN_END)
     {
         handle_rom_write(memory, address, value);
     }
-    else if (address <= MEMORY_VRAM_END)
+    else if (address <= MEMORY_TILE_DATA_END)
     {
-        memory->vram[address - MEMORY_VRAM_START] = value;
+        size_t offset = address - MEMORY_TILE_DATA_START;
+        if (memory->vram[offset] != value)
+        {
+            memory->vram[offset] = value;
+            memory->tileDirty[offset / MEMORY_TILE_SIZE] = true;
+            memory->tileDataDirty = true;
+        }
     }
     else if (address <= MEMORY_EXTERNAL_RAM_END)
     {
-        memory->externalRam[address - MEMORY_EXTERNAL_RAM_START] = value;
-    }
-    else if (address <= MEMORY_WRAM_BANK0_END)
-    {
-        memory->wramBank0[address - MEMORY_WRAM_BANK0_START] = value;
-    }
-    else if (address <= MEMORY_WRAM_BANK1_END)
-    {
-        memory->wramBank1[address - MEMORY_WRAM_BANK1_START] = value;
-    }
-    else if (address <= MEMORY_WRAM_ECHO_END)
-    {
-        memory_write_word(memory, address - MEMORY_WRAM_ECHO_START + MEMORY_WRAM_BANK0_START, value);
+        assert(address >= MEMORY_EXTERNAL_RAM_START);
+        size_t offset = address - MEMORY_EXTERNAL_RAM_START;
+        if (offset < memory->externalRamSize)
+        {
+            memory->externalRam[offset] = value;
+        }
     }
     else if (address <= MEMORY_OAM_END)
     {
+        assert(address >= MEMORY_OAM_START);
         memory->oam[address - MEMORY_OAM_START] = value;
     }
     else if (address <= MEMORY_NOT_USABLE_END)
@@ -151,7 +191,6 @@ void memory_write_word(struct Memory *memory, uint16_t address, uint8_t value)
 }
 
 
-
 uint16_t memory_read_dword(struct Memory *memory, uint16_t address)
 {
     uint16_t lowByte = (uint16_t)memory_read_word(memory, address);
@@ -169,20 +208,80 @@ void memory_write_dword(struct Memory *memory, uint16_t address, uint16_t value)
 }
 
 
-bool memory_init(struct Memory *memory, struct Cartridge *cartridge)
+// Real ROMs are always a power of two banks (and at least two), which
+// lets bank numbers be masked rather than range checked.
+static bool init_rom(struct Memory *memory, const struct Cartridge *cartridge)
+{
+    if (cartridge->dataSize > MEMORY_ROM_BANK_SIZE * MEMORY_MAX_ROM_BANKS)
+    {
+        return false;
+    }
+
+    size_t numRomBanks = 2;
+    while (numRomBanks * MEMORY_ROM_BANK_SIZE < cartridge->dataSize)
+    {
+        numRomBanks *= 2;
+    }
+    memory->numRomBanks = numRomBanks;
+
+    size_t romSize = numRomBanks * MEMORY_ROM_BANK_SIZE;
+    if (romSize == cartridge->dataSize)
+    {
+        memory->rom = cartridge->data;
+        memory->romCopy = NULL;
+        return true;
+    }
+
+    // Pad the rest with 0xff, like unconnected ROM address lines
+    memory->romCopy = malloc(romSize);
+    if (memory->romCopy == NULL)
+    {
+        return false;
+    }
+    memcpy(memory->romCopy, cartridge->data, cartridge->dataSize);
+    memset(memory->romCopy + cartridge->dataSize, 0xff, romSize - cartridge->dataSize);
+    memory->rom = memory->romCopy;
+    return true;
+}
+
+
+bool memory_init(struct Memory *memory, const struct Cartridge *cartridge)
 {
-    memcpy(memory->rom, cartridge->data, cartridge->dataSize);
+    if (cartridge->dataSize < CARTRIDGE_MIN_DATA_SIZE)
+    {
+        return false;
+    }
+
+    struct CartridgeHeader cartridgeHeader;
+    if ( ! cartridge_get_header(cartridge, &cartridgeHeader))
+    {
+        return false;
+    }
+    memory->cartridgeType = cartridgeHeader.type;
+
+    if ( ! init_rom(memory, cartridge))
+    {
+        return false;
+    }
     memory->selectedRomBank = 1;
+
+    memory->externalRam = NULL;
+    memory->externalRamSize = cartridgeHeader.externalRamSize;
+    if (memory->externalRamSize > 0)
+    {
+        memory->externalRam = calloc(memory->externalRamSize, 1);
+        if (memory->externalRam == NULL)
+        {
+            free(memory->romCopy);
+            return false;
+        }
+    }
     memory->selectedExternalRamBank = 0;
     for (size_t i = 0; i < MEMORY_MAX_EXTERNAL_RAM_BANKS; i++)
     {
         memory->externalRamBankEnable[i] = false;
     }
 
-    struct CartridgeHeader cartridgeHeader;
-    cartridge_get_header(cartridge, &cartridgeHeader);
-    memory->cartridgeType = cartridgeHeader.type;
-
     for (size_t i = 0; i < MEMORY_IO_SIZE; i++)
     {
         memory->ioRegisterHandlers[i].context = NULL;
@@ -193,14 +292,20 @@ bool memory_init(struct Memory *memory, struct Cartridge *cartridge)
     memory->interruptEnableRegisterHandler.read = NULL;
     memory->interruptEnableRegisterHandler.write = NULL;
 
+    mark_all_tiles_dirty(memory);
+    map_all_pages(memory);
+
     return true;
 }
 
 
 void memory_teardown(struct Memory *memory)
 {
-    // Free any dynamically allocated banks
-    (void)memory;
+    free(memory->externalRam);
+    memory->externalRam = NULL;
+    free(memory->romCopy);
+    memory->romCopy = NULL;
+    memory->rom = NULL;
 }
 
 
@@ -223,3 +328,39 @@ void memory_register_io_handler(struct Memory *memory, uint8_t reg, IoRegisterRe
     handler->context = context;
 }
 
+
+void memory_save_state(const struct Memory *memory, struct MemoryState *state)
+{
+    state->selectedRomBank = (uint32_t)memory->selectedRomBank;
+    state->selectedExternalRamBank = (uint32_t)memory->selectedExternalRamBank;
+    for (size_t i = 0; i < MEMORY_MAX_EXTERNAL_RAM_BANKS; i++)
+    {
+        state->externalRamBankEnable[i] = memory->externalRamBankEnable[i];
+    }
+
+    memcpy(state->vram, memory->vram, sizeof(state->vram));
+    memcpy(state->wramBank0, memory->wramBank0, sizeof(state->wramBank0));
+    memcpy(state->wramBank1, memory->wramBank1, sizeof(state->wramBank1));
+    memcpy(state->oam, memory->oam, sizeof(state->oam));
+    memcpy(state->highRam, memory->highRam, sizeof(state->highRam));
+}
+
+
+void memory_load_state(struct Memory *memory, const struct MemoryState *state)
+{
+    memory->selectedRomBank = state->selectedRomBank & (memory->numRomBanks - 1);
+    memory->selectedExternalRamBank = state->selectedExternalRamBank;
+    for (size_t i = 0; i < MEMORY_MAX_EXTERNAL_RAM_BANKS; i++)
+    {
+        memory->externalRamBankEnable[i] = state->externalRamBankEnable[i] != 0;
+    }
+
+    memcpy(memory->vram, state->vram, sizeof(memory->vram));
+    memcpy(memory->wramBank0, state->wramBank0, sizeof(memory->wramBank0));
+    memcpy(memory->wramBank1, state->wramBank1, sizeof(memory->wramBank1));
+    memcpy(memory->oam, state->oam, sizeof(memory->oam));
+    memcpy(memory->highRam, state->highRam, sizeof(memory->highRam));
+
+    mark_all_tiles_dirty(memory);
+    map_all_pages(memory);
+}
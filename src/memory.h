@@ -19,11 +19,17 @@ struct Cartridge;
 #define MEMORY_ROM_BANK0_END       (MEMORY_ROM_BANK0_START + MEMORY_ROM_BANK_SIZE - 1)
 // In cartridge, switchable
 #define MEMORY_ROM_BANKN_START     0x4000
-#define MEMORY_ROM_BANKN_END       (MEMORY_ROM_BANKN_START + MEMORY_ROM_BANK_SIZE)
+#define MEMORY_ROM_BANKN_END       (MEMORY_ROM_BANKN_START + MEMORY_ROM_BANK_SIZE - 1)
 // Switchable bank 0-1 in CGB mode
 #define MEMORY_VRAM_START          0x8000
 #define MEMORY_VRAM_SIZE           0x2000
 #define MEMORY_VRAM_END            (MEMORY_VRAM_START + MEMORY_VRAM_SIZE - 1)
+// Tile data takes up the start of VRAM, before the tile maps
+#define MEMORY_TILE_DATA_START     MEMORY_VRAM_START
+#define MEMORY_TILE_DATA_END       0x97ff
+#define MEMORY_TILE_SIZE           16
+#define MEMORY_NUM_TILES           ((MEMORY_TILE_DATA_END - MEMORY_TILE_DATA_START + 1) / MEMORY_TILE_SIZE)
+#define MEMORY_TILE_MAPS_START     (MEMORY_TILE_DATA_END + 1)
 // In cartridge, switchable (if any)
 #define MEMORY_EXTERNAL_RAM_START  0xa000
 #define MEMORY_EXTERNAL_RAM_SIZE   0x2000
@@ -57,6 +63,11 @@ struct Cartridge;
 #define MEMORY_INTERRUPT_ENABLE_REGISTER_ADDRESS  0xffff
 
 
+// The address space is split into 256-byte pages for fast lookups
+#define MEMORY_PAGE_SIZE   0x100
+#define MEMORY_NUM_PAGES   0x100
+
+
 // Allow other systems to register callback functions on read or write
 // of IO registers, along with the necessary context (e.g. a Cpu* or Ppu*).
 typedef void *IoRegisterFuncContext;
@@ -74,10 +85,17 @@ struct Memory
 {
     uint16_t cartridgeType;
 
-    uint8_t rom[MEMORY_ROM_BANK_SIZE * MEMORY_MAX_ROM_BANKS];
+    // Usually the cartridge's own data, which may be shared with other
+    // emulators, so it's never written. ROM images that aren't a power of
+    // two banks in size are padded into romCopy instead.
+    const uint8_t *rom;
+    uint8_t *romCopy;
+    size_t numRomBanks;
     size_t selectedRomBank;
 
-    uint8_t externalRam[MEMORY_EXTERNAL_RAM_SIZE * MEMORY_MAX_EXTERNAL_RAM_BANKS];
+    // Only as large as the cartridge header says (NULL if there is none)
+    uint8_t *externalRam;
+    size_t externalRamSize;
     size_t selectedExternalRamBank;
     bool externalRamBankEnable[MEMORY_MAX_EXTERNAL_RAM_BANKS];
 
@@ -87,18 +105,73 @@ struct Memory
     uint8_t oam[MEMORY_OAM_SIZE];
     uint8_t highRam[MEMORY_HIGH_RAM_SIZE];
 
+    // Set for each tile whose data has changed since the PPU last decoded
+    // it, and tileDataDirty is set if any are. Tile data pages aren't
+    // mapped for writing, so that every write goes through the slow path.
+    bool tileDirty[MEMORY_NUM_TILES];
+    bool tileDataDirty;
+
     struct IoRegisterHandler ioRegisterHandlers[MEMORY_IO_SIZE];
     struct IoRegisterHandler interruptEnableRegisterHandler;
+
+    // Base pointer for each page of the address space, rebuilt when banks
+    // are switched. A NULL entry means accesses to that page have side
+    // effects (MBC registers, OAM/unusable area, IO registers) and must go
+    // through the slow path.
+    const uint8_t *readPages[MEMORY_NUM_PAGES];
+    uint8_t *writePages[MEMORY_NUM_PAGES];
+};
+
+// RAM contents and bank selection for save states. External RAM varies in
+// size by cartridge, so it's saved separately.
+struct MemoryState
+{
+    uint32_t selectedRomBank;
+    uint32_t selectedExternalRamBank;
+    uint8_t externalRamBankEnable[MEMORY_MAX_EXTERNAL_RAM_BANKS];
+
+    uint8_t vram[MEMORY_VRAM_SIZE];
+    uint8_t wramBank0[MEMORY_WRAM_BANK_SIZE];
+    uint8_t wramBank1[MEMORY_WRAM_BANK_SIZE];
+    uint8_t oam[MEMORY_OAM_SIZE];
+    uint8_t highRam[MEMORY_HIGH_RAM_SIZE];
 };
 
 
-uint8_t memory_read_word(struct Memory *memory, uint16_t address);
+uint8_t memory_read_word_slow(struct Memory *memory, uint16_t address);
+void memory_write_word_slow(struct Memory *memory, uint16_t address, uint8_t value);
+
+// Every opcode fetch goes through these, so keep the common case inlined.
+static inline uint8_t memory_read_word(struct Memory *memory, uint16_t address)
+{
+    const uint8_t *page = memory->readPages[address >> 8];
+    if (page != NULL)
+    {
+        return page[address & 0xff];
+    }
+    return memory_read_word_slow(memory, address);
+}
+
+static inline void memory_write_word(struct Memory *memory, uint16_t address, uint8_t value)
+{
+    uint8_t *page = memory->writePages[address >> 8];
+    if (page != NULL)
+    {
+        page[address & 0xff] = value;
+        return;
+    }
+    memory_write_word_slow(memory, address, value);
+}
+
 uint16_t memory_read_dword(struct Memory *memory, uint16_t address);
-void memory_write_word(struct Memory *memory, uint16_t address, uint8_t value);
 void memory_write_dword(struct Memory *memory, uint16_t address, uint16_t value);
 
-bool memory_init(struct Memory *memory, struct Cartridge *cartridge);
+// The cartridge must outlive the memory, which uses its ROM in place
+bool memory_init(struct Memory *memory, const struct Cartridge *cartridge);
 void memory_teardown(struct Memory *memory);
 void memory_register_io_handler(struct Memory *memory, uint8_t reg, IoRegisterReadFunc readfunc, IoRegisterWriteFunc writefunc, IoRegisterFuncContext context);
 
+void memory_save_state(const struct Memory *memory, struct MemoryState *state);
+void memory_load_state(struct Memory *memory, const struct MemoryState *state);
+
 #endif
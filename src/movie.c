@@ -0,0 +1,254 @@
+
+#include <stdint.h>
+#include <string.h>
+
+#include "movie.h"
+#include "cartridge.h"
+#include "input.h"
+
+
+static const uint8_t MOVIE_MAGIC[4] = { 'G', 'B', 'M', 'V' };
+#define MOVIE_VERSION  1
+
+// Magic, version, then the ROM size and hash (both little endian)
+#define MOVIE_HEADER_LENGTH  (sizeof(MOVIE_MAGIC) + 1 + 4 + 4)
+
+#define MOVIE_END_FLAG  1
+
+
+// FNV-1a over the whole ROM. Homebrew and test ROMs often leave the header
+// checksums blank, so those aren't enough to tell ROMs apart.
+static uint32_t hash_rom(const struct Cartridge *cartridge)
+{
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < cartridge->dataSize; i++)
+    {
+        hash = (hash ^ cartridge->data[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+static void write_u32(uint8_t *output, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        output[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void make_header(uint8_t *header, const struct Cartridge *cartridge)
+{
+    memcpy(header, MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+    header[sizeof(MOVIE_MAGIC)] = MOVIE_VERSION;
+    write_u32(&header[sizeof(MOVIE_MAGIC) + 1], (uint32_t)cartridge->dataSize);
+    write_u32(&header[sizeof(MOVIE_MAGIC) + 5], hash_rom(cartridge));
+}
+
+
+static uint8_t pack_buttons(const struct InputState *input)
+{
+    return (uint8_t)(
+        (input->buttonA      ? (1 << 0) : 0) |
+        (input->buttonB      ? (1 << 1) : 0) |
+        (input->buttonSelect ? (1 << 2) : 0) |
+        (input->buttonStart  ? (1 << 3) : 0) |
+        (input->dpadRight    ? (1 << 4) : 0) |
+        (input->dpadLeft     ? (1 << 5) : 0) |
+        (input->dpadUp       ? (1 << 6) : 0) |
+        (input->dpadDown     ? (1 << 7) : 0)
+    );
+}
+
+static void unpack_buttons(uint8_t buttons, struct InputState *input)
+{
+    input->buttonA = (buttons & (1 << 0)) != 0;
+    input->buttonB = (buttons & (1 << 1)) != 0;
+    input->buttonSelect = (buttons & (1 << 2)) != 0;
+    input->buttonStart = (buttons & (1 << 3)) != 0;
+    input->dpadRight = (buttons & (1 << 4)) != 0;
+    input->dpadLeft = (buttons & (1 << 5)) != 0;
+    input->dpadUp = (buttons & (1 << 6)) != 0;
+    input->dpadDown = (buttons & (1 << 7)) != 0;
+}
+
+
+static bool write_number(FILE *file, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        if (fputc((int)((value & 0x7f) | 0x80), file) == EOF)
+        {
+            return false;
+        }
+        value >>= 7;
+    }
+    return fputc((int)value, file) != EOF;
+}
+
+static bool read_number(FILE *file, uint64_t *value)
+{
+    *value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        int byte = fgetc(file);
+        if (byte == EOF)
+        {
+            return false;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void clear(struct Movie *movie)
+{
+    movie->file = NULL;
+    movie->recording = false;
+    movie->frame = 0;
+    movie->buttons = 0;
+    movie->lastRecordFrame = 0;
+    movie->hasNextChange = false;
+    movie->nextChangeFrame = 0;
+    movie->nextButtons = 0;
+    movie->endFrame = UINT64_MAX;
+}
+
+
+bool movie_init_recording(struct Movie *movie, const char *path, const struct Cartridge *cartridge)
+{
+    clear(movie);
+    movie->recording = true;
+    movie->file = fopen(path, "wb");
+    if (movie->file == NULL)
+    {
+        return false;
+    }
+
+    uint8_t header[MOVIE_HEADER_LENGTH];
+    make_header(header, cartridge);
+    if (fwrite(header, sizeof(header), 1, movie->file) != 1)
+    {
+        movie_teardown(movie);
+        return false;
+    }
+    return true;
+}
+
+
+// Reads the record after the current one. A movie cut short (e.g. because
+// the emulator recording it crashed) has no end record, so the buttons from
+// its last complete record are held indefinitely.
+static void read_next_record(struct Movie *movie)
+{
+    movie->hasNextChange = false;
+
+    uint64_t value;
+    if ( ! read_number(movie->file, &value))
+    {
+        return;
+    }
+
+    uint64_t recordFrame = movie->lastRecordFrame + (value >> 1);
+    if (value & MOVIE_END_FLAG)
+    {
+        movie->endFrame = recordFrame;
+        return;
+    }
+
+    int buttons = fgetc(movie->file);
+    if (buttons == EOF)
+    {
+        return;
+    }
+    movie->hasNextChange = true;
+    movie->nextChangeFrame = recordFrame;
+    movie->nextButtons = (uint8_t)buttons;
+}
+
+
+bool movie_init_playback(struct Movie *movie, const char *path, const struct Cartridge *cartridge)
+{
+    clear(movie);
+    movie->file = fopen(path, "rb");
+    if (movie->file == NULL)
+    {
+        return false;
+    }
+
+    uint8_t expected[MOVIE_HEADER_LENGTH];
+    make_header(expected, cartridge);
+    uint8_t header[MOVIE_HEADER_LENGTH];
+    if (fread(header, sizeof(header), 1, movie->file) != 1 || memcmp(header, expected, sizeof(header)) != 0)
+    {
+        movie_teardown(movie);
+        return false;
+    }
+
+    read_next_record(movie);
+    return true;
+}
+
+
+void movie_teardown(struct Movie *movie)
+{
+    if (movie->file == NULL)
+    {
+        return;
+    }
+    if (movie->recording)
+    {
+        write_number(movie->file, ((movie->frame - movie->lastRecordFrame) << 1) | MOVIE_END_FLAG);
+    }
+    fclose(movie->file);
+    clear(movie);
+}
+
+
+bool movie_record_input(struct Movie *movie, const struct InputState *input)
+{
+    uint8_t buttons = pack_buttons(input);
+    if (buttons != movie->buttons)
+    {
+        // Flushed straight away so that a crash loses as little as possible.
+        // Changes are rare enough (a few per second) that it costs nothing.
+        if ( ! write_number(movie->file, (movie->frame - movie->lastRecordFrame) << 1)
+            || fputc(buttons, movie->file) == EOF
+            || fflush(movie->file) != 0)
+        {
+            return false;
+        }
+        movie->buttons = buttons;
+        movie->lastRecordFrame = movie->frame;
+    }
+    movie->frame += 1;
+    return true;
+}
+
+
+bool movie_play_input(struct Movie *movie, struct InputState *input)
+{
+    if (movie->frame >= movie->endFrame)
+    {
+        return false;
+    }
+
+    while (movie->hasNextChange && movie->nextChangeFrame <= movie->frame)
+    {
+        movie->buttons = movie->nextButtons;
+        movie->lastRecordFrame = movie->nextChangeFrame;
+        read_next_record(movie);
+    }
+    if (movie->frame >= movie->endFrame)
+    {
+        return false;
+    }
+
+    unpack_buttons(movie->buttons, input);
+    movie->frame += 1;
+    return true;
+}
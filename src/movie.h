@@ -0,0 +1,59 @@
+
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+struct Cartridge;
+struct InputState;
+
+
+// Records the buttons held on each frame to a file, or plays them back.
+// Frontends only change input between frames, so replaying the same
+// buttons on the same frames from power on reproduces a run exactly.
+//
+// A movie file starts with a header identifying the ROM, followed by one
+// record per change of buttons: the number of frames since the previous
+// record (as LEB128, shifted left one bit), then the buttons. The final
+// record has the low bit set and no buttons, and marks the end.
+
+struct Movie
+{
+    FILE *file;
+    bool recording;
+
+    // Number of calls to movie_record_input or movie_play_input so far
+    uint64_t frame;
+
+    // The buttons held, packed into one byte
+    uint8_t buttons;
+    uint64_t lastRecordFrame;
+
+    // Playback only. endFrame is UINT64_MAX until the end record is read.
+    bool hasNextChange;
+    uint64_t nextChangeFrame;
+    uint8_t nextButtons;
+    uint64_t endFrame;
+};
+
+
+// Both return false if the file can't be opened. Playback also fails if
+// the movie was recorded with a different ROM.
+bool movie_init_recording(struct Movie *movie, const char *path, const struct Cartridge *cartridge);
+bool movie_init_playback(struct Movie *movie, const char *path, const struct Cartridge *cartridge);
+
+// Finishes the file when recording
+void movie_teardown(struct Movie *movie);
+
+// Call with the input for each frame, including once before the first.
+// Recording returns false if the file couldn't be written.
+bool movie_record_input(struct Movie *movie, const struct InputState *input);
+
+// Sets the buttons held in the input state, leaving the emulator controls
+// alone. Returns false, without changing anything, once the movie is over.
+bool movie_play_input(struct Movie *movie, struct InputState *input);
+
+
+#endif
@@ -1,5 +1,7 @@
 
+#include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "options.h"
@@ -11,6 +13,59 @@ static bool starts_with(const char* string, const char* prefix)
 }
 
 
+// Accepts "uncapped", or a supported multiplier with or without an "x"
+static bool parse_speed(const char *string, int *speed)
+{
+    if (strcmp(string, "uncapped") == 0)
+    {
+        *speed = OPTIONS_SPEED_UNCAPPED;
+        return true;
+    }
+
+    const char *multipliers[] = { "1", "2", "4", "8" };
+    for (size_t i = 0; i < sizeof(multipliers) / sizeof(multipliers[0]); i++)
+    {
+        size_t length = strlen(multipliers[i]);
+        if (strncmp(string, multipliers[i], length) == 0 && (strcmp(string + length, "") == 0 || strcmp(string + length, "x") == 0))
+        {
+            *speed = 1 << i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static bool parse_palette(const char *string, enum LcdPalette *palette)
+{
+    if (strcmp(string, "gray") == 0)
+    {
+        *palette = LCD_PALETTE_GRAY;
+        return true;
+    }
+    if (strcmp(string, "green") == 0)
+    {
+        *palette = LCD_PALETTE_GREEN;
+        return true;
+    }
+    return false;
+}
+
+
+// Accepts a whole number in [minimum, maximum]
+static bool parse_int(const char *string, int minimum, int maximum, int *value)
+{
+    char *end;
+    long parsed = strtol(string, &end, 10);
+    if (end == string || *end != '\0' || parsed < minimum || parsed > maximum)
+    {
+        return false;
+    }
+    *value = (int)parsed;
+    return true;
+}
+
+
 static void print_help(void)
 {
     fprintf(stderr,
@@ -18,10 +73,19 @@ static void print_help(void)
         "  rom_path : Path to GameBoy ROM .gb file \n"
         "\n"
         "Options: \n"
-        "  --headless          : Run the emulator without a display (for testing) \n"
-        "  --help              : Display this message and quit \n"
-        "  --serial-out <path> : Path to file to log bytes written to the serial link port \n"
-        "  --small             : Size display window accurate to a real GameBoy LCD (it is shown 4x wider and taller by default) \n"
+        "  --headless                 : Run the emulator without a display (for testing) \n"
+        "  --help                     : Display this message and quit \n"
+        "  --jit                      : Translate ROM code to native code where supported (x86-64 Linux) \n"
+        "  --palette <palette>        : Show the LCD in \"gray\" (default) or \"green\" \n"
+        "  --play-movie <path>        : Play back the buttons recorded in a movie file, then continue with the keyboard. \n"
+        "                               emulator_headless runs as fast as possible and stops at the end of the movie. \n"
+        "  --record-movie <path>      : Record the buttons held on each frame to a movie file \n"
+        "  --rewind-buffer <MiB>      : Memory to keep for rewinding with Backspace (default 32), or 0 to disable rewinding \n"
+        "  --rewind-interval <frames> : Frames between rewind snapshots (default 1) \n"
+        "  --serial-out <path>        : Path to file to log bytes written to the serial link port \n"
+        "  --small                    : Size display window accurate to a real GameBoy LCD (it is shown 4x wider and taller by default) \n"
+        "  --speed <speed>            : Run at 1x (default), 2x, 4x or 8x real time, or \"uncapped\" to run as fast as possible. \n"
+        "                               Holding Tab runs uncapped regardless. \n"
     );
 }
 
@@ -30,11 +94,18 @@ int parse_options(int argc, char **argv, struct Options *options)
 {
     options->romPath = NULL;
     options->serialOutPath = NULL;
+    options->recordMoviePath = NULL;
+    options->playMoviePath = NULL;
     options->exitEarly = false;
+    options->jit = false;
+    options->speed = 1;
+    options->rewindBufferMiB = OPTIONS_DEFAULT_REWIND_BUFFER_MIB;
+    options->rewindInterval = 1;
+    options->palette = LCD_PALETTE_GRAY;
     options->graphics.headless = false;
     options->graphics.smallWindow = false;
 
-    for (int i = 0; i < argc; i++)
+    for (int i = 1; i < argc; i++)
     {
         const char *arg = argv[i];
         if (starts_with(arg, "--"))
@@ -49,6 +120,59 @@ int parse_options(int argc, char **argv, struct Options *options)
                 print_help();
                 return 0;
             }
+            else if (strcmp(arg, "--jit") == 0)
+            {
+                options->jit = true;
+            }
+            else if (strcmp(arg, "--palette") == 0)
+            {
+                if (i == argc - 1 || ! parse_palette(argv[i + 1], &options->palette))
+                {
+                    fprintf(stderr, "error: supply palette of gray or green \n\n");
+                    print_help();
+                    return 1;
+                }
+                i += 1;
+            }
+            else if (strcmp(arg, "--play-movie") == 0 || strcmp(arg, "--record-movie") == 0)
+            {
+                if (i == argc - 1)
+                {
+                    fprintf(stderr, "error: supply path for movie file \n\n");
+                    print_help();
+                    return 1;
+                }
+                if (strcmp(arg, "--play-movie") == 0)
+                {
+                    options->playMoviePath = argv[++i];
+                }
+                else
+                {
+                    options->recordMoviePath = argv[++i];
+                }
+            }
+            else if (strcmp(arg, "--rewind-buffer") == 0)
+            {
+                int mib;
+                if (i == argc - 1 || ! parse_int(argv[i + 1], 0, 4096, &mib))
+                {
+                    fprintf(stderr, "error: supply rewind buffer size in MiB (0 to 4096) \n\n");
+                    print_help();
+                    return 1;
+                }
+                options->rewindBufferMiB = (size_t)mib;
+                i += 1;
+            }
+            else if (strcmp(arg, "--rewind-interval") == 0)
+            {
+                if (i == argc - 1 || ! parse_int(argv[i + 1], 1, 3600, &options->rewindInterval))
+                {
+                    fprintf(stderr, "error: supply number of frames between rewind snapshots (1 to 3600) \n\n");
+                    print_help();
+                    return 1;
+                }
+                i += 1;
+            }
             else if (strcmp(arg, "--serial-out") == 0)
             {
                 // TODO: Extract?
@@ -62,6 +186,16 @@ int parse_options(int argc, char **argv, struct Options *options)
                 }
                 options->serialOutPath = argv[++i];
             }
+            else if (strcmp(arg, "--speed") == 0)
+            {
+                if (i == argc - 1 || ! parse_speed(argv[i + 1], &options->speed))
+                {
+                    fprintf(stderr, "error: supply speed of 1x, 2x, 4x, 8x or uncapped \n\n");
+                    print_help();
+                    return 1;
+                }
+                i += 1;
+            }
             else if (strcmp(arg, "--small") == 0)
             {
                 options->graphics.smallWindow = true;
@@ -89,5 +223,11 @@ int parse_options(int argc, char **argv, struct Options *options)
         return 1;
     }
 
+    if (options->playMoviePath != NULL && options->recordMoviePath != NULL)
+    {
+        fprintf(stderr, "error: can't play and record a movie at the same time \n");
+        return 1;
+    }
+
     return 0;
 }
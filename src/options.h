@@ -2,14 +2,36 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
-#include "graphics.h"
+#include <stdbool.h>
+#include <stddef.h>
 
+#include "lcd.h"
+
+
+struct GraphicsOptions
+{
+    bool smallWindow;
+    bool headless;
+};
+
+
+// Run as fast as possible instead of at a multiple of real time
+#define OPTIONS_SPEED_UNCAPPED  0
+
+#define OPTIONS_DEFAULT_REWIND_BUFFER_MIB  32
 
 struct Options
 {
     const char *romPath;
     const char *serialOutPath;
+    const char *recordMoviePath;
+    const char *playMoviePath;
     bool exitEarly;
+    bool jit;
+    int speed;
+    size_t rewindBufferMiB;
+    int rewindInterval;
+    enum LcdPalette palette;
     struct GraphicsOptions graphics;
 };
 
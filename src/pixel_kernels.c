@@ -0,0 +1,184 @@
+
+#include <string.h>
+
+#include "pixel_kernels.h"
+
+
+// The vectorised kernels are compiled for their instruction sets with
+// function attributes rather than build flags, so that the rest of the
+// emulator still runs on any x86-64 CPU.
+#if PIXEL_KERNELS_SIMD && defined(__x86_64__) && defined(__GNUC__)
+#define PIXEL_KERNELS_X86  1
+#include <immintrin.h>
+#else
+#define PIXEL_KERNELS_X86  0
+#endif
+
+
+static void decode_tile_row_scalar(uint8_t tileByte0, uint8_t tileByte1, uint8_t *colorNumbers, uint8_t *flippedColorNumbers)
+{
+    for (size_t i = 0; i < 8; i++)
+    {
+        size_t shift = 7 - i;
+        uint8_t colorNumber = (uint8_t)((((tileByte1 >> shift) & 1) << 1) | ((tileByte0 >> shift) & 1));
+        colorNumbers[i] = colorNumber;
+        flippedColorNumbers[7 - i] = colorNumber;
+    }
+}
+
+
+static void map_indices_scalar(const uint8_t *indices, size_t count, const uint8_t *table, uint8_t *output)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        output[i] = table[indices[i]];
+    }
+}
+
+
+static void expand_pixels_scalar(const uint8_t *indices, size_t count, const uint32_t *colors, uint8_t *pixels)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        memcpy(&pixels[4 * i], &colors[indices[i]], sizeof(colors[0]));
+    }
+}
+
+
+#if PIXEL_KERNELS_X86
+
+__attribute__((target("bmi2")))
+static void decode_tile_row_bmi2(uint8_t tileByte0, uint8_t tileByte1, uint8_t *colorNumbers, uint8_t *flippedColorNumbers)
+{
+    // Depositing each bit in its own byte puts the lowest bit, which is
+    // the rightmost pixel, first. Reversing the bytes gives the row the
+    // right way round.
+    uint64_t flippedRow = _pdep_u64(tileByte0, 0x0101010101010101ULL) | _pdep_u64(tileByte1, 0x0202020202020202ULL);
+    uint64_t row = __builtin_bswap64(flippedRow);
+    memcpy(colorNumbers, &row, sizeof(row));
+    memcpy(flippedColorNumbers, &flippedRow, sizeof(flippedRow));
+}
+
+
+__attribute__((target("ssse3")))
+static void map_indices_ssse3(const uint8_t *indices, size_t count, const uint8_t *table, uint8_t *output)
+{
+    // A byte shuffle is a lookup in a table of up to 16 bytes
+    uint32_t tableBytes;
+    memcpy(&tableBytes, table, sizeof(tableBytes));
+    const __m128i tableRegister = _mm_cvtsi32_si128((int)tableBytes);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)&indices[i]);
+        _mm_storeu_si128((__m128i*)&output[i], _mm_shuffle_epi8(tableRegister, block));
+    }
+    map_indices_scalar(&indices[i], count - i, table, &output[i]);
+}
+
+
+__attribute__((target("ssse3")))
+static void expand_pixels_ssse3(const uint8_t *indices, size_t count, const uint32_t *colors, uint8_t *pixels)
+{
+    // The colors fill one register, so each output byte can be shuffled
+    // in from byte (4 * index + n) of it. Indices are below four, so
+    // shifting them in 16-bit lanes can't carry between bytes.
+    const __m128i table = _mm_loadu_si128((const __m128i*)colors);
+    const __m128i byteNumbers = _mm_set1_epi32(0x03020100);
+    const __m128i spread0 = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    const __m128i spread1 = _mm_add_epi8(spread0, _mm_set1_epi8(4));
+    const __m128i spread2 = _mm_add_epi8(spread0, _mm_set1_epi8(8));
+    const __m128i spread3 = _mm_add_epi8(spread0, _mm_set1_epi8(12));
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i offsets = _mm_slli_epi16(_mm_loadu_si128((const __m128i*)&indices[i]), 2);
+        __m128i *output = (__m128i*)&pixels[4 * i];
+        _mm_storeu_si128(&output[0], _mm_shuffle_epi8(table, _mm_or_si128(_mm_shuffle_epi8(offsets, spread0), byteNumbers)));
+        _mm_storeu_si128(&output[1], _mm_shuffle_epi8(table, _mm_or_si128(_mm_shuffle_epi8(offsets, spread1), byteNumbers)));
+        _mm_storeu_si128(&output[2], _mm_shuffle_epi8(table, _mm_or_si128(_mm_shuffle_epi8(offsets, spread2), byteNumbers)));
+        _mm_storeu_si128(&output[3], _mm_shuffle_epi8(table, _mm_or_si128(_mm_shuffle_epi8(offsets, spread3), byteNumbers)));
+    }
+    expand_pixels_scalar(&indices[i], count - i, colors, &pixels[4 * i]);
+}
+
+
+__attribute__((target("avx2")))
+static void expand_pixels_avx2(const uint8_t *indices, size_t count, const uint32_t *colors, uint8_t *pixels)
+{
+    // Looking up eight 32-bit values is a single permute
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)colors));
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&indices[i]));
+        _mm256_storeu_si256((__m256i*)&pixels[4 * i], _mm256_permutevar8x32_epi32(table, lanes));
+    }
+    expand_pixels_scalar(&indices[i], count - i, colors, &pixels[4 * i]);
+}
+
+#endif
+
+
+static void init_scalar(struct PixelKernels *kernels)
+{
+    kernels->decode_tile_row = decode_tile_row_scalar;
+    kernels->map_indices = map_indices_scalar;
+    kernels->expand_pixels = expand_pixels_scalar;
+}
+
+
+void pixel_kernels_init(struct PixelKernels *kernels)
+{
+    init_scalar(kernels);
+
+#if PIXEL_KERNELS_X86
+    if (__builtin_cpu_supports("bmi2"))
+    {
+        kernels->decode_tile_row = decode_tile_row_bmi2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        kernels->map_indices = map_indices_ssse3;
+        kernels->expand_pixels = expand_pixels_ssse3;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels->expand_pixels = expand_pixels_avx2;
+    }
+#endif
+}
+
+
+size_t pixel_kernels_get_all(struct PixelKernels *kernels)
+{
+    size_t numSets = 0;
+    init_scalar(&kernels[numSets++]);
+
+#if PIXEL_KERNELS_X86
+    if (__builtin_cpu_supports("bmi2"))
+    {
+        struct PixelKernels *bmi2 = &kernels[numSets++];
+        init_scalar(bmi2);
+        bmi2->decode_tile_row = decode_tile_row_bmi2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        struct PixelKernels *ssse3 = &kernels[numSets++];
+        init_scalar(ssse3);
+        ssse3->map_indices = map_indices_ssse3;
+        ssse3->expand_pixels = expand_pixels_ssse3;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        struct PixelKernels *avx2 = &kernels[numSets++];
+        init_scalar(avx2);
+        avx2->expand_pixels = expand_pixels_avx2;
+    }
+#endif
+
+    return numSets;
+}
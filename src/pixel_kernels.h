@@ -0,0 +1,47 @@
+
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Use vectorised versions of the kernels where the CPU running the
+// emulator supports them (x86-64 only). The plain C versions are always
+// available, and produce exactly the same output.
+#ifndef PIXEL_KERNELS_SIMD
+#define PIXEL_KERNELS_SIMD  1
+#endif
+
+
+// Converts the two bitplane bytes of a tile row to eight color numbers,
+// leftmost pixel first, and to the same row mirrored.
+typedef void (*DecodeTileRowFunc)(uint8_t tileByte0, uint8_t tileByte1, uint8_t *colorNumbers, uint8_t *flippedColorNumbers);
+
+// Writes the byte from table for each index, which must all be below four
+typedef void (*MapIndicesFunc)(const uint8_t *indices, size_t count, const uint8_t *table, uint8_t *output);
+
+// Writes the 32-bit pixel from colors for each index, which must all be
+// below four. The pixels needn't be aligned.
+typedef void (*ExpandPixelsFunc)(const uint8_t *indices, size_t count, const uint32_t *colors, uint8_t *pixels);
+
+struct PixelKernels
+{
+    DecodeTileRowFunc decode_tile_row;
+    MapIndicesFunc map_indices;
+    ExpandPixelsFunc expand_pixels;
+};
+
+
+// Picks the fastest versions the CPU supports
+void pixel_kernels_init(struct PixelKernels *kernels);
+
+// Fills kernels with the plain C versions, then a set for each instruction
+// set the CPU supports, with the vectorised versions for it and plain C for
+// the rest. Returns how many sets there are. For checking that they all
+// match.
+#define PIXEL_KERNELS_MAX_SETS  4
+size_t pixel_kernels_get_all(struct PixelKernels *kernels);
+
+
+#endif
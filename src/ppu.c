@@ -2,11 +2,13 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "ppu.h"
 #include "memory.h"
 #include "lcd.h"
 #include "cpu.h"
+#include "scheduler.h"
 
 
 #define MAX_OBJECTS           40
@@ -122,54 +124,52 @@ static size_t oam_search(struct Ppu *ppu, struct Object *objects)
 }
 
 
-static enum Color get_background_palette_color(struct Ppu *ppu, uint8_t colorNumber)
+// R, G and B of each shade in each LCD palette
+static const uint8_t LCD_PALETTE_COLORS[][4][3] = {
+    [LCD_PALETTE_GRAY] = {
+        [COLOR_LIGHTEST] = { LCD_COLOR_GRAY_LIGHTEST_R, LCD_COLOR_GRAY_LIGHTEST_G, LCD_COLOR_GRAY_LIGHTEST_B },
+        [COLOR_LIGHTER] = { LCD_COLOR_GRAY_LIGHTER_R, LCD_COLOR_GRAY_LIGHTER_G, LCD_COLOR_GRAY_LIGHTER_B },
+        [COLOR_DARKER] = { LCD_COLOR_GRAY_DARKER_R, LCD_COLOR_GRAY_DARKER_G, LCD_COLOR_GRAY_DARKER_B },
+        [COLOR_DARKEST] = { LCD_COLOR_GRAY_DARKEST_R, LCD_COLOR_GRAY_DARKEST_G, LCD_COLOR_GRAY_DARKEST_B },
+    },
+    [LCD_PALETTE_GREEN] = {
+        [COLOR_LIGHTEST] = { LCD_COLOR_GREEN_LIGHTEST_R, LCD_COLOR_GREEN_LIGHTEST_G, LCD_COLOR_GREEN_LIGHTEST_B },
+        [COLOR_LIGHTER] = { LCD_COLOR_GREEN_LIGHTER_R, LCD_COLOR_GREEN_LIGHTER_G, LCD_COLOR_GREEN_LIGHTER_B },
+        [COLOR_DARKER] = { LCD_COLOR_GREEN_DARKER_R, LCD_COLOR_GREEN_DARKER_G, LCD_COLOR_GREEN_DARKER_B },
+        [COLOR_DARKEST] = { LCD_COLOR_GREEN_DARKEST_R, LCD_COLOR_GREEN_DARKEST_G, LCD_COLOR_GREEN_DARKEST_B },
+    },
+};
+
+
+// Expanded pixels are B, G, R, A bytes, so this is a pixel as it's stored
+// in memory
+static uint32_t get_lcd_pixel(enum LcdPalette lcdPalette, enum Color color)
 {
-    assert(colorNumber < 4);
-    return ppu->backgroundPalette[colorNumber];
+    const uint8_t *rgb = LCD_PALETTE_COLORS[lcdPalette][color];
+    uint8_t bytes[4] = { rgb[2], rgb[1], rgb[0], 0xff };
+
+    uint32_t pixel;
+    memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
 }
 
-static bool get_object_palette_color(struct Ppu *ppu, bool paletteFlag, uint8_t colorNumber, enum Color *color)
+
+// The shades for each color number are rebuilt whenever a palette changes,
+// so drawing a pixel is a single lookup. Object color number 0 is
+// transparent, so objects only have shades for the other three.
+static void update_palette_shades(const enum Color *palette, size_t numColors, uint8_t *shades)
 {
-    assert(colorNumber < 4);
-    if (colorNumber == 0)
+    for (size_t i = 0; i < numColors; i++)
     {
-        // All object pixels with color number 0 are transparent.
-        return false;
+        shades[i] = (uint8_t)palette[i];
     }
-    enum Color *palette = paletteFlag ? ppu->objectPalette1 : ppu->objectPalette0;
-    *color = palette[colorNumber - 1];
-    return true;
 }
 
-
-
-static void get_color_rgb(enum Color color, uint8_t *r, uint8_t *g, uint8_t *b)
+static void update_all_palette_shades(struct Ppu *ppu)
 {
-    switch (color)
-    {
-    case COLOR_LIGHTEST:
-        *r = LCD_COLOR_LIGHTEST_R;
-        *g = LCD_COLOR_LIGHTEST_G;
-        *b = LCD_COLOR_LIGHTEST_B;
-        break;
-    case COLOR_LIGHTER:
-        *r = LCD_COLOR_LIGHTER_R;
-        *g = LCD_COLOR_LIGHTER_G;
-        *b = LCD_COLOR_LIGHTER_B;
-        break;
-    case COLOR_DARKER:
-        *r = LCD_COLOR_DARKER_R;
-        *g = LCD_COLOR_DARKER_G;
-        *b = LCD_COLOR_DARKER_B;
-        break;
-    case COLOR_DARKEST:
-        *r = LCD_COLOR_DARKEST_R;
-        *g = LCD_COLOR_DARKEST_G;
-        *b = LCD_COLOR_DARKEST_B;
-        break;
-    default:
-        assert(false);
-    }
+    update_palette_shades(ppu->backgroundPalette, 4, ppu->backgroundShades);
+    update_palette_shades(ppu->objectPalette0, 3, &ppu->objectShades0[1]);
+    update_palette_shades(ppu->objectPalette1, 3, &ppu->objectShades1[1]);
 }
 
 
@@ -185,129 +185,169 @@ static void get_color_rgb(enum Color color, uint8_t *r, uint8_t *g, uint8_t *b)
 #define TILE_GRID_WIDTH         32
 #define TILE_GRID_HEIGHT        32
 
-static void ppu_render_line(struct Ppu *ppu, uint8_t *pixelBuffer)
+// Decodes the tiles written since the last line was drawn. Games change
+// tile data far less often than it's drawn, so usually there are none.
+static void update_tile_rows(struct Ppu *ppu)
 {
-    // TODO: window
+    struct Memory *memory = ppu->memory;
+    if ( ! memory->tileDataDirty)
+    {
+        return;
+    }
 
-    struct Object objects[MAX_OBJECTS_PER_LINE];
-    size_t numObjectsOnLine = oam_search(ppu, objects);
-    qsort(objects, numObjectsOnLine, sizeof(struct Object), object_object_render_sorting);
+    for (size_t tile = 0; tile < MEMORY_NUM_TILES; tile++)
+    {
+        if ( ! memory->tileDirty[tile])
+        {
+            continue;
+        }
+        memory->tileDirty[tile] = false;
+
+        const uint8_t *tileData = &memory->vram[tile * MEMORY_TILE_SIZE];
+        for (size_t row = 0; row < PPU_TILE_HEIGHT; row++)
+        {
+            ppu->kernels.decode_tile_row(tileData[2 * row], tileData[2 * row + 1], ppu->tileRows[tile][row], ppu->flippedTileRows[tile][row]);
+        }
+    }
+    memory->tileDataDirty = false;
+}
 
+
+// The background tile patterns are numbered from one of two places in
+// VRAM, and the second is numbered with signed pattern numbers
+static size_t get_background_tile(struct Ppu *ppu, uint8_t tilePatternNumber)
+{
+    if (ppu->backgroundAndWindowTileDataSelect)
+    {
+        return VRAM_TILE_PATTERN_TABLE1_INDEX / MEMORY_TILE_SIZE + tilePatternNumber;
+    }
+    else
+    {
+        return (size_t)(VRAM_TILE_PATTERN_TABLE0_INDEX / MEMORY_TILE_SIZE + (int8_t)tilePatternNumber);
+    }
+}
+
+
+// Finds the background color number of every pixel on the current line.
+// Consecutive pixels share a tile row, so each row is copied out whole,
+// and only the first and last tiles are cut short by the scroll.
+static void render_background_line(struct Ppu *ppu, uint8_t *colorNumbers)
+{
     // Find the effective Y-coordinate for this scan line.
     // From that, find the associated Y-coordinate for the tile grid,
     // as well as the pixel Y-coordinate for the tile for this scanline.
-    uint8_t y0 = ppu->currentLine;
-    uint8_t y = y0 + ppu->scrollY;
+    uint8_t y = ppu->currentLine + ppu->scrollY;
     size_t tileCoordY = y / BACKGROUND_TILE_HEIGHT;
     size_t tilePixelCoordY = y % BACKGROUND_TILE_HEIGHT;
 
-    for (uint8_t x0 = 0; x0 < LCD_WIDTH; x0++)
+    // Select the desired tile map, and the row of it for this scan line
+    const uint8_t *tileMap = &ppu->memory->vram[
+        ppu->backgroundTileMapSelect
+            ? VRAM_TILE_BACKGROUND_MAP1_INDEX
+            : VRAM_TILE_BACKGROUND_MAP0_INDEX
+    ];
+    const uint8_t *tileMapRow = &tileMap[tileCoordY * TILE_GRID_WIDTH];
+
+    // The first tile starts partway through when the scroll isn't a
+    // multiple of the tile width. The grid wraps around horizontally.
+    size_t tileCoordX = ppu->scrollX / BACKGROUND_TILE_WIDTH;
+    size_t tilePixelCoordX = ppu->scrollX % BACKGROUND_TILE_WIDTH;
+
+    size_t x0 = 0;
+    while (x0 < LCD_WIDTH)
     {
-        uint8_t backgroundColorNumber = 0;
-        enum Color pixelColor = COLOR_LIGHTEST;
+        size_t tile = get_background_tile(ppu, tileMapRow[tileCoordX]);
+        const uint8_t *tileRow = ppu->tileRows[tile][tilePixelCoordY];
 
-        if (ppu->backgroundDisplayEnable)
+        size_t numPixels = BACKGROUND_TILE_WIDTH - tilePixelCoordX;
+        if (numPixels > LCD_WIDTH - x0)
         {
-            // Similarly, find the effective X-coordinate for this pixel, etc.
-            uint8_t x = x0 + ppu->scrollX;
-            size_t tileCoordX = x / BACKGROUND_TILE_WIDTH;
-            size_t tilePixelCoordX = x % BACKGROUND_TILE_WIDTH;
-
-            // Once we have the tile grid XY-coordinates,
-            // we can identify the tile grid index for this pixel's tile
-            // (starting with zero at the top-left,
-            // increasing from left-to-right and top-to-bottom).
-            size_t tileIndex = (tileCoordY * TILE_GRID_WIDTH) + tileCoordX;
-
-            // Select the desired tile map.
-            uint8_t *tileMap = &ppu->memory->vram[
-                ppu->backgroundTileMapSelect
-                    ? VRAM_TILE_BACKGROUND_MAP1_INDEX
-                    : VRAM_TILE_BACKGROUND_MAP0_INDEX
-            ];
-
-            // Find the tile pattern of interest
-            uint8_t *tilePattern;
-            if (ppu->backgroundAndWindowTileDataSelect)
-            {
-                uint8_t *tilePatternTable = &ppu->memory->vram[VRAM_TILE_PATTERN_TABLE1_INDEX];
-                uint8_t tilePatternNumber = tileMap[tileIndex];
-                tilePattern = &tilePatternTable[tilePatternNumber * (2 * BACKGROUND_TILE_WIDTH)];
-            }
-            else
-            {
-                uint8_t *tilePatternTable = &ppu->memory->vram[VRAM_TILE_PATTERN_TABLE0_INDEX];
-                int8_t tilePatternNumber = ((int8_t*)tileMap)[tileIndex];
-                tilePattern = &tilePatternTable[tilePatternNumber * (2 * BACKGROUND_TILE_WIDTH)];
-            }
-
-            // Get the tile pattern line of interest,
-            // and the color number of the pixel of interest.
-            uint8_t *tilePatternLine = tilePattern + 2 * tilePixelCoordY;
-            backgroundColorNumber = (
-                ((tilePatternLine[1] & (1 << (7 - tilePixelCoordX))) << 1) |
-                (tilePatternLine[0] & (1 << (7 - tilePixelCoordX)))
-            ) >> (7 - tilePixelCoordX);
-            pixelColor = get_background_palette_color(ppu, backgroundColorNumber);
+            numPixels = LCD_WIDTH - x0;
         }
+        memcpy(&colorNumbers[x0], &tileRow[tilePixelCoordX], numPixels);
 
-        // TODO: clean up sprite code
-        // TODO: 8x16 mode tile selection
+        x0 += numPixels;
+        tileCoordX = (tileCoordX + 1) % TILE_GRID_WIDTH;
+        tilePixelCoordX = 0;
+    }
+}
 
-        // Now look at the objects for this pixel
-        if (ppu->objectDisplayEnable)
+
+// Draws the objects on this line over the background pixels. Objects
+// later in the array are drawn over earlier ones.
+static void render_objects_line(struct Ppu *ppu, const struct Object *objects, size_t numObjects, const uint8_t *backgroundColorNumbers, uint8_t *lineShades)
+{
+    // TODO: clean up sprite code
+    // TODO: 8x16 mode tile selection
+
+    int16_t currentLine = ppu->currentLine;
+    int16_t objectWidth = 8;  // constant
+    int16_t objectHeight = (ppu->objectSize == OBJECT_SIZE_8x16) ? 16 : 8;
+
+    for (size_t i = 0; i < numObjects; i++)
+    {
+        // We already know that the object is visible, so find its row of
+        // pixels for this line. Rows past the end of the object's tile run
+        // on into the tiles after it.
+        const struct Object *obj = &objects[i];
+        int16_t objectPixelY = (currentLine - obj->y) + 2*objectHeight;
+        size_t tileLine = (uint8_t)(obj->yFlip ? (7 - objectPixelY) : objectPixelY);  // TODO: may need to change this for 8x16 sprites
+        size_t tile = obj->patternIndex + tileLine / PPU_TILE_HEIGHT;
+        const uint8_t *tileRow = obj->xFlip
+            ? ppu->flippedTileRows[tile][tileLine % PPU_TILE_HEIGHT]
+            : ppu->tileRows[tile][tileLine % PPU_TILE_HEIGHT];
+        const uint8_t *objectShades = obj->palette ? ppu->objectShades1 : ppu->objectShades0;
+
+        for (int16_t objectPixelX = 0; objectPixelX < objectWidth; objectPixelX++)
         {
-            for (size_t i = 0; i < numObjectsOnLine; i++)
+            int16_t x0 = obj->x - objectWidth + objectPixelX;
+            if (x0 < 0 || x0 >= LCD_WIDTH)
+            {
+                continue;
+            }
+
+            // All object pixels with color number 0 are transparent.
+            uint8_t objectColorNumber = tileRow[objectPixelX];
+            if (objectColorNumber != 0 && ( ! obj->priority || backgroundColorNumbers[x0] == 0))
             {
-                // We already know that the object is visible.
-                // The question is which object pixel aligns with the screen pixel
-                // we're looking at now, if any.
-
-                int16_t currentLine = ppu->currentLine;
-                int16_t objectWidth = 8;  // constant
-                int16_t objectHeight = (ppu->objectSize == OBJECT_SIZE_8x16) ? 16 : 8;
-                // bool currentlyAbove = currentLine <= y - objectHeight;
-                // bool currentlyBelow = currentLine >= y;
-
-                const struct Object *obj = &objects[i];
-                int16_t objectPixelY = (currentLine - obj->y) + 2*objectHeight;
-                int16_t objectPixelX = ((int16_t)x0 - obj->x) + objectWidth;
-                if (objectPixelX >= 0 && objectPixelX < 8)
-                {
-                    size_t tilePatternIndex = obj->patternIndex;
-                    uint8_t *tilePixelData = &ppu->memory->vram[16 * tilePatternIndex];  // TODO: may need to change this for 8x16 sprites
-                    uint8_t *tileLinePixelData = tilePixelData + 2 * (uint8_t)(obj->yFlip ? (7 - objectPixelY) : objectPixelY);  // TODO: may need to change this for 8x16 sprites
-                    uint8_t tileByte0 = tileLinePixelData[0];
-                    uint8_t tileByte1 = tileLinePixelData[1];
-
-                    // TODO: clean up, combine with BG version of this
-                    uint8_t xShift = obj->xFlip ? objectPixelX : (7 - objectPixelX);
-                    uint8_t objectColorNumber = (
-                            ((tileByte1 & (1 << xShift)) << 1) |
-                            (tileByte0 & (1 << xShift))
-                    ) >> xShift;
-
-                    enum Color objectPixelColor;
-                    bool isNotTransparent = get_object_palette_color(ppu, obj->palette, objectColorNumber, &objectPixelColor);
-                    if (isNotTransparent && ( ! obj->priority || backgroundColorNumber == 0))
-                    {
-                        // The "priority" flag is kind of an inversion--
-                        // if it is set, the object's will only draw on top
-                        // of background pixels of color number 0.
-                        pixelColor = objectPixelColor;
-                    }
-                }
+                // The "priority" flag is kind of an inversion--
+                // if it is set, the object's will only draw on top
+                // of background pixels of color number 0.
+                lineShades[x0] = objectShades[objectColorNumber];
             }
         }
+    }
+}
+
+
+static void ppu_render_line(struct Ppu *ppu, uint8_t *pixelBuffer)
+{
+    // TODO: window
 
-        uint8_t r, g, b;
-        get_color_rgb(pixelColor, &r, &g, &b);
+    update_tile_rows(ppu);
 
-        size_t i = y0 * LCD_WIDTH + x0;
-        pixelBuffer[4 * i + 0] = b;
-        pixelBuffer[4 * i + 1] = g;
-        pixelBuffer[4 * i + 2] = r;
-        pixelBuffer[4 * i + 3] = 0xff;
+    struct Object objects[MAX_OBJECTS_PER_LINE];
+    size_t numObjectsOnLine = oam_search(ppu, objects);
+    qsort(objects, numObjectsOnLine, sizeof(struct Object), object_object_render_sorting);
+
+    // The background is drawn as color numbers first, which are then looked
+    // up in the palette all at once
+    uint8_t *lineShades = &pixelBuffer[LCD_WIDTH * ppu->currentLine];
+    uint8_t backgroundColorNumbers[LCD_WIDTH];
+    if (ppu->backgroundDisplayEnable)
+    {
+        render_background_line(ppu, backgroundColorNumbers);
+        ppu->kernels.map_indices(backgroundColorNumbers, LCD_WIDTH, ppu->backgroundShades, lineShades);
+    }
+    else
+    {
+        memset(backgroundColorNumbers, 0, sizeof(backgroundColorNumbers));
+        memset(lineShades, COLOR_LIGHTEST, LCD_WIDTH);
+    }
+
+    if (ppu->objectDisplayEnable)
+    {
+        render_objects_line(ppu, objects, numObjectsOnLine, backgroundColorNumbers, lineShades);
     }
 }
 
@@ -321,69 +361,64 @@ static void ppu_render_line(struct Ppu *ppu, uint8_t *pixelBuffer)
 #define NUM_VBLANK_LINES        10
 
 
-bool ppu_tick(struct Ppu *ppu, struct Cpu *cpu, int cycles, uint8_t *pixelBuffer)
+// Each PPU mode change is a scheduled event. Between them, the PPU state
+// visible to the CPU (mode, LY) does not change.
+static void ppu_handle_event(SchedulerEventFuncContext context, uint64_t time)
 {
     // TODO: LCD disabled? Would have to blank the whole display and reset
     // the line/cycle counter and PPU state machine.
 
-    bool enteringVBlank = false;
+    struct Ppu *ppu = context;
+    uint64_t nextEventTime;
 
     // Advance the line or pixel count, update VRAM/OAM lock state, etc.
-    ppu->cycleCounter += cycles;
     switch (ppu->mode)
     {
     case PPU_MODE_OAM_SEARCH:
-        if (ppu->cycleCounter >= CYCLES_MODE_OAM_SEARCH)
-        {
-            ppu->cycleCounter = 0;
-            ppu->mode = PPU_MODE_DRAWING;
-            // TODO: VRAM/OAM lock
-        }
+        ppu->mode = PPU_MODE_DRAWING;
+        nextEventTime = time + CYCLES_MODE_DRAWING;
+        // TODO: VRAM/OAM lock
         break;
     case PPU_MODE_DRAWING:
-        if (ppu->cycleCounter >= CYCLES_MODE_DRAWING)
-        {
-            ppu->cycleCounter = 0;
-            ppu->mode = PPU_MODE_HBLANK;
-            // TODO: VRAM/OAM lock
-        }
+        ppu->mode = PPU_MODE_HBLANK;
+        nextEventTime = time + CYCLES_MODE_HBLANK;
+        // TODO: VRAM/OAM lock
         break;
     case PPU_MODE_HBLANK:
-        if (ppu->cycleCounter >= CYCLES_MODE_HBLANK)
+        ppu_render_line(ppu, ppu->pixelBuffer);
+        ppu->currentLine += 1;
+        if (ppu->currentLine >= LCD_HEIGHT)
         {
-            ppu->cycleCounter = 0;
-            ppu_render_line(ppu, pixelBuffer);
-            ppu->currentLine += 1;
-            if (ppu->currentLine >= LCD_HEIGHT)
-            {
-                ppu->mode = PPU_MODE_VBLANK;
-                cpu_request_interrupt(cpu, INTERRUPT_VBLANK);
-                enteringVBlank = true;
-            }
-            else
-            {
-                ppu->mode = PPU_MODE_OAM_SEARCH;
-            }
+            ppu->mode = PPU_MODE_VBLANK;
+            nextEventTime = time + CYCLES_PER_LINE;
+            cpu_request_interrupt(ppu->cpu, INTERRUPT_VBLANK);
+            ppu->frameComplete = true;
+        }
+        else
+        {
+            ppu->mode = PPU_MODE_OAM_SEARCH;
+            nextEventTime = time + CYCLES_MODE_OAM_SEARCH;
         }
         break;
     case PPU_MODE_VBLANK:
-        if (ppu->cycleCounter > CYCLES_PER_LINE)
+        ppu->currentLine += 1;
+        if (ppu->currentLine >= LCD_HEIGHT + NUM_VBLANK_LINES)
         {
-            ppu->cycleCounter = 0;
-            ppu->currentLine += 1;
-            if (ppu->currentLine >= LCD_HEIGHT + NUM_VBLANK_LINES)
-            {
-                ppu->currentLine = 0;
-                ppu->mode = PPU_MODE_OAM_SEARCH;
-            }
+            ppu->currentLine = 0;
+            ppu->mode = PPU_MODE_OAM_SEARCH;
+            nextEventTime = time + CYCLES_MODE_OAM_SEARCH;
+        }
+        else
+        {
+            nextEventTime = time + CYCLES_PER_LINE;
         }
         break;
     default:
         assert(false);
-        break;
+        return;
     }
 
-    return enteringVBlank;
+    scheduler_schedule(ppu->scheduler, SCHEDULER_EVENT_PPU, nextEventTime);
 }
 
 
@@ -468,8 +503,8 @@ static void io_handler_write_ly(IoRegisterFuncContext context, uint8_t value)
     (void)value;
     struct Ppu *ppu = context;
     ppu->currentLine = 0;
-    ppu->cycleCounter = 0;
     ppu->mode = PPU_MODE_OAM_SEARCH;
+    scheduler_schedule(ppu->scheduler, SCHEDULER_EVENT_PPU, ppu->scheduler->now + CYCLES_MODE_OAM_SEARCH);
 }
 
 #define IO_REGISTER_LY_COMPARE  0x45
@@ -503,6 +538,7 @@ static void io_handler_write_background_palette(IoRegisterFuncContext context, u
     ppu->backgroundPalette[2] = (enum Color)((value >> 4) & 0x03);
     ppu->backgroundPalette[1] = (enum Color)((value >> 2) & 0x03);
     ppu->backgroundPalette[0] = (enum Color)((value >> 0) & 0x03);
+    update_palette_shades(ppu->backgroundPalette, 4, ppu->backgroundShades);
 }
 
 
@@ -524,6 +560,7 @@ static void io_handler_write_object_palette0(IoRegisterFuncContext context, uint
     ppu->objectPalette0[1] = (enum Color)((value >> 4) & 0x03);
     ppu->objectPalette0[0] = (enum Color)((value >> 2) & 0x03);
     // lowest two bits are unused (transparent)
+    update_palette_shades(ppu->objectPalette0, 3, &ppu->objectShades0[1]);
 }
 
 
@@ -545,6 +582,7 @@ static void io_handler_write_object_palette1(IoRegisterFuncContext context, uint
     ppu->objectPalette1[1] = (enum Color)((value >> 4) & 0x03);
     ppu->objectPalette1[0] = (enum Color)((value >> 2) & 0x03);
     // lowest two bits are unused (transparent)
+    update_palette_shades(ppu->objectPalette1, 3, &ppu->objectShades1[1]);
 }
 
 
@@ -574,10 +612,10 @@ static void io_handler_write_window_x(IoRegisterFuncContext context, uint8_t val
 
 
 
-void ppu_init(struct Ppu *ppu, struct Memory *memory)
+void ppu_init(struct Ppu *ppu, struct Memory *memory, struct Scheduler *scheduler, struct Cpu *cpu, uint8_t *pixelBuffer)
 {
-    ppu->cycleCounter = 0;
     ppu->mode = PPU_MODE_OAM_SEARCH;
+    ppu->frameComplete = false;
 
     ppu->currentLine = 0;
     ppu->scrollX = 0;
@@ -594,6 +632,28 @@ void ppu_init(struct Ppu *ppu, struct Memory *memory)
     ppu->objectDisplayEnable = false;
     ppu->backgroundDisplayEnable = true;
 
+    for (size_t i = 0; i < 4; i++)
+    {
+        ppu->backgroundPalette[i] = COLOR_LIGHTEST;
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+        ppu->objectPalette0[i] = COLOR_LIGHTEST;
+        ppu->objectPalette1[i] = COLOR_LIGHTEST;
+    }
+    ppu->objectShades0[0] = COLOR_LIGHTEST;
+    ppu->objectShades1[0] = COLOR_LIGHTEST;
+    update_all_palette_shades(ppu);
+    ppu_set_lcd_palette(ppu, LCD_PALETTE_GRAY);
+
+    pixel_kernels_init(&ppu->kernels);
+
+    ppu->pixelBuffer = pixelBuffer;
+    ppu->cpu = cpu;
+    ppu->scheduler = scheduler;
+    scheduler_register_event(scheduler, SCHEDULER_EVENT_PPU, ppu_handle_event, ppu);
+    scheduler_schedule(scheduler, SCHEDULER_EVENT_PPU, scheduler->now + CYCLES_MODE_OAM_SEARCH);
+
     ppu->memory = memory;
     memory_register_io_handler(
         ppu->memory,
@@ -673,3 +733,84 @@ void ppu_init(struct Ppu *ppu, struct Memory *memory)
         ppu
     );
 }
+
+
+void ppu_set_lcd_palette(struct Ppu *ppu, enum LcdPalette lcdPalette)
+{
+    assert(lcdPalette == LCD_PALETTE_GRAY || lcdPalette == LCD_PALETTE_GREEN);
+    ppu->lcdPalette = lcdPalette;
+    for (size_t i = 0; i < 4; i++)
+    {
+        ppu->lcdPixels[i] = get_lcd_pixel(lcdPalette, (enum Color)i);
+    }
+}
+
+
+void ppu_expand_pixels(const struct Ppu *ppu, uint8_t *pixels)
+{
+    ppu->kernels.expand_pixels(ppu->pixelBuffer, LCD_WIDTH * LCD_HEIGHT, ppu->lcdPixels, pixels);
+}
+
+
+void ppu_save_state(const struct Ppu *ppu, struct PpuState *state)
+{
+    state->mode = (uint8_t)ppu->mode;
+    state->currentLine = ppu->currentLine;
+    state->currentLineCompare = ppu->currentLineCompare;
+    state->scrollX = ppu->scrollX;
+    state->scrollY = ppu->scrollY;
+    state->windowX = ppu->windowX;
+    state->windowY = ppu->windowY;
+
+    state->lcdEnable = ppu->lcdEnable;
+    state->windowTileMapSelect = ppu->windowTileMapSelect;
+    state->windowDisplayEnable = ppu->windowDisplayEnable;
+    state->backgroundAndWindowTileDataSelect = ppu->backgroundAndWindowTileDataSelect;
+    state->backgroundTileMapSelect = ppu->backgroundTileMapSelect;
+    state->objectSize = ppu->objectSize;
+    state->objectDisplayEnable = ppu->objectDisplayEnable;
+    state->backgroundDisplayEnable = ppu->backgroundDisplayEnable;
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        state->backgroundPalette[i] = (uint8_t)ppu->backgroundPalette[i];
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+        state->objectPalette0[i] = (uint8_t)ppu->objectPalette0[i];
+        state->objectPalette1[i] = (uint8_t)ppu->objectPalette1[i];
+    }
+}
+
+
+void ppu_load_state(struct Ppu *ppu, const struct PpuState *state)
+{
+    ppu->mode = (enum PpuMode)(state->mode & 0x03);
+    ppu->frameComplete = false;
+    ppu->currentLine = state->currentLine;
+    ppu->currentLineCompare = state->currentLineCompare;
+    ppu->scrollX = state->scrollX;
+    ppu->scrollY = state->scrollY;
+    ppu->windowX = state->windowX;
+    ppu->windowY = state->windowY;
+
+    ppu->lcdEnable = state->lcdEnable != 0;
+    ppu->windowTileMapSelect = state->windowTileMapSelect != 0;
+    ppu->windowDisplayEnable = state->windowDisplayEnable != 0;
+    ppu->backgroundAndWindowTileDataSelect = state->backgroundAndWindowTileDataSelect != 0;
+    ppu->backgroundTileMapSelect = state->backgroundTileMapSelect != 0;
+    ppu->objectSize = state->objectSize != 0;
+    ppu->objectDisplayEnable = state->objectDisplayEnable != 0;
+    ppu->backgroundDisplayEnable = state->backgroundDisplayEnable != 0;
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        ppu->backgroundPalette[i] = (enum Color)(state->backgroundPalette[i] & 0x03);
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+        ppu->objectPalette0[i] = (enum Color)(state->objectPalette0[i] & 0x03);
+        ppu->objectPalette1[i] = (enum Color)(state->objectPalette1[i] & 0x03);
+    }
+    update_all_palette_shades(ppu);
+}
@@ -5,9 +5,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "lcd.h"
+#include "memory.h"
+#include "pixel_kernels.h"
+
 
-struct Memory;
 struct Cpu;
+struct Scheduler;
 
 
 enum Color
@@ -19,6 +23,10 @@ enum Color
 };
 
 
+#define PPU_TILE_WIDTH   8
+#define PPU_TILE_HEIGHT  8
+
+
 enum PpuMode
 {
     PPU_MODE_HBLANK = 0,
@@ -30,9 +38,12 @@ enum PpuMode
 
 struct Ppu
 {
-    int cycleCounter;
     enum PpuMode mode;
 
+    // Set when the PPU enters VBlank with a complete frame in pixelBuffer.
+    // The owner of the pixel buffer is responsible for clearing it.
+    bool frameComplete;
+
     uint8_t currentLine;
     uint8_t currentLineCompare;
     uint8_t scrollX;
@@ -53,12 +64,72 @@ struct Ppu
     enum Color objectPalette0[3];
     enum Color objectPalette1[3];
 
+    // The shade for each color number in the palettes above, as bytes for
+    // drawing with. Object color number 0 is transparent, so its entry is
+    // unused.
+    uint8_t backgroundShades[4];
+    uint8_t objectShades0[4];
+    uint8_t objectShades1[4];
+
+    // The pixel for each shade, when the pixel buffer is expanded
+    enum LcdPalette lcdPalette;
+    uint32_t lcdPixels[4];
+
+    // Color numbers for each row of each tile in VRAM, leftmost pixel
+    // first, decoded as the memory reports tiles changing. Objects can be
+    // flipped horizontally, so the rows are kept mirrored as well.
+    uint8_t tileRows[MEMORY_NUM_TILES][PPU_TILE_HEIGHT][PPU_TILE_WIDTH];
+    uint8_t flippedTileRows[MEMORY_NUM_TILES][PPU_TILE_HEIGHT][PPU_TILE_WIDTH];
+    struct PixelKernels kernels;
+
+    // One byte per pixel, holding its shade (enum Color)
+    uint8_t *pixelBuffer;
     struct Memory *memory;
+    struct Scheduler *scheduler;
+    struct Cpu *cpu;
 };
 
+// Register values for save states. The pixel buffer isn't included; it's
+// redrawn as the PPU runs, nor are the decoded tiles, which are redone
+// from the restored VRAM. The LCD palette is the frontend's choice, so it
+// stays as it is.
+struct PpuState
+{
+    uint8_t mode;
+    uint8_t currentLine;
+    uint8_t currentLineCompare;
+    uint8_t scrollX;
+    uint8_t scrollY;
+    uint8_t windowX;
+    uint8_t windowY;
+
+    uint8_t lcdEnable;
+    uint8_t windowTileMapSelect;
+    uint8_t windowDisplayEnable;
+    uint8_t backgroundAndWindowTileDataSelect;
+    uint8_t backgroundTileMapSelect;
+    uint8_t objectSize;
+    uint8_t objectDisplayEnable;
+    uint8_t backgroundDisplayEnable;
+
+    uint8_t backgroundPalette[4];
+    uint8_t objectPalette0[3];
+    uint8_t objectPalette1[3];
+};
+
+
+void ppu_init(struct Ppu *ppu, struct Memory *memory, struct Scheduler *scheduler, struct Cpu *cpu, uint8_t *pixelBuffer);
+
+// Takes effect from the next ppu_expand_pixels
+void ppu_set_lcd_palette(struct Ppu *ppu, enum LcdPalette lcdPalette);
+
+// Converts the shades in the pixel buffer to B, G, R, A pixels in the LCD
+// palette (4 * LCD_WIDTH * LCD_HEIGHT bytes), for showing or saving the
+// frame. Nothing else needs colors, so only do this when they're wanted.
+void ppu_expand_pixels(const struct Ppu *ppu, uint8_t *pixels);
 
-void ppu_init(struct Ppu *ppu, struct Memory *memory);
-bool ppu_tick(struct Ppu *ppu, struct Cpu *cpu, int cycles, uint8_t *pixelBuffer);
+void ppu_save_state(const struct Ppu *ppu, struct PpuState *state);
+void ppu_load_state(struct Ppu *ppu, const struct PpuState *state);
 
 
 #endif
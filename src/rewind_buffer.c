@@ -0,0 +1,291 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "rewind_buffer.h"
+#include "save_state.h"
+#include "gameboy.h"
+
+
+// Each delta is stored in the ring as its length, the encoded bytes, then
+// the length again, so entries can be walked from either end: the oldest
+// are dropped from the front and rewinding pops from the back.
+//
+// The encoding is a sequence of (number of unchanged bytes, number of
+// changed bytes, XOR of the changed bytes) with both counts as LEB128.
+typedef uint32_t EntryLength;
+
+struct RewindBuffer
+{
+    size_t snapshotInterval;
+    size_t framesUntilSnapshot;
+
+    size_t stateSize;
+
+    // Whole copy of the newest snapshot, and space to capture the next
+    // one. These come from malloc, so they're aligned for save states.
+    uint8_t *newest;
+    uint8_t *capture;
+
+    // Large enough for the worst case delta
+    uint8_t *encoded;
+    size_t encodedCapacity;
+
+    uint8_t *ring;
+    size_t ringSize;
+    size_t ringStart;
+    size_t ringUsed;
+
+    // Including the newest, so one more than the number of deltas
+    size_t numSnapshots;
+};
+
+
+static size_t worst_case_encoded_size(size_t stateSize)
+{
+    // Alternating single changed and unchanged bytes is the worst case, at
+    // three bytes of output for every two of input
+    return stateSize * 2 + 32;
+}
+
+
+struct RewindBuffer* rewind_buffer_create(const struct GameBoy *gameBoy, size_t memoryBudget, size_t snapshotInterval)
+{
+    size_t stateSize = gameboy_save_state_size(gameBoy);
+    size_t encodedCapacity = worst_case_encoded_size(stateSize);
+    size_t fixedSize = sizeof(struct RewindBuffer) + 2 * stateSize + encodedCapacity;
+    if (snapshotInterval == 0 || memoryBudget <= fixedSize)
+    {
+        return NULL;
+    }
+
+    struct RewindBuffer *rewindBuffer = calloc(1, sizeof(struct RewindBuffer));
+    if (rewindBuffer == NULL)
+    {
+        return NULL;
+    }
+    rewindBuffer->snapshotInterval = snapshotInterval;
+    rewindBuffer->framesUntilSnapshot = 1;
+    rewindBuffer->stateSize = stateSize;
+    rewindBuffer->encodedCapacity = encodedCapacity;
+    rewindBuffer->ringSize = memoryBudget - fixedSize;
+    rewindBuffer->ringStart = 0;
+    rewindBuffer->ringUsed = 0;
+    rewindBuffer->numSnapshots = 0;
+
+    // The ring isn't touched until it's needed, so the OS only commits as
+    // much of the budget as the history actually uses
+    rewindBuffer->newest = malloc(stateSize);
+    rewindBuffer->capture = malloc(stateSize);
+    rewindBuffer->encoded = malloc(encodedCapacity);
+    rewindBuffer->ring = malloc(rewindBuffer->ringSize);
+    if (rewindBuffer->newest == NULL || rewindBuffer->capture == NULL || rewindBuffer->encoded == NULL || rewindBuffer->ring == NULL)
+    {
+        rewind_buffer_destroy(rewindBuffer);
+        return NULL;
+    }
+    return rewindBuffer;
+}
+
+
+void rewind_buffer_destroy(struct RewindBuffer *rewindBuffer)
+{
+    if (rewindBuffer != NULL)
+    {
+        free(rewindBuffer->ring);
+        free(rewindBuffer->encoded);
+        free(rewindBuffer->capture);
+        free(rewindBuffer->newest);
+        free(rewindBuffer);
+    }
+}
+
+
+static void ring_write(struct RewindBuffer *rewindBuffer, size_t offset, const void *data, size_t length)
+{
+    offset %= rewindBuffer->ringSize;
+    size_t firstPart = rewindBuffer->ringSize - offset;
+    if (firstPart > length)
+    {
+        firstPart = length;
+    }
+    memcpy(rewindBuffer->ring + offset, data, firstPart);
+    memcpy(rewindBuffer->ring, (const uint8_t*)data + firstPart, length - firstPart);
+}
+
+static void ring_read(const struct RewindBuffer *rewindBuffer, size_t offset, void *data, size_t length)
+{
+    offset %= rewindBuffer->ringSize;
+    size_t firstPart = rewindBuffer->ringSize - offset;
+    if (firstPart > length)
+    {
+        firstPart = length;
+    }
+    memcpy(data, rewindBuffer->ring + offset, firstPart);
+    memcpy((uint8_t*)data + firstPart, rewindBuffer->ring, length - firstPart);
+}
+
+
+static uint8_t* write_length(uint8_t *output, size_t value)
+{
+    while (value >= 0x80)
+    {
+        *output++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *output++ = (uint8_t)value;
+    return output;
+}
+
+static const uint8_t* read_length(const uint8_t *input, size_t *value)
+{
+    *value = 0;
+    for (unsigned shift = 0; ; shift += 7)
+    {
+        uint8_t byte = *input++;
+        *value |= (size_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return input;
+        }
+    }
+}
+
+
+// Returns the encoded length of newer XOR older
+static size_t encode_delta(uint8_t *output, const uint8_t *older, const uint8_t *newer, size_t size)
+{
+    uint8_t *start = output;
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t unchangedStart = i;
+        while (i < size && older[i] == newer[i])
+        {
+            i++;
+        }
+        size_t changedStart = i;
+        while (i < size && older[i] != newer[i])
+        {
+            i++;
+        }
+
+        output = write_length(output, changedStart - unchangedStart);
+        output = write_length(output, i - changedStart);
+        for (size_t j = changedStart; j < i; j++)
+        {
+            *output++ = older[j] ^ newer[j];
+        }
+    }
+    return (size_t)(output - start);
+}
+
+static void apply_delta(uint8_t *state, const uint8_t *input, size_t encodedLength)
+{
+    const uint8_t *end = input + encodedLength;
+    size_t i = 0;
+    while (input < end)
+    {
+        size_t unchanged;
+        size_t changed;
+        input = read_length(input, &unchanged);
+        input = read_length(input, &changed);
+        i += unchanged;
+        for (size_t j = 0; j < changed; j++)
+        {
+            state[i++] ^= *input++;
+        }
+    }
+}
+
+
+static void drop_oldest_delta(struct RewindBuffer *rewindBuffer)
+{
+    EntryLength length;
+    ring_read(rewindBuffer, rewindBuffer->ringStart, &length, sizeof(length));
+    size_t entrySize = length + 2 * sizeof(EntryLength);
+    rewindBuffer->ringStart = (rewindBuffer->ringStart + entrySize) % rewindBuffer->ringSize;
+    rewindBuffer->ringUsed -= entrySize;
+    rewindBuffer->numSnapshots -= 1;
+}
+
+
+static void capture_snapshot(struct RewindBuffer *rewindBuffer)
+{
+    if (rewindBuffer->numSnapshots > 0)
+    {
+        EntryLength length = (EntryLength)encode_delta(rewindBuffer->encoded, rewindBuffer->newest, rewindBuffer->capture, rewindBuffer->stateSize);
+        size_t entrySize = length + 2 * sizeof(EntryLength);
+        if (entrySize > rewindBuffer->ringSize)
+        {
+            // Can't link it to the history, so start over from here
+            rewindBuffer->ringStart = 0;
+            rewindBuffer->ringUsed = 0;
+            rewindBuffer->numSnapshots = 0;
+        }
+        else
+        {
+            while (rewindBuffer->ringSize - rewindBuffer->ringUsed < entrySize)
+            {
+                drop_oldest_delta(rewindBuffer);
+            }
+
+            size_t offset = rewindBuffer->ringStart + rewindBuffer->ringUsed;
+            ring_write(rewindBuffer, offset, &length, sizeof(length));
+            ring_write(rewindBuffer, offset + sizeof(length), rewindBuffer->encoded, length);
+            ring_write(rewindBuffer, offset + sizeof(length) + length, &length, sizeof(length));
+            rewindBuffer->ringUsed += entrySize;
+        }
+    }
+
+    uint8_t *previous = rewindBuffer->newest;
+    rewindBuffer->newest = rewindBuffer->capture;
+    rewindBuffer->capture = previous;
+    rewindBuffer->numSnapshots += 1;
+}
+
+
+bool rewind_buffer_record_frame(struct RewindBuffer *rewindBuffer, const struct GameBoy *gameBoy)
+{
+    rewindBuffer->framesUntilSnapshot -= 1;
+    if (rewindBuffer->framesUntilSnapshot > 0)
+    {
+        return true;
+    }
+    rewindBuffer->framesUntilSnapshot = rewindBuffer->snapshotInterval;
+
+    if ( ! gameboy_save_state(gameBoy, rewindBuffer->capture, rewindBuffer->stateSize))
+    {
+        return false;
+    }
+    capture_snapshot(rewindBuffer);
+    return true;
+}
+
+
+bool rewind_buffer_step_back(struct RewindBuffer *rewindBuffer, struct GameBoy *gameBoy)
+{
+    if (rewindBuffer->numSnapshots == 0 || ! gameboy_load_state(gameBoy, rewindBuffer->newest, rewindBuffer->stateSize))
+    {
+        return false;
+    }
+
+    // Record the first snapshot after rewinding one interval from now, as
+    // if the restored one had just been taken
+    rewindBuffer->framesUntilSnapshot = rewindBuffer->snapshotInterval;
+
+    if (rewindBuffer->numSnapshots > 1)
+    {
+        size_t end = rewindBuffer->ringStart + rewindBuffer->ringUsed;
+        EntryLength length;
+        ring_read(rewindBuffer, end - sizeof(length), &length, sizeof(length));
+        size_t entrySize = length + 2 * sizeof(EntryLength);
+        ring_read(rewindBuffer, end - sizeof(length) - length, rewindBuffer->encoded, length);
+        apply_delta(rewindBuffer->newest, rewindBuffer->encoded, length);
+
+        rewindBuffer->ringUsed -= entrySize;
+        rewindBuffer->numSnapshots -= 1;
+    }
+    return true;
+}
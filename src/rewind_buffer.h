@@ -0,0 +1,36 @@
+
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+struct GameBoy;
+
+
+// Keeps a history of save states for stepping backwards in time. The
+// newest snapshot is kept whole; every older one is stored as the XOR of
+// itself and the snapshot after it, run length encoded. Nearby states
+// differ in only a small fraction of their bytes (mostly in WRAM and
+// VRAM), so that's far smaller than a full snapshot. When the deltas fill
+// the memory budget, the oldest ones are dropped.
+
+struct RewindBuffer;
+
+// memoryBudget covers everything, including the two full snapshots needed
+// for encoding. A snapshot is captured every snapshotInterval frames.
+// Returns NULL if the budget is too small to hold any history.
+struct RewindBuffer* rewind_buffer_create(const struct GameBoy *gameBoy, size_t memoryBudget, size_t snapshotInterval);
+void rewind_buffer_destroy(struct RewindBuffer *rewindBuffer);
+
+// Call once per frame while running forwards
+bool rewind_buffer_record_frame(struct RewindBuffer *rewindBuffer, const struct GameBoy *gameBoy);
+
+// Restores the newest snapshot and forgets it, so that the next call goes
+// further back. The oldest snapshot is never forgotten, so holding the
+// rewind key at the start of the history stays there. Returns false if
+// nothing has been recorded yet.
+bool rewind_buffer_step_back(struct RewindBuffer *rewindBuffer, struct GameBoy *gameBoy);
+
+
+#endif
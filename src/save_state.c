@@ -0,0 +1,99 @@
+
+#include <string.h>
+
+#include "save_state.h"
+#include "gameboy.h"
+
+
+static bool is_aligned(const void *buffer)
+{
+    return ((uintptr_t)buffer % _Alignof(struct SaveState)) == 0;
+}
+
+
+static void get_rom_identity(const struct Memory *memory, uint64_t *romSize, uint16_t *globalChecksum, uint8_t *headerChecksum)
+{
+    *romSize = memory->numRomBanks * MEMORY_ROM_BANK_SIZE;
+    *globalChecksum = ((uint16_t)memory->rom[0x014e] << 8) | memory->rom[0x014f];
+    *headerChecksum = memory->rom[0x014d];
+}
+
+
+size_t gameboy_save_state_size(const struct GameBoy *gameBoy)
+{
+    return sizeof(struct SaveState) + gameBoy->memory.externalRamSize;
+}
+
+
+bool gameboy_save_state(const struct GameBoy *gameBoy, void *buffer, size_t bufferSize)
+{
+    size_t size = gameboy_save_state_size(gameBoy);
+    if (bufferSize < size || ! is_aligned(buffer))
+    {
+        return false;
+    }
+
+    // Clear the padding too, so that identical machines produce identical
+    // snapshots that can be compared or diffed byte by byte
+    struct SaveState *state = buffer;
+    memset(state, 0, sizeof(*state));
+    state->magic = SAVE_STATE_MAGIC;
+    state->version = SAVE_STATE_VERSION;
+    state->size = size;
+    get_rom_identity(&gameBoy->memory, &state->romSize, &state->romGlobalChecksum, &state->romHeaderChecksum);
+
+    scheduler_save_state(&gameBoy->scheduler, &state->scheduler);
+    cpu_save_state(&gameBoy->cpu, &state->cpu);
+    memory_save_state(&gameBoy->memory, &state->memory);
+    ppu_save_state(&gameBoy->ppu, &state->ppu);
+    timer_save_state(&gameBoy->timer, &state->timer);
+    dma_save_state(&gameBoy->dma, &state->dma);
+    serial_save_state(&gameBoy->serial, &state->serial);
+    keypad_save_state(&gameBoy->keypad, &state->keypad);
+
+    uint8_t *externalRam = (uint8_t*)buffer + sizeof(struct SaveState);
+    if (gameBoy->memory.externalRamSize > 0)
+    {
+        memcpy(externalRam, gameBoy->memory.externalRam, gameBoy->memory.externalRamSize);
+    }
+    return true;
+}
+
+
+bool gameboy_load_state(struct GameBoy *gameBoy, const void *buffer, size_t bufferSize)
+{
+    size_t size = gameboy_save_state_size(gameBoy);
+    if (bufferSize < size || ! is_aligned(buffer))
+    {
+        return false;
+    }
+
+    const struct SaveState *state = buffer;
+    uint64_t romSize;
+    uint16_t romGlobalChecksum;
+    uint8_t romHeaderChecksum;
+    get_rom_identity(&gameBoy->memory, &romSize, &romGlobalChecksum, &romHeaderChecksum);
+    if (state->magic != SAVE_STATE_MAGIC || state->version != SAVE_STATE_VERSION || state->size != size
+        || state->romSize != romSize || state->romGlobalChecksum != romGlobalChecksum || state->romHeaderChecksum != romHeaderChecksum)
+    {
+        return false;
+    }
+
+    scheduler_load_state(&gameBoy->scheduler, &state->scheduler);
+    cpu_load_state(&gameBoy->cpu, &state->cpu);
+    memory_load_state(&gameBoy->memory, &state->memory);
+    ppu_load_state(&gameBoy->ppu, &state->ppu);
+    timer_load_state(&gameBoy->timer, &state->timer);
+    dma_load_state(&gameBoy->dma, &state->dma);
+    serial_load_state(&gameBoy->serial, &state->serial);
+    keypad_load_state(&gameBoy->keypad, &state->keypad);
+
+    const uint8_t *externalRam = (const uint8_t*)buffer + sizeof(struct SaveState);
+    if (gameBoy->memory.externalRamSize > 0)
+    {
+        memcpy(gameBoy->memory.externalRam, externalRam, gameBoy->memory.externalRamSize);
+    }
+
+    gameBoy->deadlineReached = false;
+    return true;
+}
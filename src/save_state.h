@@ -0,0 +1,70 @@
+
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "memory.h"
+#include "ppu.h"
+#include "timer.h"
+#include "dma.h"
+#include "serial.h"
+#include "keypad.h"
+#include "scheduler.h"
+
+struct GameBoy;
+
+
+// Bump this whenever any of the *State structs change, so that older
+// snapshots are rejected instead of misread
+#define SAVE_STATE_VERSION  1
+
+// "GBSS" when stored little endian
+#define SAVE_STATE_MAGIC  0x53534247
+
+
+// A snapshot is this struct followed by the cartridge's external RAM.
+// It uses the host's native layout and byte order, so it's meant for
+// snapshotting and restoring on the same machine rather than as a portable
+// file format. Saving and loading is just copying; nothing is allocated.
+struct SaveState
+{
+    uint32_t magic;
+    uint32_t version;
+
+    // Including the external RAM that follows
+    uint64_t size;
+
+    // Identifies the ROM, so a state can't be loaded into a different game
+    uint64_t romSize;
+    uint16_t romGlobalChecksum;
+    uint8_t romHeaderChecksum;
+
+    struct SchedulerState scheduler;
+    struct CpuState cpu;
+    struct MemoryState memory;
+    struct PpuState ppu;
+    struct TimerState timer;
+    struct DmaState dma;
+    struct SerialState serial;
+    struct KeypadState keypad;
+};
+
+
+// Size of the buffer needed to save this GameBoy's state
+size_t gameboy_save_state_size(const struct GameBoy *gameBoy);
+
+// The buffer must be aligned at least as strictly as malloc aligns.
+// Returns false if it's too small or misaligned.
+bool gameboy_save_state(const struct GameBoy *gameBoy, void *buffer, size_t bufferSize);
+
+// Returns false, leaving the GameBoy untouched, if the buffer doesn't hold
+// a state of this version saved from the same ROM. The pixel buffer isn't
+// part of the state; the next frame redraws it.
+bool gameboy_load_state(struct GameBoy *gameBoy, const void *buffer, size_t bufferSize);
+
+
+#endif
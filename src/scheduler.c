@@ -0,0 +1,105 @@
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "scheduler.h"
+
+
+static void update_next_event_time(struct Scheduler *scheduler)
+{
+    uint64_t nextEventTime = SCHEDULER_NEVER;
+    for (size_t i = 0; i < SCHEDULER_NUM_EVENT_TYPES; i++)
+    {
+        if (scheduler->events[i].time < nextEventTime)
+        {
+            nextEventTime = scheduler->events[i].time;
+        }
+    }
+    scheduler->nextEventTime = nextEventTime;
+}
+
+
+void scheduler_init(struct Scheduler *scheduler)
+{
+    scheduler->now = 0;
+    scheduler->nextEventTime = SCHEDULER_NEVER;
+    for (size_t i = 0; i < SCHEDULER_NUM_EVENT_TYPES; i++)
+    {
+        scheduler->events[i].time = SCHEDULER_NEVER;
+        scheduler->events[i].func = NULL;
+        scheduler->events[i].context = NULL;
+    }
+}
+
+
+void scheduler_register_event(struct Scheduler *scheduler, enum SchedulerEventType type, SchedulerEventFunc func, SchedulerEventFuncContext context)
+{
+    assert(type < SCHEDULER_NUM_EVENT_TYPES);
+    struct SchedulerEvent *event = &scheduler->events[type];
+    assert(event->func == NULL);
+    event->func = func;
+    event->context = context;
+}
+
+
+void scheduler_schedule(struct Scheduler *scheduler, enum SchedulerEventType type, uint64_t time)
+{
+    assert(type < SCHEDULER_NUM_EVENT_TYPES);
+    assert(scheduler->events[type].func != NULL);
+    scheduler->events[type].time = time;
+    update_next_event_time(scheduler);
+}
+
+
+void scheduler_cancel(struct Scheduler *scheduler, enum SchedulerEventType type)
+{
+    assert(type < SCHEDULER_NUM_EVENT_TYPES);
+    scheduler->events[type].time = SCHEDULER_NEVER;
+    update_next_event_time(scheduler);
+}
+
+
+// Run every event whose deadline has passed, earliest first.
+// Callbacks may schedule new events, including ones that are already due.
+void scheduler_run_due_events(struct Scheduler *scheduler)
+{
+    while (scheduler->nextEventTime <= scheduler->now)
+    {
+        struct SchedulerEvent *event = NULL;
+        for (size_t i = 0; i < SCHEDULER_NUM_EVENT_TYPES; i++)
+        {
+            if (scheduler->events[i].time == scheduler->nextEventTime)
+            {
+                event = &scheduler->events[i];
+                break;
+            }
+        }
+        assert(event != NULL);
+
+        uint64_t time = event->time;
+        event->time = SCHEDULER_NEVER;
+        update_next_event_time(scheduler);
+        event->func(event->context, time);
+    }
+}
+
+
+void scheduler_save_state(const struct Scheduler *scheduler, struct SchedulerState *state)
+{
+    state->now = scheduler->now;
+    for (size_t i = 0; i < SCHEDULER_NUM_EVENT_TYPES; i++)
+    {
+        state->eventTimes[i] = scheduler->events[i].time;
+    }
+}
+
+
+void scheduler_load_state(struct Scheduler *scheduler, const struct SchedulerState *state)
+{
+    scheduler->now = state->now;
+    for (size_t i = 0; i < SCHEDULER_NUM_EVENT_TYPES; i++)
+    {
+        scheduler->events[i].time = state->eventTimes[i];
+    }
+    update_next_event_time(scheduler);
+}
@@ -0,0 +1,69 @@
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define SCHEDULER_NEVER  UINT64_MAX
+
+
+// Each subsystem owns one slot in the event queue, so scheduling an event
+// for a subsystem replaces any event it already had pending.
+enum SchedulerEventType
+{
+    SCHEDULER_EVENT_PPU,
+    SCHEDULER_EVENT_TIMER,
+    SCHEDULER_EVENT_DMA,
+    SCHEDULER_EVENT_SERIAL,
+    SCHEDULER_EVENT_DEADLINE,
+    SCHEDULER_NUM_EVENT_TYPES,
+};
+
+
+// Allow other systems to register a callback function to run once the
+// global cycle counter reaches their deadline, along with the necessary
+// context (e.g. a Ppu* or Timer*). The callback is given the time the event
+// was scheduled for, which may be slightly earlier than the current time.
+typedef void *SchedulerEventFuncContext;
+typedef void (*SchedulerEventFunc)(SchedulerEventFuncContext, uint64_t);
+
+struct SchedulerEvent
+{
+    uint64_t time;
+    SchedulerEventFunc func;
+    SchedulerEventFuncContext context;
+};
+
+struct Scheduler
+{
+    // Machine cycles elapsed since power on
+    uint64_t now;
+
+    // Earliest time in events[] (SCHEDULER_NEVER if nothing is pending)
+    uint64_t nextEventTime;
+
+    struct SchedulerEvent events[SCHEDULER_NUM_EVENT_TYPES];
+};
+
+// The callbacks are registered by each subsystem's init function, so only
+// the times need to be saved
+struct SchedulerState
+{
+    uint64_t now;
+    uint64_t eventTimes[SCHEDULER_NUM_EVENT_TYPES];
+};
+
+
+void scheduler_init(struct Scheduler *scheduler);
+void scheduler_register_event(struct Scheduler *scheduler, enum SchedulerEventType type, SchedulerEventFunc func, SchedulerEventFuncContext context);
+void scheduler_schedule(struct Scheduler *scheduler, enum SchedulerEventType type, uint64_t time);
+void scheduler_cancel(struct Scheduler *scheduler, enum SchedulerEventType type);
+void scheduler_run_due_events(struct Scheduler *scheduler);
+
+void scheduler_save_state(const struct Scheduler *scheduler, struct SchedulerState *state);
+void scheduler_load_state(struct Scheduler *scheduler, const struct SchedulerState *state);
+
+
+#endif
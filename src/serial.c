@@ -2,13 +2,43 @@
 #include "serial.h"
 #include "memory.h"
 #include "cpu.h"
+#include "scheduler.h"
 
 
 // When the internal clock is selected, bits are shifted in and out at 8192 Hz.
-#define MACHINE_CYCLE_FREQUENCY      1000000  // 1 MHz
+#define MACHINE_CYCLE_FREQUENCY      1048576  // 1 MiHz
 #define SERIAL_STEP_CYCLES_INTERNAL  (MACHINE_CYCLE_FREQUENCY / 8192)
 
 
+static void serial_handle_transfer_step(SchedulerEventFuncContext context, uint64_t time)
+{
+    // FUTURE: Support a link partner, possibly as another emulator
+    //   connected via TCP/IP. Currently only zeros are shifted in
+    //   and there is no external clock signal.
+
+    struct Serial *serial = context;
+
+    uint8_t incomingBit = 0;
+    uint8_t outgoingBit = (serial->outgoingData & (1 << 7)) >> 7;
+
+    serial->incomingData = (serial->incomingData << 1) | incomingBit;
+    serial->outgoingData = (serial->outgoingData << 1) | outgoingBit;
+    serial->transferStepsRemaining -= 1;
+
+    if (serial->transferStepsRemaining == 0)
+    {
+        cpu_request_interrupt(serial->cpu, INTERRUPT_SERIAL);
+        serial->transferInProgress = false;
+        serial->startTransfer = false;
+        serial->transferComplete = true;
+    }
+    else
+    {
+        scheduler_schedule(serial->scheduler, SCHEDULER_EVENT_SERIAL, time + SERIAL_STEP_CYCLES_INTERNAL);
+    }
+}
+
+
 #define IO_REGISTER_SB  0x01
 static uint8_t io_handler_read_sb_register(IoRegisterFuncContext context)
 {
@@ -38,10 +68,20 @@ static void io_handler_write_sc_register(IoRegisterFuncContext context, uint8_t
     struct Serial *serial = context;
     serial->startTransfer = (value & (1 << 7)) != 0;
     serial->internalClockSelect = (value & (1 << 0)) != 0;
+
+    // External clock not supported
+    if (serial->startTransfer && serial->internalClockSelect && ! serial->transferInProgress)
+    {
+        serial->transferInProgress = true;
+        serial->transferStepsRemaining = 8;
+        serial->outgoingData = serial->dataToSend;
+        serial->incomingData = 0x00;
+        scheduler_schedule(serial->scheduler, SCHEDULER_EVENT_SERIAL, serial->scheduler->now + SERIAL_STEP_CYCLES_INTERNAL);
+    }
 }
 
 
-void serial_init(struct Serial *serial, struct Memory *memory)
+void serial_init(struct Serial *serial, struct Memory *memory, struct Scheduler *scheduler, struct Cpu *cpu)
 {
     serial->outgoingData = 0x00;
     serial->incomingData = 0x00;
@@ -51,8 +91,12 @@ void serial_init(struct Serial *serial, struct Memory *memory)
     serial->startTransfer = false;
     serial->internalClockSelect = false;
     serial->transferInProgress = false;
-    serial->transferStepCyclesRemaining = 0;
     serial->transferStepsRemaining = 0;
+    serial->transferComplete = false;
+
+    serial->scheduler = scheduler;
+    serial->cpu = cpu;
+    scheduler_register_event(scheduler, SCHEDULER_EVENT_SERIAL, serial_handle_transfer_step, serial);
 
     memory_register_io_handler(
         memory,
@@ -71,53 +115,28 @@ void serial_init(struct Serial *serial, struct Memory *memory)
 }
 
 
-bool serial_tick(struct Serial *serial, struct Cpu *cpu, int cycles)
+void serial_save_state(const struct Serial *serial, struct SerialState *state)
 {
-    // FUTURE: Support a link partner, possibly as another emulator
-    //   connected via TCP/IP. Currently only zeros are shifted in
-    //   and there is no external clock signal.
+    state->outgoingData = serial->outgoingData;
+    state->incomingData = serial->incomingData;
+    state->receivedData = serial->receivedData;
+    state->dataToSend = serial->dataToSend;
+    state->startTransfer = serial->startTransfer;
+    state->internalClockSelect = serial->internalClockSelect;
+    state->transferInProgress = serial->transferInProgress;
+    state->transferStepsRemaining = (uint8_t)serial->transferStepsRemaining;
+}
 
-    if (serial->startTransfer && ! serial->transferInProgress)
-    {
-        serial->transferInProgress = true;
-        serial->transferStepsRemaining = 8;
-        serial->transferStepCyclesRemaining = SERIAL_STEP_CYCLES_INTERNAL;
-        serial->outgoingData = serial->dataToSend;
-        serial->incomingData = 0x00;
-    }
 
-    bool transferComplete = false;
-    if (serial->transferInProgress)
-    {
-        bool doTransferStep = false;
-        if (serial->internalClockSelect)
-        {
-            serial->transferStepCyclesRemaining -= cycles;
-            doTransferStep = serial->transferStepCyclesRemaining <= 0;
-        }
-        else
-        {
-            // External clock not supported
-        }
-
-        if (doTransferStep)
-        {
-            uint8_t incomingBit = 0;
-            uint8_t outgoingBit = (serial->outgoingData & (1 << 7)) >> 7;
-
-            serial->incomingData = (serial->incomingData << 1) | incomingBit;
-            serial->outgoingData = (serial->outgoingData << 1) | outgoingBit;
-            serial->transferStepCyclesRemaining += SERIAL_STEP_CYCLES_INTERNAL;
-            serial->transferStepsRemaining -= 1;
-        }
-
-        if (serial->transferStepsRemaining <= 0)
-        {
-            cpu_request_interrupt(cpu, INTERRUPT_SERIAL);
-            serial->transferInProgress = false;
-            serial->startTransfer = false;
-            transferComplete = true;
-        }
-    }
-    return transferComplete;
+void serial_load_state(struct Serial *serial, const struct SerialState *state)
+{
+    serial->outgoingData = state->outgoingData;
+    serial->incomingData = state->incomingData;
+    serial->receivedData = state->receivedData;
+    serial->dataToSend = state->dataToSend;
+    serial->startTransfer = state->startTransfer != 0;
+    serial->internalClockSelect = state->internalClockSelect != 0;
+    serial->transferInProgress = state->transferInProgress != 0;
+    serial->transferStepsRemaining = state->transferStepsRemaining;
+    serial->transferComplete = false;
 }
@@ -7,6 +7,7 @@
 
 struct Memory;
 struct Cpu;
+struct Scheduler;
 
 
 struct Serial
@@ -22,13 +23,34 @@ struct Serial
     bool startTransfer;
     bool internalClockSelect;
     bool transferInProgress;
-    int transferStepCyclesRemaining;
     int transferStepsRemaining;
+
+    // Set when a byte has been completely shifted out.
+    // The owner is responsible for clearing it.
+    bool transferComplete;
+
+    struct Scheduler *scheduler;
+    struct Cpu *cpu;
+};
+
+// Register and shift state for save states
+struct SerialState
+{
+    uint8_t outgoingData;
+    uint8_t incomingData;
+    uint8_t receivedData;
+    uint8_t dataToSend;
+    uint8_t startTransfer;
+    uint8_t internalClockSelect;
+    uint8_t transferInProgress;
+    uint8_t transferStepsRemaining;
 };
 
 
-void serial_init(struct Serial *serial, struct Memory *memory);
-bool serial_tick(struct Serial *serial, struct Cpu *cpu, int cycles);
+void serial_init(struct Serial *serial, struct Memory *memory, struct Scheduler *scheduler, struct Cpu *cpu);
+
+void serial_save_state(const struct Serial *serial, struct SerialState *state);
+void serial_load_state(struct Serial *serial, const struct SerialState *state);
 
 
 
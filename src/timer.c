@@ -2,9 +2,10 @@
 #include "timer.h"
 #include "memory.h"
 #include "cpu.h"
+#include "scheduler.h"
 
 
-#define MACHINE_CYCLE_FREQUENCY  1000000  // 1 MHz
+#define MACHINE_CYCLE_FREQUENCY  1048576  // 1 MiHz
 
 #define DIV_INCREMENT_CYCLES               (MACHINE_CYCLE_FREQUENCY / 16384)
 #define TIMER_INPUT_CLOCK_CYCLES_4096HZ    (MACHINE_CYCLE_FREQUENCY / 4096)
@@ -13,18 +14,70 @@
 #define TIMER_INPUT_CLOCK_CYCLES_16384HZ   (MACHINE_CYCLE_FREQUENCY / 16384)
 
 
+// TIMA increments each time the internal divider passes a multiple of
+// cyclesPerTick (on hardware, on the falling edge of one of its bits).
+static uint64_t count_timer_ticks(struct Timer *timer, uint64_t startTime, uint64_t endTime)
+{
+    uint64_t startDivider = startTime - timer->dividerResetTime;
+    uint64_t endDivider = endTime - timer->dividerResetTime;
+    return endDivider / timer->cyclesPerTick - startDivider / timer->cyclesPerTick;
+}
+
+
+// Bring TIMA up to date with the current time.
+static void sync_tima(struct Timer *timer)
+{
+    uint64_t now = timer->scheduler->now;
+    if ( ! timer->stopped)
+    {
+        // The overflow event always runs before TIMA could pass 0xff.
+        timer->tima += count_timer_ticks(timer, timer->timaSyncTime, now);
+    }
+    timer->timaSyncTime = now;
+}
+
+
+static void schedule_overflow(struct Timer *timer)
+{
+    if (timer->stopped)
+    {
+        scheduler_cancel(timer->scheduler, SCHEDULER_EVENT_TIMER);
+        return;
+    }
+
+    // Find the divider value at which the 0x100th tick from 0 happens.
+    uint64_t divider = timer->timaSyncTime - timer->dividerResetTime;
+    uint64_t ticksUntilOverflow = 0x100 - (uint64_t)timer->tima;
+    uint64_t overflowDivider = (divider / timer->cyclesPerTick + ticksUntilOverflow) * timer->cyclesPerTick;
+    scheduler_schedule(timer->scheduler, SCHEDULER_EVENT_TIMER, timer->dividerResetTime + overflowDivider);
+}
+
+
+static void timer_handle_overflow(SchedulerEventFuncContext context, uint64_t time)
+{
+    struct Timer *timer = context;
+    timer->tima = timer->tma;
+    timer->timaSyncTime = time;
+    cpu_request_interrupt(timer->cpu, INTERRUPT_TIMER);
+    schedule_overflow(timer);
+}
+
+
 #define IO_REGISTER_DIV  0x04
 static uint8_t io_handler_read_div_register(IoRegisterFuncContext context)
 {
     struct Timer *timer = context;
-    return timer->div;
+    uint64_t divider = timer->scheduler->now - timer->dividerResetTime;
+    return (uint8_t)(divider / DIV_INCREMENT_CYCLES);
 }
 
 static void io_handler_write_div_register(IoRegisterFuncContext context, uint8_t value)
 {
     (void)value;
     struct Timer *timer = context;
-    timer->div = 0;
+    sync_tima(timer);
+    timer->dividerResetTime = timer->scheduler->now;
+    schedule_overflow(timer);
 }
 
 
@@ -32,13 +85,16 @@ static void io_handler_write_div_register(IoRegisterFuncContext context, uint8_t
 static uint8_t io_handler_read_tima_register(IoRegisterFuncContext context)
 {
     struct Timer *timer = context;
+    sync_tima(timer);
     return timer->tima;
 }
 
 static void io_handler_write_tima_register(IoRegisterFuncContext context, uint8_t value)
 {
     struct Timer *timer = context;
+    sync_tima(timer);
     timer->tima = value;
+    schedule_overflow(timer);
 }
 
 
@@ -56,12 +112,11 @@ static void io_handler_write_tma_register(IoRegisterFuncContext context, uint8_t
 }
 
 
-#define IO_REGISTER_TAC  0x07
-static uint8_t io_handler_read_tac_register(IoRegisterFuncContext context)
+// TAC is stored decoded, as the enable bit and the tick length
+static uint8_t encode_tac(const struct Timer *timer)
 {
-    struct Timer *timer = context;
     uint8_t value = 0;
-    if ( ! timer->stopped) value |= (1 << 3);
+    if ( ! timer->stopped) value |= (1 << 2);
     switch (timer->cyclesPerTick)
     {
     case TIMER_INPUT_CLOCK_CYCLES_4096HZ:
@@ -81,10 +136,9 @@ static uint8_t io_handler_read_tac_register(IoRegisterFuncContext context)
     return value;
 }
 
-static void io_handler_write_tac_register(IoRegisterFuncContext context, uint8_t value)
+static void decode_tac(struct Timer *timer, uint8_t value)
 {
-    struct Timer *timer = context;
-    timer->stopped = (value & (1 << 3)) == 0;
+    timer->stopped = (value & (1 << 2)) == 0;
     switch (value & 0x03)
     {
     case 0:
@@ -104,15 +158,33 @@ static void io_handler_write_tac_register(IoRegisterFuncContext context, uint8_t
 }
 
 
-void timer_init(struct Timer *timer, struct Memory *memory)
+#define IO_REGISTER_TAC  0x07
+static uint8_t io_handler_read_tac_register(IoRegisterFuncContext context)
 {
+    struct Timer *timer = context;
+    return encode_tac(timer);
+}
+
+static void io_handler_write_tac_register(IoRegisterFuncContext context, uint8_t value)
+{
+    struct Timer *timer = context;
+    sync_tima(timer);
+    decode_tac(timer, value);
+    schedule_overflow(timer);
+}
+
+
+void timer_init(struct Timer *timer, struct Memory *memory, struct Scheduler *scheduler, struct Cpu *cpu)
+{
+    timer->scheduler = scheduler;
+    timer->cpu = cpu;
     timer->stopped = true;
-    timer->div = 0;
-    timer->divIncrementCyclesLeft = DIV_INCREMENT_CYCLES;
+    timer->dividerResetTime = scheduler->now;
     timer->tma = 0;
     timer->cyclesPerTick = TIMER_INPUT_CLOCK_CYCLES_4096HZ;
     timer->tima = 0;
-    timer->timaIncrementCyclesLeft = timer->cyclesPerTick;
+    timer->timaSyncTime = scheduler->now;
+    scheduler_register_event(scheduler, SCHEDULER_EVENT_TIMER, timer_handle_overflow, timer);
     memory_register_io_handler(
         memory,
         IO_REGISTER_DIV,
@@ -144,30 +216,21 @@ void timer_init(struct Timer *timer, struct Memory *memory)
 }
 
 
-void timer_tick(struct Timer *timer, struct Cpu *cpu, int cycles)
+void timer_save_state(const struct Timer *timer, struct TimerState *state)
 {
-    timer->divIncrementCyclesLeft -= cycles;
-    if (timer->divIncrementCyclesLeft <= 0)
-    {
-        timer->div += 1;
-        timer->divIncrementCyclesLeft += DIV_INCREMENT_CYCLES;
-    }
-
-    if ( ! timer->stopped)
-    {
-        timer->timaIncrementCyclesLeft -= cycles;
-    }
-    if (timer->timaIncrementCyclesLeft <= 0)
-    {
-        if (timer->tima == 0xff)
-        {
-            timer->tima = timer->tma;
-            cpu_request_interrupt(cpu, INTERRUPT_TIMER);
-        }
-        else
-        {
-            timer->tima += 1;
-        }
-    }
+    state->dividerResetTime = timer->dividerResetTime;
+    state->timaSyncTime = timer->timaSyncTime;
+    state->tima = timer->tima;
+    state->tma = timer->tma;
+    state->tac = encode_tac(timer);
 }
 
+
+void timer_load_state(struct Timer *timer, const struct TimerState *state)
+{
+    timer->dividerResetTime = state->dividerResetTime;
+    timer->timaSyncTime = state->timaSyncTime;
+    timer->tima = state->tima;
+    timer->tma = state->tma;
+    decode_tac(timer, state->tac);
+}
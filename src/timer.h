@@ -7,26 +7,44 @@
 
 struct Memory;
 struct Cpu;
+struct Scheduler;
 
 
+// DIV and TIMA are not ticked. Instead, they are derived from the global
+// cycle counter when read, and only the TIMA overflow is scheduled.
 struct Timer
 {
-    uint8_t div;
-    int divIncrementCyclesLeft;
+    // The internal divider counts machine cycles since it was last reset.
+    uint64_t dividerResetTime;
     uint8_t tma;
 
-
-    uint8_t cyclesPerTick;
+    int cyclesPerTick;
     bool stopped;
 
+    // Value of TIMA as of timaSyncTime
     uint8_t tima;
-    int timaIncrementCyclesLeft;
+    uint64_t timaSyncTime;
 
+    struct Scheduler *scheduler;
+    struct Cpu *cpu;
 };
 
+// Register values for save states. The pending overflow is saved along
+// with the scheduler.
+struct TimerState
+{
+    uint64_t dividerResetTime;
+    uint64_t timaSyncTime;
+    uint8_t tima;
+    uint8_t tma;
+    uint8_t tac;
+};
+
+
+void timer_init(struct Timer *timer, struct Memory *memory, struct Scheduler *scheduler, struct Cpu *cpu);
 
-void timer_init(struct Timer *timer, struct Memory *memory);
-void timer_tick(struct Timer *timer, struct Cpu *cpu, int cycles);
+void timer_save_state(const struct Timer *timer, struct TimerState *state);
+void timer_load_state(struct Timer *timer, const struct TimerState *state);
 
 
 #endif
@@ -0,0 +1,459 @@
+
+// Needed for clock_gettime, opendir and sysconf
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+
+
+// Runs Blargg's test ROMs, which print their results to the serial port
+// and finish with "Passed" or "Failed". Each ROM runs in process with the
+// serial output collected in memory, and stops as soon as the result is
+// printed. A pool of threads runs the ROMs in parallel.
+
+
+static void print_usage(void)
+{
+    fprintf(stderr,
+        "Usage: blargg <rom_or_directory> [...] [...options] \n"
+        "  Directories are searched (not recursively) for .gb files \n"
+        "\n"
+        "Options: \n"
+        "  --jit               : Translate ROM code to native code where supported \n"
+        "  --threads <count>   : Number of ROMs to run at once (default: one per CPU) \n"
+        "  --timeout <seconds> : Emulated seconds to wait for a result (default 120) \n"
+    );
+}
+
+
+// Machine cycles (1.048576 MHz)
+#define CYCLES_PER_SECOND  1048576
+
+#define DEFAULT_TIMEOUT_SECONDS  120
+
+// The longest tests print a few hundred characters
+#define OUTPUT_CAPACITY  4096
+
+enum TestStatus
+{
+    TEST_PASSED,
+    TEST_FAILED,
+    TEST_TIMED_OUT,
+    TEST_CPU_STOPPED,
+    TEST_LOAD_ERROR,
+};
+
+struct Test
+{
+    char *romPath;
+
+    enum TestStatus status;
+    double seconds;
+    uint64_t cycles;
+
+    // Everything written to the serial port, as a string
+    char output[OUTPUT_CAPACITY];
+    size_t outputLength;
+};
+
+struct TestRun
+{
+    struct Test *tests;
+    size_t numTests;
+    atomic_size_t nextTest;
+
+    bool jit;
+    uint64_t cycleLimit;
+
+    // For reporting results as they come in
+    pthread_mutex_t printMutex;
+};
+
+
+static double get_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+
+static bool ends_with(const char *string, size_t length, const char *suffix)
+{
+    size_t suffixLength = strlen(suffix);
+    return length >= suffixLength && memcmp(string + length - suffixLength, suffix, suffixLength) == 0;
+}
+
+static void append_output(struct Test *test, uint8_t byte)
+{
+    // Keep the end if a ROM prints far more than expected
+    if (test->outputLength == OUTPUT_CAPACITY - 1)
+    {
+        size_t kept = OUTPUT_CAPACITY / 2;
+        memmove(test->output, test->output + test->outputLength - kept, kept);
+        test->outputLength = kept;
+    }
+    test->output[test->outputLength++] = (char)byte;
+    test->output[test->outputLength] = '\0';
+}
+
+
+// Returns true once the output holds the result
+static bool find_result(struct Test *test)
+{
+    if (ends_with(test->output, test->outputLength, "Passed"))
+    {
+        test->status = TEST_PASSED;
+        return true;
+    }
+    if (ends_with(test->output, test->outputLength, "Failed"))
+    {
+        test->status = TEST_FAILED;
+        return true;
+    }
+    return false;
+}
+
+
+static void run_test(const struct TestRun *run, struct Test *test)
+{
+    test->status = TEST_LOAD_ERROR;
+    test->cycles = 0;
+    test->outputLength = 0;
+    test->output[0] = '\0';
+
+    struct Cartridge cartridge;
+    if ( ! cartridge_load(&cartridge, test->romPath))
+    {
+        cartridge_teardown(&cartridge);
+        return;
+    }
+
+    // Shown with the result, like a ROM's own output
+    struct CartridgeHeader header;
+    if ( ! cartridge_get_header(&cartridge, &header))
+    {
+        test->outputLength = (size_t)snprintf(test->output, OUTPUT_CAPACITY, "unsupported cartridge type 0x%02x", header.typeCode);
+        cartridge_teardown(&cartridge);
+        return;
+    }
+
+    // Far too large for a worker thread's stack, and must not move
+    struct GameBoy *gameBoy = calloc(1, sizeof(*gameBoy));
+    if (gameBoy == NULL || ! gameboy_init(gameBoy, &cartridge, run->jit))
+    {
+        free(gameBoy);
+        cartridge_teardown(&cartridge);
+        return;
+    }
+
+    test->status = TEST_TIMED_OUT;
+    uint64_t cycleLimit = run->cycleLimit;
+    bool hasResult = false;
+    while (gameBoy->scheduler.now < cycleLimit)
+    {
+        if ( ! gameboy_step(gameBoy))
+        {
+            test->status = TEST_CPU_STOPPED;
+            break;
+        }
+
+        struct Serial *serial = &gameBoy->serial;
+        if (serial->transferComplete)
+        {
+            serial->transferComplete = false;
+            append_output(test, serial->outgoingData);
+
+            // Failures are explained on the rest of the line (e.g. "Failed
+            // #3"), so finish reading it, but don't wait long
+            if (hasResult && serial->outgoingData == '\n')
+            {
+                break;
+            }
+            if ( ! hasResult && find_result(test))
+            {
+                hasResult = true;
+                cycleLimit = gameBoy->scheduler.now + CYCLES_PER_SECOND / 10;
+            }
+        }
+
+        if (gameBoy->ppu.frameComplete)
+        {
+            gameBoy->ppu.frameComplete = false;
+            keypad_tick(&gameBoy->keypad);
+        }
+    }
+    test->cycles = gameBoy->scheduler.now;
+
+    gameboy_teardown(gameBoy);
+    free(gameBoy);
+    cartridge_teardown(&cartridge);
+}
+
+
+static const char* get_status_string(enum TestStatus status)
+{
+    switch (status)
+    {
+    case TEST_PASSED:
+        return "PASS";
+    case TEST_FAILED:
+        return "FAIL";
+    case TEST_TIMED_OUT:
+        return "TIMEOUT";
+    case TEST_CPU_STOPPED:
+        return "STOPPED";
+    case TEST_LOAD_ERROR:
+        return "ERROR";
+    default:
+        return "?";
+    }
+}
+
+
+static void report_test(const struct Test *test)
+{
+    printf("%-7s %7.3f s  (%6.1f s emulated)  %s \n",
+        get_status_string(test->status),
+        test->seconds,
+        (double)test->cycles / CYCLES_PER_SECOND,
+        test->romPath
+    );
+    if (test->status != TEST_PASSED && test->outputLength > 0)
+    {
+        printf("-----------------------------\n%s\n-----------------------------\n", test->output);
+    }
+    fflush(stdout);
+}
+
+
+static void* worker_main(void *arg)
+{
+    struct TestRun *run = arg;
+    while (true)
+    {
+        size_t index = atomic_fetch_add(&run->nextTest, 1);
+        if (index >= run->numTests)
+        {
+            return NULL;
+        }
+
+        struct Test *test = &run->tests[index];
+        double startTime = get_seconds();
+        run_test(run, test);
+        test->seconds = get_seconds() - startTime;
+
+        pthread_mutex_lock(&run->printMutex);
+        report_test(test);
+        pthread_mutex_unlock(&run->printMutex);
+    }
+}
+
+
+// Paths are collected into a growing array
+struct PathList
+{
+    char **paths;
+    size_t numPaths;
+    size_t capacity;
+};
+
+static bool add_path(struct PathList *list, const char *path)
+{
+    if (list->numPaths == list->capacity)
+    {
+        size_t capacity = (list->capacity == 0) ? 64 : list->capacity * 2;
+        char **paths = realloc(list->paths, capacity * sizeof(paths[0]));
+        if (paths == NULL)
+        {
+            return false;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    list->paths[list->numPaths] = malloc(strlen(path) + 1);
+    if (list->paths[list->numPaths] == NULL)
+    {
+        return false;
+    }
+    strcpy(list->paths[list->numPaths], path);
+    list->numPaths += 1;
+    return true;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Adds the ROMs in a directory in name order, or the path itself if it
+// isn't a directory
+static bool add_roms(struct PathList *list, const char *path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0 || ! S_ISDIR(info.st_mode))
+    {
+        return add_path(list, path);
+    }
+
+    DIR *directory = opendir(path);
+    if (directory == NULL)
+    {
+        return false;
+    }
+
+    size_t firstAdded = list->numPaths;
+    bool success = true;
+    struct dirent *entry;
+    while (success && (entry = readdir(directory)) != NULL)
+    {
+        if (ends_with(entry->d_name, strlen(entry->d_name), ".gb"))
+        {
+            char romPath[4096];
+            snprintf(romPath, sizeof(romPath), "%s/%s", path, entry->d_name);
+            success = add_path(list, romPath);
+        }
+    }
+    closedir(directory);
+
+    qsort(&list->paths[firstAdded], list->numPaths - firstAdded, sizeof(list->paths[0]), compare_paths);
+    return success;
+}
+
+
+static bool parse_number(const char *string, size_t *value)
+{
+    char *end;
+    unsigned long long parsed = strtoull(string, &end, 10);
+    *value = (size_t)parsed;
+    return end != string && *end == '\0';
+}
+
+
+int main(int argc, char **argv)
+{
+    struct PathList romPaths = { NULL, 0, 0 };
+    bool jit = false;
+    size_t numThreads = 0;
+    size_t timeoutSeconds = DEFAULT_TIMEOUT_SECONDS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        bool hasValue = i < argc - 1;
+        if (strcmp(arg, "--jit") == 0)
+        {
+            jit = true;
+        }
+        else if (strcmp(arg, "--threads") == 0 && hasValue)
+        {
+            if ( ! parse_number(argv[++i], &numThreads))
+            {
+                print_usage();
+                return 2;
+            }
+        }
+        else if (strcmp(arg, "--timeout") == 0 && hasValue)
+        {
+            if ( ! parse_number(argv[++i], &timeoutSeconds))
+            {
+                print_usage();
+                return 2;
+            }
+        }
+        else if (strncmp(arg, "--", 2) == 0)
+        {
+            print_usage();
+            return 2;
+        }
+        else if ( ! add_roms(&romPaths, arg))
+        {
+            fprintf(stderr, "error: failed to read %s \n", arg);
+            return 2;
+        }
+    }
+    if (romPaths.numPaths == 0 || timeoutSeconds == 0)
+    {
+        print_usage();
+        return 2;
+    }
+
+    if (numThreads == 0)
+    {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = (numCpus > 0) ? (size_t)numCpus : 1;
+    }
+    if (numThreads > romPaths.numPaths)
+    {
+        numThreads = romPaths.numPaths;
+    }
+
+    struct TestRun run;
+    run.numTests = romPaths.numPaths;
+    run.tests = calloc(run.numTests, sizeof(run.tests[0]));
+    run.jit = jit;
+    run.cycleLimit = (uint64_t)timeoutSeconds * CYCLES_PER_SECOND;
+    atomic_init(&run.nextTest, 0);
+    pthread_mutex_init(&run.printMutex, NULL);
+    pthread_t *workers = calloc(numThreads, sizeof(workers[0]));
+    if (run.tests == NULL || workers == NULL)
+    {
+        fprintf(stderr, "error: out of memory \n");
+        return 2;
+    }
+    for (size_t i = 0; i < run.numTests; i++)
+    {
+        run.tests[i].romPath = romPaths.paths[i];
+    }
+
+    double startTime = get_seconds();
+    size_t numStarted = 0;
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        if (pthread_create(&workers[i], NULL, worker_main, &run) == 0)
+        {
+            numStarted += 1;
+        }
+    }
+    if (numStarted == 0)
+    {
+        // Run everything on this thread instead
+        worker_main(&run);
+    }
+    for (size_t i = 0; i < numStarted; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    double seconds = get_seconds() - startTime;
+
+    size_t numPassed = 0;
+    for (size_t i = 0; i < run.numTests; i++)
+    {
+        numPassed += (run.tests[i].status == TEST_PASSED) ? 1 : 0;
+    }
+    printf("%zu of %zu passed in %.3f s \n", numPassed, run.numTests, seconds);
+
+    pthread_mutex_destroy(&run.printMutex);
+    for (size_t i = 0; i < romPaths.numPaths; i++)
+    {
+        free(romPaths.paths[i]);
+    }
+    free(romPaths.paths);
+    free(workers);
+    free(run.tests);
+
+    return (numPassed == run.numTests) ? 0 : 1;
+}
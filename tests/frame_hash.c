@@ -0,0 +1,380 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "movie.h"
+
+
+// Runs a ROM without a display and hashes the screen at the end of each
+// checkpoint frame, to catch rendering regressions as well as CPU ones.
+// The hashes are printed as "<frame> <hash>" lines, which makes a golden
+// file when redirected. Given a golden file instead, it stops at the first
+// checkpoint that doesn't match.
+//
+// The pixels hashed are the colors shown (in the default gray palette)
+// rather than the shades the PPU stores, so that how the PPU stores them
+// can change without invalidating golden files.
+//
+// Input comes from a movie, if any, applied at the same points as in
+// emulator_headless, so a movie recorded in the emulator replays the same.
+
+
+static void print_usage(void)
+{
+    fprintf(stderr,
+        "Usage: frame_hash <rom_path> [...options] \n"
+        "\n"
+        "Options: \n"
+        "  --frames <count>    : Number of frames to run (default: the length of the movie, or else the golden file) \n"
+        "  --every <count>     : Hash every this many frames (default 1), unless comparing against a golden file \n"
+        "  --movie <path>      : Buttons to press, from --record-movie \n"
+        "  --golden <path>     : Compare the frames listed in the output of an earlier run instead of printing \n"
+        "  --jit               : Translate ROM code to native code where supported \n"
+    );
+}
+
+
+// XXH64 (https://github.com/Cyan4973/xxHash), which hashes a frame in a
+// fraction of the time it takes to emulate one
+#define XXH_PRIME64_1  0x9e3779b185ebca87ULL
+#define XXH_PRIME64_2  0xc2b2ae3d27d4eb4fULL
+#define XXH_PRIME64_3  0x165667b19e3779f9ULL
+#define XXH_PRIME64_4  0x85ebca77c2b2ae63ULL
+#define XXH_PRIME64_5  0x27d4eb2f165667c5ULL
+
+static uint64_t rotate_left(uint64_t value, int amount)
+{
+    return (value << amount) | (value >> (64 - amount));
+}
+
+static uint64_t read_u64(const uint8_t *data)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+static uint32_t read_u32(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint64_t xxh64_round(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * XXH_PRIME64_2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge_round(uint64_t accumulator, uint64_t value)
+{
+    accumulator ^= xxh64_round(0, value);
+    return accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static uint64_t xxh64(const uint8_t *data, size_t length, uint64_t seed)
+{
+    const uint8_t *end = data + length;
+    uint64_t hash;
+
+    if (length >= 32)
+    {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        const uint8_t *limit = end - 32;
+        do
+        {
+            v1 = xxh64_round(v1, read_u64(data));
+            v2 = xxh64_round(v2, read_u64(data + 8));
+            v3 = xxh64_round(v3, read_u64(data + 16));
+            v4 = xxh64_round(v4, read_u64(data + 24));
+            data += 32;
+        }
+        while (data <= limit);
+
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+        hash = xxh64_merge_round(hash, v1);
+        hash = xxh64_merge_round(hash, v2);
+        hash = xxh64_merge_round(hash, v3);
+        hash = xxh64_merge_round(hash, v4);
+    }
+    else
+    {
+        hash = seed + XXH_PRIME64_5;
+    }
+
+    hash += (uint64_t)length;
+
+    while (end - data >= 8)
+    {
+        hash ^= xxh64_round(0, read_u64(data));
+        hash = rotate_left(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        data += 8;
+    }
+    if (end - data >= 4)
+    {
+        hash ^= (uint64_t)read_u32(data) * XXH_PRIME64_1;
+        hash = rotate_left(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        data += 4;
+    }
+    while (data < end)
+    {
+        hash ^= (*data) * XXH_PRIME64_5;
+        hash = rotate_left(hash, 11) * XXH_PRIME64_1;
+        data += 1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+
+struct Arguments
+{
+    const char *romPath;
+    const char *moviePath;
+    const char *goldenPath;
+    unsigned long long numFrames;
+    unsigned long long interval;
+    bool jit;
+};
+
+static bool parse_count(const char *string, unsigned long long *count)
+{
+    char *end;
+    *count = strtoull(string, &end, 10);
+    return end != string && *end == '\0' && *count > 0;
+}
+
+static bool parse_arguments(int argc, char **argv, struct Arguments *args)
+{
+    args->romPath = NULL;
+    args->moviePath = NULL;
+    args->goldenPath = NULL;
+    args->numFrames = 0;
+    args->interval = 1;
+    args->jit = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        bool hasValue = i < argc - 1;
+        if (strcmp(arg, "--frames") == 0 && hasValue)
+        {
+            if ( ! parse_count(argv[++i], &args->numFrames))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--every") == 0 && hasValue)
+        {
+            if ( ! parse_count(argv[++i], &args->interval))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--movie") == 0 && hasValue)
+        {
+            args->moviePath = argv[++i];
+        }
+        else if (strcmp(arg, "--golden") == 0 && hasValue)
+        {
+            args->goldenPath = argv[++i];
+        }
+        else if (strcmp(arg, "--jit") == 0)
+        {
+            args->jit = true;
+        }
+        else if (strncmp(arg, "--", 2) != 0 && args->romPath == NULL)
+        {
+            args->romPath = arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // Something has to say how long to run
+    return args->romPath != NULL && (args->numFrames > 0 || args->moviePath != NULL || args->goldenPath != NULL);
+}
+
+
+static unsigned long long find_last_frame(FILE *golden)
+{
+    unsigned long long lastFrame = 0;
+    unsigned long long frame;
+    unsigned long long hash;
+    while (fscanf(golden, "%llu %llx", &frame, &hash) == 2)
+    {
+        lastFrame = frame;
+    }
+    rewind(golden);
+    return lastFrame;
+}
+
+
+// The checkpoints from an earlier run
+struct Golden
+{
+    FILE *file;
+
+    // The next one to compare against, if hasNext
+    bool hasNext;
+    unsigned long long frame;
+    unsigned long long hash;
+};
+
+static void read_next_checkpoint(struct Golden *golden)
+{
+    golden->hasNext = fscanf(golden->file, "%llu %llx", &golden->frame, &golden->hash) == 2;
+}
+
+
+int main(int argc, char **argv)
+{
+    struct Arguments args;
+    if ( ! parse_arguments(argc, argv, &args))
+    {
+        print_usage();
+        return 2;
+    }
+
+    int statusCode = 0;
+
+    struct Cartridge cartridge;
+    if ( ! cartridge_load(&cartridge, args.romPath))
+    {
+        fprintf(stderr, "error: failed to load the cartridge! \n");
+        statusCode = 2;
+        goto cleanup_cartridge;
+    }
+
+    struct CartridgeHeader cartridgeHeader;
+    if ( ! cartridge_get_header(&cartridge, &cartridgeHeader))
+    {
+        fprintf(stderr, "error: unsupported cartridge type 0x%02x \n", cartridgeHeader.typeCode);
+        statusCode = 2;
+        goto cleanup_cartridge;
+    }
+
+    static struct GameBoy gameBoy;
+    static uint8_t pixels[4 * LCD_WIDTH * LCD_HEIGHT];
+    if ( ! gameboy_init(&gameBoy, &cartridge, args.jit))
+    {
+        fprintf(stderr, "error: failed to create the memory mapper! \n");
+        statusCode = 2;
+        goto cleanup_cartridge;
+    }
+
+    struct Golden golden;
+    golden.file = NULL;
+    golden.hasNext = false;
+    struct Movie movie;
+    movie.file = NULL;
+    if (args.goldenPath != NULL)
+    {
+        golden.file = fopen(args.goldenPath, "r");
+        if (golden.file == NULL)
+        {
+            fprintf(stderr, "error: failed to open the golden file \n");
+            statusCode = 2;
+            goto cleanup_files;
+        }
+        if (args.numFrames == 0 && args.moviePath == NULL)
+        {
+            args.numFrames = find_last_frame(golden.file);
+        }
+        read_next_checkpoint(&golden);
+    }
+    if (args.moviePath != NULL)
+    {
+        if ( ! movie_init_playback(&movie, args.moviePath, &cartridge))
+        {
+            fprintf(stderr, "error: failed to open the movie file, or it was recorded with a different ROM \n");
+            statusCode = 2;
+            goto cleanup_files;
+        }
+        movie_play_input(&movie, &gameBoy.inputState);
+    }
+
+    unsigned long long numCheckpoints = 0;
+    for (unsigned long long frame = 1; args.numFrames == 0 || frame <= args.numFrames; frame++)
+    {
+        if ( ! gameboy_run_frame(&gameBoy))
+        {
+            printf("Failed: the CPU stopped during frame %llu \n", frame);
+            statusCode = 1;
+            break;
+        }
+
+        bool isCheckpoint = (golden.file != NULL) ? (golden.hasNext && golden.frame == frame) : (frame % args.interval == 0);
+        if (isCheckpoint)
+        {
+            ppu_expand_pixels(&gameBoy.ppu, pixels);
+            unsigned long long hash = xxh64(pixels, sizeof(pixels), 0);
+            numCheckpoints += 1;
+            if (golden.file == NULL)
+            {
+                printf("%llu %016llx\n", frame, hash);
+            }
+            else if (hash != golden.hash)
+            {
+                printf("Failed: frame %llu hashed to %016llx, expected %016llx \n", frame, hash, golden.hash);
+                statusCode = 1;
+                break;
+            }
+            else
+            {
+                read_next_checkpoint(&golden);
+            }
+        }
+
+        // Buttons change between frames, as in emulator_headless. Once
+        // the movie is over its last buttons stay held.
+        if (movie.file != NULL && ! movie_play_input(&movie, &gameBoy.inputState) && args.numFrames == 0)
+        {
+            break;
+        }
+        keypad_tick(&gameBoy.keypad);
+    }
+
+    if (golden.file != NULL && statusCode == 0)
+    {
+        if (golden.hasNext)
+        {
+            printf("Failed: stopped before reaching frame %llu from the golden file \n", golden.frame);
+            statusCode = 1;
+        }
+        else
+        {
+            printf("Passed: %llu frames matched \n", numCheckpoints);
+        }
+    }
+
+cleanup_files:
+    movie_teardown(&movie);
+    if (golden.file != NULL)
+    {
+        fclose(golden.file);
+    }
+    gameboy_teardown(&gameBoy);
+cleanup_cartridge:
+    cartridge_teardown(&cartridge);
+
+    return statusCode;
+}
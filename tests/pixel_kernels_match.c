@@ -0,0 +1,149 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pixel_kernels.h"
+
+
+// Checks that every version of the pixel kernels the CPU supports gives
+// exactly the same output as the plain C ones: for every pair of tile
+// bytes, and for random indices at every length up to a few vectors, so
+// that all the leftovers after the 8 and 16 pixel steps are covered.
+
+
+// Lengths 0 to this are all tried
+#define MAX_COUNT  80
+
+#define RUNS_PER_COUNT  64
+
+// Bytes after the output that must be left alone
+#define GUARD_SIZE  64
+#define GUARD_BYTE  0xa5
+
+
+// xorshift64, so that failures can be reproduced
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+
+static bool check_decode_tile_row(const struct PixelKernels *reference, const struct PixelKernels *kernels, size_t set)
+{
+    for (unsigned tileByte0 = 0; tileByte0 < 256; tileByte0++)
+    {
+        for (unsigned tileByte1 = 0; tileByte1 < 256; tileByte1++)
+        {
+            uint8_t expected[8];
+            uint8_t expectedFlipped[8];
+            uint8_t actual[8];
+            uint8_t actualFlipped[8];
+            reference->decode_tile_row((uint8_t)tileByte0, (uint8_t)tileByte1, expected, expectedFlipped);
+            kernels->decode_tile_row((uint8_t)tileByte0, (uint8_t)tileByte1, actual, actualFlipped);
+            if (memcmp(expected, actual, sizeof(expected)) != 0 || memcmp(expectedFlipped, actualFlipped, sizeof(expectedFlipped)) != 0)
+            {
+                printf("Failed: set %zu decode_tile_row differs for bytes 0x%02x 0x%02x \n", set, tileByte0, tileByte1);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+static bool check_map_indices(const struct PixelKernels *reference, const struct PixelKernels *kernels, size_t set, uint64_t *random)
+{
+    for (size_t count = 0; count <= MAX_COUNT; count++)
+    {
+        for (int run = 0; run < RUNS_PER_COUNT; run++)
+        {
+            uint8_t indices[MAX_COUNT];
+            uint8_t table[4];
+            for (size_t i = 0; i < count; i++)
+            {
+                indices[i] = (uint8_t)(next_random(random) & 3);
+            }
+            for (size_t i = 0; i < 4; i++)
+            {
+                table[i] = (uint8_t)next_random(random);
+            }
+
+            uint8_t expected[MAX_COUNT + GUARD_SIZE];
+            uint8_t actual[MAX_COUNT + GUARD_SIZE];
+            memset(expected, GUARD_BYTE, sizeof(expected));
+            memset(actual, GUARD_BYTE, sizeof(actual));
+            reference->map_indices(indices, count, table, expected);
+            kernels->map_indices(indices, count, table, actual);
+            if (memcmp(expected, actual, sizeof(expected)) != 0)
+            {
+                printf("Failed: set %zu map_indices differs for %zu indices \n", set, count);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+static bool check_expand_pixels(const struct PixelKernels *reference, const struct PixelKernels *kernels, size_t set, uint64_t *random)
+{
+    for (size_t count = 0; count <= MAX_COUNT; count++)
+    {
+        for (int run = 0; run < RUNS_PER_COUNT; run++)
+        {
+            uint8_t indices[MAX_COUNT];
+            uint32_t colors[4];
+            for (size_t i = 0; i < count; i++)
+            {
+                indices[i] = (uint8_t)(next_random(random) & 3);
+            }
+            for (size_t i = 0; i < 4; i++)
+            {
+                colors[i] = (uint32_t)next_random(random);
+            }
+
+            // Offset by a byte, as the pixels needn't be aligned
+            uint8_t expected[1 + 4 * MAX_COUNT + GUARD_SIZE];
+            uint8_t actual[1 + 4 * MAX_COUNT + GUARD_SIZE];
+            memset(expected, GUARD_BYTE, sizeof(expected));
+            memset(actual, GUARD_BYTE, sizeof(actual));
+            reference->expand_pixels(indices, count, colors, &expected[1]);
+            kernels->expand_pixels(indices, count, colors, &actual[1]);
+            if (memcmp(expected, actual, sizeof(expected)) != 0)
+            {
+                printf("Failed: set %zu expand_pixels differs for %zu indices \n", set, count);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+int main(void)
+{
+    struct PixelKernels kernels[PIXEL_KERNELS_MAX_SETS];
+    size_t numSets = pixel_kernels_get_all(kernels);
+
+    // The first set is plain C, which the others are checked against
+    bool passed = true;
+    uint64_t random = 0x9e3779b97f4a7c15ULL;
+    for (size_t set = 1; set < numSets; set++)
+    {
+        passed = check_decode_tile_row(&kernels[0], &kernels[set], set) && passed;
+        passed = check_map_indices(&kernels[0], &kernels[set], set, &random) && passed;
+        passed = check_expand_pixels(&kernels[0], &kernels[set], set, &random) && passed;
+    }
+
+    if (passed)
+    {
+        printf("Passed: %zu vectorised sets match plain C \n", numSets - 1);
+    }
+    return passed ? 0 : 1;
+}
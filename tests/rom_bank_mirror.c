@@ -0,0 +1,162 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "block_cache.h"
+
+
+// Regression test for running bank 0 through the switchable ROM region.
+// MBC1 bank numbers wrap around the ROM size, so on a ROM of four banks
+// selecting bank 4 maps bank 0 at 0x4000 as well. Code run from there has
+// to carry on at its 0x4000 addresses, even when the same code has already
+// been run (and cached, or translated) from the start of the ROM.
+//
+// The ROM calls a routine at 0x1000 that selects bank 1, selects bank 4,
+// then jumps to the same routine at 0x5000. This time selecting bank 1
+// switches out the code being run, so it continues with bank 1's code at
+// 0x5005, which marks work RAM and loops forever.
+
+
+#define ROM_SIZE  (4 * MEMORY_ROM_BANK_SIZE)
+
+#define MARKER_ADDRESS  0xc000
+#define MARKER_VALUE    0x42
+
+// Where the code in bank 1 ends up looping
+#define LOOP_ADDRESS  0x500a
+
+#define NUM_FRAMES  10
+
+
+static void write_bytes(uint8_t *rom, size_t offset, const uint8_t *bytes, size_t numBytes)
+{
+    memcpy(&rom[offset], bytes, numBytes);
+}
+
+static void build_rom(uint8_t *rom)
+{
+    memset(rom, 0, ROM_SIZE);
+
+    // nop; jp 0x0150
+    static const uint8_t entryPoint[] = { 0x00, 0xc3, 0x50, 0x01 };
+    write_bytes(rom, 0x0100, entryPoint, sizeof(entryPoint));
+
+    // MBC1, 64 KiB
+    rom[0x0147] = 0x01;
+    rom[0x0148] = 0x01;
+
+    // ld sp, 0xdffe; call 0x1000; ld a, 4; ld (0x2000), a; jp 0x5000
+    static const uint8_t mainCode[] = {
+        0x31, 0xfe, 0xdf,
+        0xcd, 0x00, 0x10,
+        0x3e, 0x04,
+        0xea, 0x00, 0x20,
+        0xc3, 0x00, 0x50,
+    };
+    write_bytes(rom, 0x0150, mainCode, sizeof(mainCode));
+
+    // ld a, 1; ld (0x2000), a; ret
+    static const uint8_t routine[] = {
+        0x3e, 0x01,
+        0xea, 0x00, 0x20,
+        0xc9,
+    };
+    write_bytes(rom, 0x1000, routine, sizeof(routine));
+
+    // At 0x5005 in bank 1: ld a, MARKER_VALUE; ld (MARKER_ADDRESS), a; jr -2
+    static const uint8_t bank1Code[] = {
+        0x3e, MARKER_VALUE,
+        0xea, MARKER_ADDRESS & 0xff, MARKER_ADDRESS >> 8,
+        0x18, 0xfe,
+    };
+    write_bytes(rom, MEMORY_ROM_BANK_SIZE + 0x1005, bank1Code, sizeof(bank1Code));
+}
+
+
+enum Variant
+{
+    VARIANT_INTERPRETER,
+    VARIANT_BLOCK_CACHE,
+    VARIANT_JIT,
+};
+
+static const char* get_variant_string(enum Variant variant)
+{
+    switch (variant)
+    {
+    case VARIANT_INTERPRETER:
+        return "interpreter";
+    case VARIANT_BLOCK_CACHE:
+        return "block cache";
+    case VARIANT_JIT:
+        return "jit";
+    default:
+        return "?";
+    }
+}
+
+
+static bool run_variant(const struct Cartridge *cartridge, enum Variant variant)
+{
+    struct GameBoy *gameBoy = calloc(1, sizeof(*gameBoy));
+    if (gameBoy == NULL || ! gameboy_init(gameBoy, cartridge, variant == VARIANT_JIT))
+    {
+        free(gameBoy);
+        printf("Failed: couldn't start the %s \n", get_variant_string(variant));
+        return false;
+    }
+    if (variant == VARIANT_INTERPRETER)
+    {
+        block_cache_destroy(gameBoy->cpu.blockCache);
+        gameBoy->cpu.blockCache = NULL;
+    }
+
+    bool passed = true;
+    for (int frame = 0; frame < NUM_FRAMES && passed; frame++)
+    {
+        passed = gameboy_run_frame(gameBoy);
+    }
+
+    uint8_t marker = memory_read_word(&gameBoy->memory, MARKER_ADDRESS);
+    uint16_t pc = gameBoy->cpu.pc;
+    if ( ! passed || marker != MARKER_VALUE || pc != LOOP_ADDRESS)
+    {
+        printf("Failed: the %s stopped at pc=%04x with 0x%02x at 0x%04x \n", get_variant_string(variant), pc, marker, MARKER_ADDRESS);
+        passed = false;
+    }
+
+    gameboy_teardown(gameBoy);
+    free(gameBoy);
+    return passed;
+}
+
+
+int main(void)
+{
+    static uint8_t rom[ROM_SIZE];
+    build_rom(rom);
+
+    struct Cartridge cartridge;
+    if ( ! cartridge_load_from_memory(&cartridge, rom, sizeof(rom)))
+    {
+        fprintf(stderr, "error: failed to load the cartridge! \n");
+        return 2;
+    }
+
+    bool passed = true;
+    passed = run_variant(&cartridge, VARIANT_INTERPRETER) && passed;
+    passed = run_variant(&cartridge, VARIANT_BLOCK_CACHE) && passed;
+    passed = run_variant(&cartridge, VARIANT_JIT) && passed;
+    if (passed)
+    {
+        printf("Passed \n");
+    }
+
+    cartridge_teardown(&cartridge);
+    return passed ? 0 : 1;
+}
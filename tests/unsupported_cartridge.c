@@ -0,0 +1,58 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "libgameboy.h"
+
+
+// Loading a ROM with a cartridge type the emulator doesn't support has to
+// fail through the library's return value, not take down the program
+// embedding it.
+
+
+#define ROM_SIZE  0x8000
+
+// MBC3+TIMER+RAM+BATTERY, which isn't supported
+#define UNSUPPORTED_TYPE_CODE  0x10
+
+// MBC1+RAM+BATTERY, which is
+#define SUPPORTED_TYPE_CODE  0x03
+
+
+static bool check_load(uint8_t typeCode, bool expected)
+{
+    static uint8_t rom[ROM_SIZE];
+    memset(rom, 0, sizeof(rom));
+    rom[0x0147] = typeCode;
+
+    struct GbEmulator *gb = gb_create();
+    if (gb == NULL)
+    {
+        printf("Failed: couldn't create an emulator \n");
+        return false;
+    }
+
+    bool loaded = gb_load_rom_from_memory(gb, rom, sizeof(rom));
+    bool passed = loaded == expected;
+    if ( ! passed)
+    {
+        printf("Failed: loading cartridge type 0x%02x returned %s \n", typeCode, loaded ? "true" : "false");
+    }
+    gb_destroy(gb);
+    return passed;
+}
+
+
+int main(void)
+{
+    bool passed = true;
+    passed = check_load(UNSUPPORTED_TYPE_CODE, false) && passed;
+    passed = check_load(SUPPORTED_TYPE_CODE, true) && passed;
+    if (passed)
+    {
+        printf("Passed \n");
+    }
+    return passed ? 0 : 1;
+}